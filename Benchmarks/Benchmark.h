@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Minimal benchmark registry. BENCHMARK(Name) defines a benchmark, which times
+// its workloads with Benchmark::State::Measure.
+namespace Benchmark
+{
+    class State
+    {
+    public:
+        explicit State(bool quick) : m_quick(quick) {}
+
+        // Quick runs only check that the benchmarks work, with small sizes and a single repetition.
+        bool IsQuick() const { return m_quick; }
+        size_t Size(size_t size, size_t quickSize) const { return m_quick ? quickSize : size; }
+
+        // Run function repeatedly and print its fastest run, with the rate of
+        // items it processed per second. Returns the fastest run in milliseconds.
+        template <typename Function>
+        double Measure(const char *label, size_t numItems, Function &&function)
+        {
+            using Clock = std::chrono::steady_clock;
+
+            // The first run warms up the caches and is not measured.
+            function();
+
+            double bestMs = 0.0;
+            double totalMs = 0.0;
+            for (size_t run = 0; run < s_maxRuns; run++)
+            {
+                Clock::time_point start = Clock::now();
+                function();
+                double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+                bestMs = run == 0 ? ms : (ms < bestMs ? ms : bestMs);
+                totalMs += ms;
+                if (m_quick || totalMs >= s_minTotalMs)
+                {
+                    break;
+                }
+            }
+
+            std::printf("  %-48s %10.3f ms %12.2f M/s\n", label, bestMs, bestMs > 0.0 ? static_cast<double>(numItems) / (bestMs * 1e3) : 0.0);
+            return bestMs;
+        }
+
+    private:
+        static constexpr size_t s_maxRuns = 1000;
+        static constexpr double s_minTotalMs = 250.0;
+
+        bool m_quick;
+    };
+
+    // 1, 2, 4, ... up to the hardware thread count, which is always included.
+    std::vector<uint32_t> GetThreadCounts();
+
+    struct Case
+    {
+        const char *name;
+        void (*function)(State &state);
+    };
+
+    std::vector<Case> &GetCases();
+
+    struct Registrar
+    {
+        Registrar(const char *name, void (*function)(State &state))
+        {
+            GetCases().push_back({name, function});
+        }
+    };
+}
+
+#define BENCHMARK(name)                                                                        \
+    static void Benchmark_##name(Benchmark::State &state);                                     \
+    static const Benchmark::Registrar g_registrar_##name(#name, &Benchmark_##name);            \
+    static void Benchmark_##name(Benchmark::State &state)
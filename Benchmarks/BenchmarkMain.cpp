@@ -0,0 +1,65 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace Benchmark
+{
+    std::vector<Case> &GetCases()
+    {
+        static std::vector<Case> cases;
+        return cases;
+    }
+
+    std::vector<uint32_t> GetThreadCounts()
+    {
+        uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<uint32_t> counts;
+        for (uint32_t count = 1; count < maxThreads; count *= 2)
+        {
+            counts.push_back(count);
+        }
+        counts.push_back(maxThreads);
+        return counts;
+    }
+}
+
+// Benchmarks [--quick] [name]: runs every benchmark, or the one given.
+int main(int argc, char **argv)
+{
+    bool quick = false;
+    const char *name = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--quick") == 0)
+        {
+            quick = true;
+        }
+        else
+        {
+            name = argv[i];
+        }
+    }
+
+    Benchmark::State state(quick);
+    size_t numRun = 0;
+    for (const Benchmark::Case &benchmarkCase : Benchmark::GetCases())
+    {
+        if (name && std::strcmp(name, benchmarkCase.name) != 0)
+        {
+            continue;
+        }
+
+        std::printf("%s\n", benchmarkCase.name);
+        benchmarkCase.function(state);
+        numRun++;
+    }
+
+    if (numRun == 0)
+    {
+        std::fprintf(stderr, "No benchmark named %s\n", name ? name : "(any)");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "Benchmark.h"
+
+#include "FenceWaiter.h"
+#include "SimulatedFence.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+
+    // What a blocking wait oversleeps by, a typical scheduler wake-up.
+    constexpr std::chrono::microseconds g_wakeUpLatency = std::chrono::microseconds(60);
+
+    struct Workload
+    {
+        const char *name;
+        // GPU time left when the wait starts, the fence completes after it.
+        std::vector<double> durationsMs;
+    };
+
+    std::vector<Workload> MakeWorkloads(size_t numWaits)
+    {
+        std::mt19937 random(8);
+        std::normal_distribution<double> jitter(0.0, 0.02);
+
+        Workload shortWaits = {"0.2 ms waits", {}};
+        Workload longWaits = {"2 ms waits", {}};
+        Workload mixedWaits = {"0.1 ms waits with a 2 ms one every 8", {}};
+        for (size_t i = 0; i < numWaits; i++)
+        {
+            shortWaits.durationsMs.push_back(std::max(0.2 + jitter(random), 0.01));
+            longWaits.durationsMs.push_back(2.0 + jitter(random));
+            mixedWaits.durationsMs.push_back(i % 8 == 7 ? 2.0 : std::max(0.1 + jitter(random), 0.01));
+        }
+        return {shortWaits, longWaits, mixedWaits};
+    }
+}
+
+// For every wait policy, how long the fence waits took against how long the
+// waiter predicted them to take and how long the simulated GPU work really
+// had left. The late column is the time lost after the fence completed, which
+// is what spinning saves over blocking.
+BENCHMARK(FenceWaiterPrediction)
+{
+    const size_t numWaits = state.Size(FenceWaiter::s_maxSamples, 4);
+    std::printf("  %-40s %-16s %10s %10s %10s %10s %8s\n", "", "", "predicted", "measured", "error", "late", "blocked");
+
+    for (const Workload &workload : MakeWorkloads(numWaits))
+    {
+        for (size_t i = 0; i < static_cast<size_t>(FenceWaiter::Policy::Count); i++)
+        {
+            FenceWaiter::Policy policy = static_cast<FenceWaiter::Policy>(i);
+            FenceWaiter waiter;
+            waiter.SetPolicy(policy);
+            SimulatedFence fence(g_wakeUpLatency);
+
+            for (size_t wait = 0; wait < numWaits; wait++)
+            {
+                uint64_t fenceValue = wait + 1;
+                std::chrono::steady_clock::time_point completionTime = std::chrono::steady_clock::now() +
+                                                                       std::chrono::duration_cast<std::chrono::steady_clock::duration>(Milliseconds(workload.durationsMs[wait]));
+                fence.Schedule(fenceValue, completionTime);
+                waiter.Wait(fence, fenceValue);
+            }
+
+            // Every wait started before its fence completed, there is a sample per wait.
+            std::vector<FenceWaiter::Sample> samples;
+            waiter.GetSamples(samples);
+            double predictedMs = 0.0;
+            double measuredMs = 0.0;
+            double errorMs = 0.0;
+            double lateMs = 0.0;
+            size_t numBlocked = 0;
+            for (size_t wait = 0; wait < samples.size(); wait++)
+            {
+                const FenceWaiter::Sample &sample = samples[wait];
+                predictedMs += sample.predictedMs;
+                measuredMs += sample.actualMs;
+                errorMs += std::abs(sample.actualMs - sample.predictedMs);
+                lateMs += sample.actualMs - workload.durationsMs[wait];
+                numBlocked += sample.blocked ? 1 : 0;
+            }
+
+            double numSamples = static_cast<double>(std::max<size_t>(samples.size(), 1));
+            std::printf("  %-40s %-16s %7.3f ms %7.3f ms %7.3f ms %7.3f ms %7.0f%%\n", workload.name, FenceWaiter::GetPolicyName(policy),
+                        predictedMs / numSamples, measuredMs / numSamples, errorMs / numSamples, lateMs / numSamples, 100.0 * static_cast<double>(numBlocked) / numSamples);
+        }
+    }
+}
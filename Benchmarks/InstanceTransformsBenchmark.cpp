@@ -0,0 +1,98 @@
+#include "Benchmark.h"
+
+#include "Math/InstanceTransforms.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace InstanceTransforms;
+
+namespace
+{
+    struct Instances
+    {
+        std::vector<float> scale;
+        std::vector<float> angle;
+        std::vector<float> axisX;
+        std::vector<float> axisY;
+        std::vector<float> axisZ;
+        std::vector<float> offsetX;
+        std::vector<float> offsetY;
+        std::vector<float> offsetZ;
+
+        explicit Instances(size_t count)
+            : scale(count, 0.5f), angle(count), axisX(count, 0.0f), axisY(count, 1.0f / std::sqrt(2.0f)), axisZ(count, 1.0f / std::sqrt(2.0f)),
+              offsetX(count), offsetY(count), offsetZ(count, 0.0f)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                angle[i] = static_cast<float>(i % 360) * 0.1f;
+                offsetX[i] = static_cast<float>(i % 1000);
+                offsetY[i] = static_cast<float>(i / 1000);
+            }
+        }
+
+        InstanceSoA GetSoA() const
+        {
+            return {scale.data(), angle.data(), axisX.data(), axisY.data(), axisZ.data(), offsetX.data(), offsetY.data(), offsetZ.data()};
+        }
+    };
+}
+
+// Instances composed per second by every kernel, into cached memory and with
+// the streaming stores used for upload heaps. The small count stays in the
+// caches and measures the kernels, the large one is bound by memory bandwidth.
+// The staged case is the upload path the streaming stores replaced: compose
+// into a staging array, then copy it into the upload buffer.
+BENCHMARK(InstanceTransformKernels)
+{
+    const Kernel kernels[] = {Kernel::Reference, Kernel::Scalar, Kernel::SSE, Kernel::AVX2};
+    for (size_t count : {state.Size(16'384, 256), state.Size(1'000'000, 1'000)})
+    {
+        Instances instances(count);
+        std::vector<Float4x4> transforms(count);
+        std::vector<Float4x4> stagingTransforms(count);
+        std::vector<CompactInstance> compactTransforms(count);
+
+        double scalarMs = 0.0;
+        for (Kernel kernel : kernels)
+        {
+            if (!IsKernelSupported(kernel))
+            {
+                std::printf("  %s is not supported here, skipped\n", GetKernelName(kernel));
+                continue;
+            }
+
+            for (StoreMode mode : {StoreMode::Cached, StoreMode::Streaming})
+            {
+                char label[64];
+                std::snprintf(label, sizeof(label), "%zu instances, %s %s", count, GetKernelName(kernel), mode == StoreMode::Cached ? "cached" : "streaming");
+                double ms = state.Measure(label, count, [&]()
+                                          { Compose(kernel, instances.GetSoA(), 0, count, transforms.data(), mode); });
+
+                if (kernel == Kernel::Scalar && mode == StoreMode::Cached)
+                {
+                    scalarMs = ms;
+                }
+                else if (kernel != Kernel::Reference && mode == StoreMode::Cached && ms > 0.0)
+                {
+                    std::printf("  %-48s %10.2fx\n", "  speedup over scalar", scalarMs / ms);
+                }
+            }
+
+            char label[64];
+            std::snprintf(label, sizeof(label), "%zu instances, %s staged + memcpy", count, GetKernelName(kernel));
+            state.Measure(label, count, [&]()
+                          {
+                              Compose(kernel, instances.GetSoA(), 0, count, stagingTransforms.data());
+                              std::memcpy(transforms.data(), stagingTransforms.data(), count * sizeof(Float4x4)); });
+        }
+
+        char label[64];
+        std::snprintf(label, sizeof(label), "%zu instances, compact %s", count, GetKernelName(GetBestKernel()));
+        state.Measure(label, count, [&]()
+                      { Compose(GetBestKernel(), instances.GetSoA(), 0, count, compactTransforms.data()); });
+    }
+}
@@ -0,0 +1,92 @@
+#include "Benchmark.h"
+
+#include "JobSystem.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    // Runs the whole range as one chunk on a single thread job system, so the
+    // baseline executes the same compiled chunk function as the parallel runs
+    // and only the scheduling differs.
+    template <typename Function>
+    double MeasureSerial(Benchmark::State &state, size_t count, Function &work)
+    {
+        JobSystem jobSystem(1);
+        return state.Measure("serial, one chunk", count, [&]()
+                             { jobSystem.ParallelFor(0, count, count, work); });
+    }
+
+    void PrintSpeedup(double serialMs, double ms)
+    {
+        std::printf("  %-48s %10.2fx\n", "  speedup over serial", ms > 0.0 ? serialMs / ms : 0.0);
+    }
+}
+
+// ParallelFor over compute bound work, a few transcendentals per element, with
+// the grain size the renderer uses and with a grain size small enough for the
+// cost of submitting and stealing jobs to show.
+BENCHMARK(JobSystemParallelForScaling)
+{
+    const size_t count = state.Size(4'000'000, 4'000);
+    std::vector<float> values(count);
+
+    auto work = [&values](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            float x = static_cast<float>(i) * 1e-3f;
+            values[i] = std::sin(x) * std::cos(x) + std::sqrt(x);
+        }
+    };
+
+    double serialMs = MeasureSerial(state, count, work);
+
+    JobSystem jobSystem(1);
+    for (uint32_t numThreads : Benchmark::GetThreadCounts())
+    {
+        jobSystem.SetNumThreads(numThreads);
+        size_t grainSize = jobSystem.ComputeGrainSize(count, sizeof(float));
+        std::printf("  %u threads, grain size %zu\n", numThreads, grainSize);
+
+        double ms = state.Measure("ParallelFor", count, [&]()
+                                  { jobSystem.ParallelFor(0, count, grainSize, work); });
+        PrintSpeedup(serialMs, ms);
+
+        ms = state.Measure("ParallelFor, 256 element grain", count, [&]()
+                           { jobSystem.ParallelFor(0, count, 256, work); });
+        PrintSpeedup(serialMs, ms);
+    }
+}
+
+// ParallelFor over memory bound work, which stops scaling once the memory
+// bandwidth is saturated.
+BENCHMARK(JobSystemParallelForBandwidth)
+{
+    const size_t count = state.Size(16'000'000, 4'000);
+    std::vector<float> source(count, 1.0f);
+    std::vector<float> destination(count);
+
+    auto work = [&source, &destination](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            destination[i] = source[i] * 2.0f + destination[i];
+        }
+    };
+
+    double serialMs = MeasureSerial(state, count, work);
+
+    JobSystem jobSystem(1);
+    for (uint32_t numThreads : Benchmark::GetThreadCounts())
+    {
+        jobSystem.SetNumThreads(numThreads);
+        std::printf("  %u threads\n", numThreads);
+
+        double ms = state.Measure("ParallelFor", count, [&]()
+                                  { jobSystem.ParallelFor(0, count, jobSystem.ComputeGrainSize(count, 2 * sizeof(float)), work); });
+        PrintSpeedup(serialMs, ms);
+    }
+}
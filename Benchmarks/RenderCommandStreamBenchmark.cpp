@@ -0,0 +1,111 @@
+#include "Benchmark.h"
+
+#include "JobSystem.h"
+#include "RenderCommandStream.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+    struct Draw
+    {
+        RenderCommandStream::PipelineHandle pipeline;
+        uint64_t vertexBufferAddress;
+        uint64_t indexBufferAddress;
+        uint32_t constants[16];
+    };
+
+    // Draws spread over a few pipelines and meshes, in no particular order.
+    std::vector<Draw> MakeDraws(size_t numDraws)
+    {
+        std::mt19937 random(5);
+        std::vector<Draw> draws(numDraws);
+        for (Draw &draw : draws)
+        {
+            draw.pipeline = random() % 16;
+            uint64_t mesh = random() % 64;
+            draw.vertexBufferAddress = 0x10000000 + mesh * 0x100000;
+            draw.indexBufferAddress = 0x80000000 + mesh * 0x10000;
+            for (uint32_t &constant : draw.constants)
+            {
+                constant = random();
+            }
+        }
+        return draws;
+    }
+
+    void Record(RenderCommandStream &stream, const std::vector<Draw> &draws, size_t begin, size_t end)
+    {
+        stream.Reset();
+        for (size_t i = begin; i < end; i++)
+        {
+            const Draw &draw = draws[i];
+            stream.SetPipeline(draw.pipeline);
+            stream.SetVertexBuffer(0, draw.vertexBufferAddress, 64 * 1024, 32);
+            stream.SetIndexBuffer(draw.indexBufferAddress, 16 * 1024, 2);
+            stream.SetRootConstants(0, draw.constants, 16);
+            stream.DrawIndexedInstanced(36, 1, 0, 0, static_cast<uint32_t>(i));
+            if (i % 1000 == 999)
+            {
+                stream.Barrier(0, RenderCommandStream::ResourceState::ShaderResource);
+            }
+        }
+    }
+}
+
+// Draws recorded per second, each setting its pipeline, buffers and 16 root
+// constants, into a stream reset every frame as the renderer does. Then the
+// sort by state of the recorded stream.
+BENCHMARK(RenderCommandStreamRecording)
+{
+    const size_t numDraws = state.Size(100'000, 1'000);
+    std::vector<Draw> draws = MakeDraws(numDraws);
+    RenderCommandStream stream;
+
+    state.Measure("record", numDraws, [&]()
+                  { Record(stream, draws, 0, numDraws); });
+    state.Measure("sort", numDraws, [&]()
+                  { stream.Sort(); });
+}
+
+// The same draws split over one stream per job, recorded with ParallelFor as
+// the renderer's recording jobs do. The streams are independent, recording
+// should scale with the thread count until memory bandwidth runs out.
+BENCHMARK(RenderCommandStreamParallelRecording)
+{
+    const size_t numDraws = state.Size(100'000, 1'000);
+    const size_t numStreams = 64;
+    std::vector<Draw> draws = MakeDraws(numDraws);
+    std::vector<RenderCommandStream> streams(numStreams);
+
+    auto record = [&](size_t begin, size_t end)
+    {
+        for (size_t stream = begin; stream < end; stream++)
+        {
+            Record(streams[stream], draws, stream * numDraws / numStreams, (stream + 1) * numDraws / numStreams);
+        }
+    };
+
+    JobSystem jobSystem(1);
+    double singleThreadMs = 0.0;
+    for (uint32_t numThreads : Benchmark::GetThreadCounts())
+    {
+        jobSystem.SetNumThreads(numThreads);
+
+        char label[64];
+        std::snprintf(label, sizeof(label), "%u threads, %zu streams", numThreads, numStreams);
+        double ms = state.Measure(label, numDraws, [&]()
+                                  { jobSystem.ParallelFor(0, numStreams, 1, record); });
+        if (numThreads == 1)
+        {
+            singleThreadMs = ms;
+        }
+        else
+        {
+            std::printf("  %-48s %10.2fx\n", "  speedup over 1 thread", ms > 0.0 ? singleThreadMs / ms : 0.0);
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#include "SimulatedFence.h"
+
+#include <algorithm>
+#include <cassert>
+#include <thread>
+
+SimulatedFence::SimulatedFence(std::chrono::microseconds wakeUpLatency)
+    : m_wakeUpLatency(wakeUpLatency)
+{
+}
+
+void SimulatedFence::Schedule(uint64_t fenceValue, std::chrono::steady_clock::time_point completionTime)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_scheduledValues.push_back({fenceValue, completionTime});
+}
+
+uint64_t SimulatedFence::GetCompletedValue() const
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t completedValue = 0;
+    for (const ScheduledValue &scheduledValue : m_scheduledValues)
+    {
+        if (scheduledValue.completionTime <= now)
+        {
+            completedValue = std::max(completedValue, scheduledValue.fenceValue);
+        }
+    }
+    return completedValue;
+}
+
+void SimulatedFence::Block(uint64_t fenceValue)
+{
+    std::chrono::steady_clock::time_point completionTime = std::chrono::steady_clock::time_point::max();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const ScheduledValue &scheduledValue : m_scheduledValues)
+        {
+            if (scheduledValue.fenceValue >= fenceValue)
+            {
+                completionTime = std::min(completionTime, scheduledValue.completionTime);
+            }
+        }
+    }
+    assert(completionTime != std::chrono::steady_clock::time_point::max() && "Blocking on a fence value that never completes.");
+
+    std::this_thread::sleep_until(completionTime + m_wakeUpLatency);
+}
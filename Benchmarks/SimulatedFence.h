@@ -0,0 +1,33 @@
+#pragma once
+
+#include "FenceWaiter.h"
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Fence whose values complete at scheduled times, to run the wait policies
+// without a GPU. Blocking oversleeps by the wake-up latency, like an OS wait.
+class SimulatedFence : public FenceWaiter::Fence
+{
+public:
+    explicit SimulatedFence(std::chrono::microseconds wakeUpLatency);
+
+    // The fence reaches fenceValue once completionTime has passed.
+    void Schedule(uint64_t fenceValue, std::chrono::steady_clock::time_point completionTime);
+
+    uint64_t GetCompletedValue() const override;
+    void Block(uint64_t fenceValue) override;
+
+private:
+    struct ScheduledValue
+    {
+        uint64_t fenceValue;
+        std::chrono::steady_clock::time_point completionTime;
+    };
+
+    std::chrono::microseconds m_wakeUpLatency;
+    mutable std::mutex m_mutex;
+    std::vector<ScheduledValue> m_scheduledValues;
+};
@@ -0,0 +1,244 @@
+#include "Benchmark.h"
+
+#include "TlsfAllocator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+    constexpr uint64_t g_smallAlignment = 4 * 1024;
+    constexpr uint64_t g_defaultAlignment = 64 * 1024;
+    constexpr uint64_t g_heapSize = 64 * 1024 * 1024;
+
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    struct Request
+    {
+        // Index of the request whose resource is released, or creates a resource when none.
+        size_t release;
+        uint64_t size;
+        uint64_t alignment;
+    };
+
+    constexpr size_t g_create = SIZE_MAX;
+
+    // Resource creations and releases with sizes as D3D12 reports them: small
+    // textures in 4 KB pages, buffers and other textures in 64 KB ones.
+    std::vector<Request> MakeWorkload(size_t numRequests, size_t numLive)
+    {
+        std::mt19937 random(99);
+        std::vector<Request> requests;
+        std::vector<size_t> live;
+        for (size_t i = 0; i < numRequests; i++)
+        {
+            if (live.size() >= numLive || (!live.empty() && random() % 2 == 0))
+            {
+                size_t index = random() % live.size();
+                requests.push_back({live[index], 0, 0});
+                live[index] = live.back();
+                live.pop_back();
+                continue;
+            }
+
+            uint32_t kind = random() % 10;
+            if (kind < 6)
+            {
+                requests.push_back({g_create, g_smallAlignment * (1 + random() % 15), g_smallAlignment});
+            }
+            else if (kind < 9)
+            {
+                requests.push_back({g_create, AlignUp(64 * 1024 + random() % (4 << 20), g_defaultAlignment), g_defaultAlignment});
+            }
+            else
+            {
+                requests.push_back({g_create, AlignUp((4 << 20) + random() % (28 << 20), g_defaultAlignment), g_defaultAlignment});
+            }
+            live.push_back(requests.size() - 1);
+        }
+        return requests;
+    }
+
+    struct Footprint
+    {
+        size_t heapCreations = 0;
+        uint64_t reservedBytes = 0;
+        uint64_t peakReservedBytes = 0;
+        uint64_t usedBytes = 0;
+        uint64_t peakUsedBytes = 0;
+    };
+
+    // Before TlsfAllocator every resource was committed: an implicit heap of its
+    // own, created by the driver and at least 64 KB aligned.
+    Footprint ReplayCommitted(const std::vector<Request> &requests)
+    {
+        Footprint footprint;
+        for (const Request &request : requests)
+        {
+            const Request &resource = request.release == g_create ? request : requests[request.release];
+            uint64_t reserved = AlignUp(resource.size, g_defaultAlignment);
+            if (request.release == g_create)
+            {
+                footprint.heapCreations++;
+                footprint.reservedBytes += reserved;
+                footprint.usedBytes += resource.size;
+            }
+            else
+            {
+                footprint.reservedBytes -= reserved;
+                footprint.usedBytes -= resource.size;
+            }
+            footprint.peakReservedBytes = std::max(footprint.peakReservedBytes, footprint.reservedBytes);
+            footprint.peakUsedBytes = std::max(footprint.peakUsedBytes, footprint.usedBytes);
+        }
+        return footprint;
+    }
+
+    // The placement policy of GpuMemoryAllocator: the first heap of the pool
+    // that fits, a new one when none does, empty heaps beyond the first released.
+    class PlacedHeaps
+    {
+    public:
+        explicit PlacedHeaps(size_t numRequests) : m_placements(numRequests) {}
+
+        void Replay(const std::vector<Request> &requests)
+        {
+            for (size_t i = 0; i < requests.size(); i++)
+            {
+                if (requests[i].release == g_create)
+                {
+                    Create(i, requests[i]);
+                }
+                else
+                {
+                    Release(requests[i].release);
+                }
+            }
+        }
+
+        const Footprint &GetFootprint() const { return m_footprint; }
+
+    private:
+        struct Placement
+        {
+            TlsfAllocator *heap;
+            TlsfAllocator::Handle handle;
+            uint64_t size;
+        };
+
+        void Create(size_t index, const Request &request)
+        {
+            TlsfAllocator::Allocation allocation = {0, TlsfAllocator::s_invalidHandle};
+            TlsfAllocator *heap = nullptr;
+            for (std::unique_ptr<TlsfAllocator> &candidate : m_heaps)
+            {
+                allocation = candidate->Allocate(request.size, request.alignment);
+                if (allocation.handle != TlsfAllocator::s_invalidHandle)
+                {
+                    heap = candidate.get();
+                    break;
+                }
+            }
+
+            if (!heap)
+            {
+                m_heaps.push_back(std::make_unique<TlsfAllocator>(std::max(g_heapSize, AlignUp(request.size, g_defaultAlignment))));
+                heap = m_heaps.back().get();
+                allocation = heap->Allocate(request.size, request.alignment);
+                m_footprint.heapCreations++;
+                m_footprint.reservedBytes += heap->GetSize();
+            }
+
+            m_placements[index] = {heap, allocation.handle, request.size};
+            m_footprint.usedBytes += request.size;
+            m_footprint.peakReservedBytes = std::max(m_footprint.peakReservedBytes, m_footprint.reservedBytes);
+            m_footprint.peakUsedBytes = std::max(m_footprint.peakUsedBytes, m_footprint.usedBytes);
+        }
+
+        void Release(size_t index)
+        {
+            Placement &placement = m_placements[index];
+            placement.heap->Free(placement.handle);
+            m_footprint.usedBytes -= placement.size;
+
+            if (placement.heap->GetNumAllocations() == 0 && m_heaps.size() > 1)
+            {
+                m_footprint.reservedBytes -= placement.heap->GetSize();
+                std::erase_if(m_heaps, [&placement](const std::unique_ptr<TlsfAllocator> &heap)
+                              { return heap.get() == placement.heap; });
+            }
+        }
+
+        std::vector<std::unique_ptr<TlsfAllocator>> m_heaps;
+        std::vector<Placement> m_placements;
+        Footprint m_footprint;
+    };
+
+    void PrintFootprint(const char *name, const Footprint &footprint)
+    {
+        std::printf("  %-48s %6zu heaps created, %8.1f MB peak reserved for %8.1f MB peak used\n",
+                    name, footprint.heapCreations, static_cast<double>(footprint.peakReservedBytes) / 1e6, static_cast<double>(footprint.peakUsedBytes) / 1e6);
+    }
+}
+
+// Allocate and free throughput of a single allocator, with random sizes and
+// alignments and a steady number of live allocations.
+BENCHMARK(TlsfAllocatorChurn)
+{
+    const size_t numOperations = state.Size(1'000'000, 1'000);
+    const size_t numLive = state.Size(10'000, 100);
+
+    std::mt19937 random(3);
+    std::vector<uint64_t> sizes(numOperations);
+    std::vector<uint64_t> alignments(numOperations);
+    std::vector<size_t> victims(numOperations);
+    for (size_t i = 0; i < numOperations; i++)
+    {
+        sizes[i] = 1 + random() % (1 << (4 + random() % 14));
+        alignments[i] = uint64_t(1) << (random() % 9);
+        victims[i] = random() % numLive;
+    }
+
+    state.Measure("allocate + free, 10k live", 2 * numOperations, [&]()
+                  {
+        TlsfAllocator allocator(uint64_t(1) << 32);
+        std::vector<TlsfAllocator::Handle> live;
+        live.reserve(numLive);
+        for (size_t i = 0; i < numOperations; i++)
+        {
+            if (live.size() == numLive)
+            {
+                size_t victim = victims[i];
+                allocator.Free(live[victim]);
+                live[victim] = live.back();
+                live.pop_back();
+            }
+            live.push_back(allocator.Allocate(sizes[i], alignments[i]).handle);
+        } });
+}
+
+// The same resource workload placed the way GpuMemoryAllocator does it and the
+// way it was done before, with a committed resource each. The driver's cost of
+// a committed resource cannot be measured here, its heap creations are counted.
+BENCHMARK(TlsfAllocatorVsCommittedResources)
+{
+    const size_t numRequests = state.Size(200'000, 2'000);
+    std::vector<Request> requests = MakeWorkload(numRequests, state.Size(2'000, 100));
+
+    PrintFootprint("committed resources", ReplayCommitted(requests));
+
+    Footprint placed;
+    state.Measure("placed in 64 MB TLSF heaps, CPU time", numRequests, [&]()
+                  {
+        PlacedHeaps heaps(requests.size());
+        heaps.Replay(requests);
+        placed = heaps.GetFootprint(); });
+    PrintFootprint("placed in 64 MB TLSF heaps", placed);
+}
@@ -0,0 +1,68 @@
+#include "Benchmark.h"
+
+#include "JobSystem.h"
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // A single chain, every level holds one node.
+    std::vector<TransformHierarchy::NodeIndex> MakeChain(size_t numNodes)
+    {
+        std::vector<TransformHierarchy::NodeIndex> parents(numNodes);
+        parents[0] = TransformHierarchy::s_noParent;
+        for (size_t i = 1; i < numNodes; i++)
+        {
+            parents[i] = static_cast<TransformHierarchy::NodeIndex>(i - 1);
+        }
+        return parents;
+    }
+
+    // Every node has fanOut children, so the levels grow quickly.
+    std::vector<TransformHierarchy::NodeIndex> MakeWideTree(size_t numNodes, size_t fanOut)
+    {
+        std::vector<TransformHierarchy::NodeIndex> parents(numNodes);
+        parents[0] = TransformHierarchy::s_noParent;
+        for (size_t i = 1; i < numNodes; i++)
+        {
+            parents[i] = static_cast<TransformHierarchy::NodeIndex>((i - 1) / fanOut);
+        }
+        return parents;
+    }
+
+    void MeasureUpdates(Benchmark::State &state, const char *name, const std::vector<TransformHierarchy::NodeIndex> &parents, JobSystem &jobSystem)
+    {
+        TransformHierarchy hierarchy;
+        hierarchy.Build(parents);
+        std::printf("  %s: %zu nodes on %zu levels\n", name, hierarchy.GetNumNodes(), hierarchy.GetNumLevels());
+
+        // Moving the root dirties every node.
+        TransformHierarchy::Transform root;
+        state.Measure("serial update", parents.size(), [&]()
+                      {
+            root.position[0] += 1.0f;
+            hierarchy.SetLocalTransform(0, root);
+            hierarchy.Update(); });
+        state.Measure("job system update", parents.size(), [&]()
+                      {
+            root.position[0] += 1.0f;
+            hierarchy.SetLocalTransform(0, root);
+            hierarchy.Update(jobSystem); });
+    }
+}
+
+// World transforms recomputed per second, for a deep chain where every level is
+// a single node and the per-level cost of the update dominates, and for a wide
+// tree where the levels are large enough to be split across the job system.
+BENCHMARK(TransformHierarchyUpdate)
+{
+    JobSystem jobSystem(std::max(1u, std::thread::hardware_concurrency()));
+    std::printf("  %u threads\n", jobSystem.GetNumThreads());
+
+    MeasureUpdates(state, "deep chain", MakeChain(state.Size(10'000, 100)), jobSystem);
+    MeasureUpdates(state, "wide tree", MakeWideTree(state.Size(1'000'000, 1'000), 16), jobSystem);
+}
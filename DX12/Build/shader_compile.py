@@ -6,6 +6,7 @@ from argparse import ArgumentParser
 import glob
 import json
 import shlex
+import re
 
 script_dir_path = Path(os.path.dirname(os.path.realpath(__file__)))
 
@@ -54,6 +55,26 @@ if not fxc_path.exists:
     print(f"given sdk path \"{windows_sdk_root}\" does not contain the effect-compiler tool (fxc.exe)")
     exit()
 
+include_pattern = re.compile(r'^\s*#\s*include\s*"([^"]+)"', re.MULTILINE)
+
+def hash_source(source_file, visited=None):
+    # Hash the source together with everything it includes, so that editing a
+    # shared header recompiles the shaders using it.
+    if visited is None:
+        visited = set()
+    source_file = source_file.resolve()
+    if source_file in visited or not source_file.exists():
+        return ""
+    visited.add(source_file)
+
+    with source_file.open() as source_contents:
+        contents = source_contents.read()
+
+    source_hash = hashlib.md5(contents.encode())
+    for include in include_pattern.findall(contents):
+        source_hash.update(hash_source(source_file.parent.joinpath(include), visited).encode())
+    return source_hash.hexdigest()
+
 with script_dir_path.joinpath("shader_profiles.json").open() as shader_profiles_file:
     shader_profiles = json.load(shader_profiles_file)
 
@@ -67,8 +88,7 @@ for profile in shader_profiles:
         input_file_path = str(input_file)
         output_file = output_path.joinpath(file).with_suffix(".cso")
         
-        with input_file.open() as input_contents:
-            input_hash = hashlib.md5(input_contents.read().encode()).hexdigest()
+        input_hash = hash_source(input_file)
 
         cache_hash = in_cache.pop(input_file_path, None)
         if cache_hash is not None:
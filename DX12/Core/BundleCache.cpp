@@ -0,0 +1,55 @@
+#include "BundleCache.h"
+
+#include "Engine.h"
+
+#include <cassert>
+#include <utility>
+
+BundleCache::BundleCache(Microsoft::WRL::ComPtr<ID3D12Device2> device)
+    : m_device(device)
+{
+}
+
+ID3D12GraphicsCommandList2 *BundleCache::GetBundle(Key key, const RecordFunction &record)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto cached = m_bundles.find(key);
+    if (cached != m_bundles.end())
+    {
+        m_numHits.fetch_add(1, std::memory_order_relaxed);
+        return cached->second.commandList.Get();
+    }
+
+    // Each bundle keeps an allocator of its own, it is never reset.
+    Bundle bundle;
+    assert(SUCCEEDED(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_BUNDLE, IID_PPV_ARGS(&bundle.commandAllocator))));
+    assert(SUCCEEDED(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_BUNDLE, bundle.commandAllocator.Get(), nullptr, IID_PPV_ARGS(&bundle.commandList))));
+
+    record(bundle.commandList.Get());
+    assert(SUCCEEDED(bundle.commandList->Close()));
+    m_numRecords.fetch_add(1, std::memory_order_relaxed);
+
+    return m_bundles.emplace(key, std::move(bundle)).first->second.commandList.Get();
+}
+
+void BundleCache::Invalidate()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_bundles.empty())
+    {
+        return;
+    }
+
+    // Command lists that execute the bundles may still be in flight.
+    Engine::Get().DeferRelease([bundles = std::move(m_bundles)]() mutable
+                               { bundles.clear(); });
+    m_bundles.clear();
+    m_numInvalidations++;
+}
+
+size_t BundleCache::GetNumBundles() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bundles.size();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+// Records draw sequences that do not change between frames into bundles once,
+// command lists then replay them with ExecuteBundle. Bundles are looked up by a
+// key the caller chooses, and the caller invalidates the cache whenever
+// anything recorded into them changes, such as the pipeline state, buffer views
+// or draw ranges. Bundles cannot set render targets, viewports or barriers.
+// They inherit the root signature and its arguments from the executing command
+// list, so per-frame constants stay out of them. Thread-safe, bundles are
+// recorded under a lock.
+class BundleCache
+{
+public:
+    using Key = uint64_t;
+    using RecordFunction = std::function<void(ID3D12GraphicsCommandList2 *bundle)>;
+
+    explicit BundleCache(Microsoft::WRL::ComPtr<ID3D12Device2> device);
+
+    BundleCache(const BundleCache &) = delete;
+    BundleCache(BundleCache &&) = delete;
+    BundleCache &operator=(const BundleCache &) = delete;
+    BundleCache &operator=(BundleCache &&) = delete;
+
+    // The bundle of the key, recorded by record when it is not cached.
+    ID3D12GraphicsCommandList2 *GetBundle(Key key, const RecordFunction &record);
+
+    // Drop every bundle. They are released once the GPU is done with the
+    // command lists executed so far.
+    void Invalidate();
+
+    size_t GetNumBundles() const;
+    uint64_t GetNumHits() const { return m_numHits.load(std::memory_order_relaxed); }
+    uint64_t GetNumRecords() const { return m_numRecords.load(std::memory_order_relaxed); }
+    size_t GetNumInvalidations() const { return m_numInvalidations; }
+
+private:
+    struct Bundle
+    {
+        Microsoft::WRL::ComPtr<ID3D12CommandAllocator> commandAllocator;
+        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList;
+    };
+
+    Microsoft::WRL::ComPtr<ID3D12Device2> m_device;
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<Key, Bundle> m_bundles;
+
+    std::atomic<uint64_t> m_numHits = 0;
+    std::atomic<uint64_t> m_numRecords = 0;
+    size_t m_numInvalidations = 0;
+};
@@ -0,0 +1,147 @@
+#include "CommandLine.h"
+
+#include <cerrno>
+#include <cwchar>
+#include <cwctype>
+#include <limits>
+
+namespace
+{
+    std::vector<std::wstring> Tokenize(const std::wstring &commandLine)
+    {
+        std::vector<std::wstring> tokens;
+        std::wstring token;
+        bool inToken = false;
+        bool inQuotes = false;
+
+        for (wchar_t character : commandLine)
+        {
+            if (character == L'"')
+            {
+                inQuotes = !inQuotes;
+                inToken = true;
+            }
+            else if (!inQuotes && std::iswspace(character))
+            {
+                if (inToken)
+                {
+                    tokens.push_back(token);
+                    token.clear();
+                    inToken = false;
+                }
+            }
+            else
+            {
+                token.push_back(character);
+                inToken = true;
+            }
+        }
+
+        if (inToken)
+        {
+            tokens.push_back(token);
+        }
+        return tokens;
+    }
+
+    bool IsName(const std::wstring &token)
+    {
+        // Negative numbers are values, not names.
+        return token.size() > 1 && token[0] == L'-' && !std::iswdigit(token[1]) && token[1] != L'.';
+    }
+}
+
+CommandLine::CommandLine(const std::wstring &commandLine)
+{
+    std::vector<std::wstring> tokens = Tokenize(commandLine);
+    for (size_t i = 0; i < tokens.size(); ++i)
+    {
+        if (!IsName(tokens[i]))
+        {
+            continue;
+        }
+
+        std::wstring name = tokens[i].substr(1);
+        std::wstring value;
+        if (i + 1 < tokens.size() && !IsName(tokens[i + 1]))
+        {
+            value = tokens[++i];
+        }
+        m_arguments.emplace_back(std::move(name), std::move(value));
+    }
+}
+
+bool CommandLine::HasFlag(const std::wstring &name) const
+{
+    return Find(name) != nullptr;
+}
+
+std::optional<std::wstring> CommandLine::GetValue(const std::wstring &name) const
+{
+    const std::pair<std::wstring, std::wstring> *argument = Find(name);
+    if (argument == nullptr || argument->second.empty())
+    {
+        return std::nullopt;
+    }
+    return argument->second;
+}
+
+std::wstring CommandLine::GetString(const std::wstring &name, const std::wstring &defaultValue) const
+{
+    return GetValue(name).value_or(defaultValue);
+}
+
+size_t CommandLine::GetSize(const std::wstring &name, size_t defaultValue) const
+{
+    std::optional<std::wstring> value = GetValue(name);
+    if (!value.has_value())
+    {
+        return defaultValue;
+    }
+
+    // wcstoull accepts a sign and wraps negative values around.
+    const wchar_t *begin = value->c_str();
+    while (std::iswspace(*begin))
+    {
+        begin++;
+    }
+    if (*begin == L'-')
+    {
+        return defaultValue;
+    }
+
+    wchar_t *end = nullptr;
+    errno = 0;
+    unsigned long long parsed = std::wcstoull(begin, &end, 10);
+    if (end == begin || *end != L'\0' || errno == ERANGE || parsed > std::numeric_limits<size_t>::max())
+    {
+        return defaultValue;
+    }
+    return static_cast<size_t>(parsed);
+}
+
+float CommandLine::GetFloat(const std::wstring &name, float defaultValue) const
+{
+    std::optional<std::wstring> value = GetValue(name);
+    if (!value.has_value())
+    {
+        return defaultValue;
+    }
+
+    wchar_t *end = nullptr;
+    float parsed = std::wcstof(value->c_str(), &end);
+    return end != value->c_str() && *end == L'\0' ? parsed : defaultValue;
+}
+
+const std::pair<std::wstring, std::wstring> *CommandLine::Find(const std::wstring &name) const
+{
+    // The last occurrence wins, so arguments can be overridden.
+    for (auto argument = m_arguments.rbegin(); argument != m_arguments.rend(); ++argument)
+    {
+        if (argument->first == name)
+        {
+            return &*argument;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Arguments of the form "-name value" or "-flag". Values containing spaces can be quoted.
+class CommandLine
+{
+public:
+    CommandLine() = default;
+    explicit CommandLine(const std::wstring &commandLine);
+
+    bool HasFlag(const std::wstring &name) const;
+    std::optional<std::wstring> GetValue(const std::wstring &name) const;
+
+    // Parsed values, or defaultValue when the argument is missing or malformed.
+    std::wstring GetString(const std::wstring &name, const std::wstring &defaultValue) const;
+    size_t GetSize(const std::wstring &name, size_t defaultValue) const;
+    float GetFloat(const std::wstring &name, float defaultValue) const;
+
+private:
+    const std::pair<std::wstring, std::wstring> *Find(const std::wstring &name) const;
+
+    // Names without the leading dash, flags have an empty value.
+    std::vector<std::pair<std::wstring, std::wstring>> m_arguments;
+};
@@ -1,8 +1,90 @@
 #include "CommandQueue.h"
 
+#include "ResourceStateTracker.h"
+
+#include <algorithm>
 #include <cassert>
+#include <exception>
+
+namespace
+{
+    // Identifies the CommandListContext pointer stored in a command list's private data.
+    constexpr GUID g_commandListContextGuid = {0x6c1f5a3e, 0x2b8d, 0x4e71, {0x9a, 0x04, 0x5f, 0xd2, 0x7e, 0x13, 0xc8, 0x6b}};
+
+    // Indices of the threads alive at the moment, reused once a thread exits.
+    // A thread inherits the command lists of the one that had its index before.
+    class ThreadIndex
+    {
+    public:
+        ThreadIndex()
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            if (s_freeIndices.empty())
+            {
+                m_index = s_numIndices++;
+            }
+            else
+            {
+                m_index = s_freeIndices.back();
+                s_freeIndices.pop_back();
+            }
+        }
+
+        ~ThreadIndex()
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_freeIndices.push_back(m_index);
+        }
+
+        ThreadIndex(const ThreadIndex &) = delete;
+        ThreadIndex(ThreadIndex &&) = delete;
+        ThreadIndex &operator=(const ThreadIndex &) = delete;
+        ThreadIndex &operator=(ThreadIndex &&) = delete;
+
+        uint32_t Get() const { return m_index; }
+
+    private:
+        static inline std::mutex s_mutex;
+        static inline std::vector<uint32_t> s_freeIndices;
+        static inline uint32_t s_numIndices = 0;
+
+        uint32_t m_index;
+    };
+
+    uint32_t GetThreadIndex()
+    {
+        thread_local ThreadIndex threadIndex;
+        return threadIndex.Get();
+    }
 
-CommandQueue::CommandQueue(Microsoft::WRL::ComPtr<ID3D12Device2> device, D3D12_COMMAND_LIST_TYPE type)
+    void UpdatePeak(std::atomic<size_t> &peak, size_t value)
+    {
+        size_t current = peak.load(std::memory_order_relaxed);
+        while (current < value && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    class CommandQueueFence : public FenceWaiter::Fence
+    {
+    public:
+        explicit CommandQueueFence(ID3D12Fence *fence) : m_fence(fence) {}
+
+        uint64_t GetCompletedValue() const override { return m_fence->GetCompletedValue(); }
+
+        void Block(uint64_t fenceValue) override
+        {
+            // Without an event the call blocks until the fence is reached, any
+            // number of threads may wait at the same time.
+            assert(SUCCEEDED(m_fence->SetEventOnCompletion(fenceValue, nullptr)));
+        }
+
+    private:
+        ID3D12Fence *m_fence;
+    };
+}
+
+CommandQueue::CommandQueue(Microsoft::WRL::ComPtr<ID3D12Device2> device, D3D12_COMMAND_LIST_TYPE type, uint32_t maxThreads)
     : m_CommandListType(type), m_d3d12Device(device), m_fenceValue(0)
 {
     D3D12_COMMAND_QUEUE_DESC desc = {};
@@ -12,10 +94,13 @@ CommandQueue::CommandQueue(Microsoft::WRL::ComPtr<ID3D12Device2> device, D3D12_C
     desc.NodeMask = 0;
 
     assert(SUCCEEDED(m_d3d12Device->CreateCommandQueue(&desc, IID_PPV_ARGS(&m_d3d12CommandQueue))));
-    assert(SUCCEEDED(m_d3d12Device->CreateFence(m_fenceValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_d3d12Fence))));
+    assert(SUCCEEDED(m_d3d12Device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_d3d12Fence))));
 
-    m_FenceEvent = ::CreateEvent(NULL, FALSE, FALSE, NULL);
-    assert(m_FenceEvent && "Failed to create fence event handle.");
+    m_threadPools.resize(maxThreads);
+    for (std::unique_ptr<ThreadPool> &threadPool : m_threadPools)
+    {
+        threadPool = std::make_unique<ThreadPool>();
+    }
 }
 
 CommandQueue::~CommandQueue()
@@ -40,68 +125,238 @@ Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> CommandQueue::CreateCommandLi
 
 Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> CommandQueue::GetCommandList()
 {
-    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> commandAllocator;
-    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList;
-
-    if (!m_CommandAllocatorQueue.empty() && IsFenceComplete(m_CommandAllocatorQueue.front().fenceValue))
+    uint32_t threadIndex = GetThreadIndex();
+    if (threadIndex >= m_threadPools.size())
     {
-        commandAllocator = m_CommandAllocatorQueue.front().commandAllocator;
-        m_CommandAllocatorQueue.pop();
+        // Release builds stop here too rather than index past the pools.
+        assert(false && "More threads acquire command lists than the queue was created for.");
+        std::terminate();
+    }
+    ThreadPool &threadPool = *m_threadPools[threadIndex];
 
-        assert(SUCCEEDED(commandAllocator->Reset()));
+    // Take over the command lists executed since the last call.
+    CommandListContext *returned = threadPool.returned.exchange(nullptr, std::memory_order_acquire);
+    for (; returned != nullptr; returned = returned->nextReturned)
+    {
+        threadPool.inFlight.push_back(returned);
     }
-    else
+
+    uint64_t completedFenceValue = GetCompletedFenceValue();
+    auto completed = std::find_if(threadPool.inFlight.begin(), threadPool.inFlight.end(), [completedFenceValue](const CommandListContext *context)
+                                  { return context->fenceValue <= completedFenceValue; });
+    if (completed == threadPool.inFlight.end() && threadPool.contexts.size() >= s_maxCommandListsPerThread && !threadPool.inFlight.empty())
     {
-        commandAllocator = CreateCommandAllocator();
+        // The pool is full, wait for the oldest command list instead of growing it.
+        completed = std::min_element(threadPool.inFlight.begin(), threadPool.inFlight.end(), [](const CommandListContext *a, const CommandListContext *b)
+                                     { return a->fenceValue < b->fenceValue; });
+        WaitForFenceValue((*completed)->fenceValue);
+        m_numCommandListWaits.fetch_add(1, std::memory_order_relaxed);
     }
 
-    if (!m_CommandListQueue.empty())
+    CommandListContext *context = nullptr;
+    if (completed != threadPool.inFlight.end())
     {
-        commandList = m_CommandListQueue.front();
-        m_CommandListQueue.pop();
+        context = *completed;
+        *completed = threadPool.inFlight.back();
+        threadPool.inFlight.pop_back();
 
-        assert(SUCCEEDED(commandList->Reset(commandAllocator.Get(), nullptr)));
+        assert(SUCCEEDED(context->commandAllocator->Reset()));
+        assert(SUCCEEDED(context->commandList->Reset(context->commandAllocator.Get(), nullptr)));
+        m_numCommandListReuses.fetch_add(1, std::memory_order_relaxed);
+        if (context->fenceValue != 0)
+        {
+            // Barrier command lists that turned out empty were never executed.
+            m_numCommandListsInFlight.fetch_sub(1, std::memory_order_relaxed);
+        }
     }
     else
     {
-        commandList = CreateCommandList(commandAllocator);
+        threadPool.contexts.push_back(std::make_unique<CommandListContext>());
+        context = threadPool.contexts.back().get();
+        context->commandAllocator = CreateCommandAllocator();
+        context->commandList = CreateCommandList(context->commandAllocator);
+        context->resourceStateTracker = std::make_unique<ResourceStateTracker>();
+        context->threadPool = &threadPool;
+        context->barrierContext = nullptr;
+
+        // Lets any thread find the context from the command list.
+        assert(SUCCEEDED(context->commandList->SetPrivateData(g_commandListContextGuid, sizeof(context), &context)));
+        m_numCommandLists.fetch_add(1, std::memory_order_relaxed);
+        UpdatePeak(m_maxCommandListsPerThread, threadPool.contexts.size());
     }
 
-    // Associate the command allocator with the command list so that it can be
-    // retrieved when the command list is executed.
-    assert(SUCCEEDED(commandList->SetPrivateDataInterface(__uuidof(ID3D12CommandAllocator), commandAllocator.Get())));
+    context->resourceStateTracker->Reset();
 
-    return commandList;
+    return context->commandList;
+}
+
+CommandQueue::AllocatorStats CommandQueue::GetAllocatorStats() const
+{
+    AllocatorStats stats = {};
+    stats.numCreated = m_numCommandLists.load(std::memory_order_relaxed);
+    stats.numReused = m_numCommandListReuses.load(std::memory_order_relaxed);
+    stats.numWaits = m_numCommandListWaits.load(std::memory_order_relaxed);
+    stats.maxPerThread = m_maxCommandListsPerThread.load(std::memory_order_relaxed);
+    stats.numInFlight = m_numCommandListsInFlight.load(std::memory_order_relaxed);
+    stats.maxInFlight = m_maxCommandListsInFlight.load(std::memory_order_relaxed);
+    return stats;
+}
+
+CommandQueue::CommandListContext &CommandQueue::GetCommandListContext(ID3D12GraphicsCommandList2 *commandList)
+{
+    CommandListContext *context = nullptr;
+    UINT dataSize = sizeof(context);
+    assert(SUCCEEDED(commandList->GetPrivateData(g_commandListContextGuid, &dataSize, &context)));
+
+    return *context;
+}
+
+ResourceStateTracker &CommandQueue::GetResourceStateTracker(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList)
+{
+    return *GetCommandListContext(commandList.Get()).resourceStateTracker;
 }
 
-uint64_t CommandQueue::ExecuteCommandList(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList)
+uint64_t CommandQueue::ExecuteCommandList(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList, std::span<const Dependency> dependencies)
 {
-    commandList->Close();
+    return ExecuteCommandLists({&commandList, 1}, dependencies);
+}
+
+uint64_t CommandQueue::ExecuteCommandLists(std::span<const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>> commandLists, std::span<const Dependency> dependencies)
+{
+    for (const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList : commandLists)
+    {
+        CommandListContext &context = GetCommandListContext(commandList.Get());
+        context.resourceStateTracker->FlushResourceBarriers(commandList.Get());
+        commandList->Close();
+
+        // Acquiring may wait for the GPU, which must not happen under the locks
+        // below. The barriers may all turn out to be redundant.
+        if (context.resourceStateTracker->HasPendingResourceBarriers())
+        {
+            context.barrierContext = &GetCommandListContext(GetCommandList().Get());
+        }
+    }
 
-    ID3D12CommandAllocator *commandAllocator;
-    UINT dataSize = sizeof(commandAllocator);
-    assert(SUCCEEDED(commandList->GetPrivateData(__uuidof(ID3D12CommandAllocator), &dataSize, &commandAllocator)));
+    // The global states must not change between resolving the pending
+    // barriers and committing the final states of the command lists.
+    std::unique_lock<std::mutex> globalStateLock = ResourceStateTracker::LockGlobalResourceStates();
+    std::lock_guard<std::mutex> submitLock(m_submitMutex);
 
-    ID3D12CommandList *const ppCommandLists[] = {commandList.Get()};
+    m_batchContexts.clear();
+    for (const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList : commandLists)
+    {
+        CommandListContext &context = GetCommandListContext(commandList.Get());
+        ResourceStateTracker &resourceStateTracker = *context.resourceStateTracker;
+
+        // The transitions into the states the command list starts with run in a
+        // command list of their own, right before it. The states are those the
+        // command lists before it in the batch leave behind.
+        if (context.barrierContext != nullptr)
+        {
+            CommandListContext &barrierContext = *context.barrierContext;
+            context.barrierContext = nullptr;
 
-    m_d3d12CommandQueue->ExecuteCommandLists(1, ppCommandLists);
-    uint64_t fenceValue = Signal();
+            m_pendingBarriers.clear();
+            resourceStateTracker.ResolvePendingResourceBarriers(m_pendingBarriers);
+            if (!m_pendingBarriers.empty())
+            {
+                barrierContext.commandList->ResourceBarrier(static_cast<UINT>(m_pendingBarriers.size()), m_pendingBarriers.data());
+                ResourceStateTracker::CountBarrierCall(m_pendingBarriers.size());
+            }
+            barrierContext.commandList->Close();
 
-    m_CommandAllocatorQueue.emplace(CommandAllocatorEntry{fenceValue, commandAllocator});
-    m_CommandListQueue.push(commandList);
+            if (m_pendingBarriers.empty())
+            {
+                // Never executed, it can be reused right away.
+                ReturnCommandListContext(barrierContext, 0);
+            }
+            else
+            {
+                m_batchContexts.push_back(&barrierContext);
+            }
+        }
 
-    // The ownership of the command allocator has been transferred to the ComPtr
-    // in the command allocator queue. It is safe to release the reference
-    // in this temporary COM pointer here.
-    commandAllocator->Release();
+        resourceStateTracker.CommitFinalResourceStates();
+        m_batchContexts.push_back(&context);
+    }
+    // The batch is a single ExecuteCommandLists call, states decay after all of it.
+    ResourceStateTracker::DecayGlobalResourceStates(m_CommandListType == D3D12_COMMAND_LIST_TYPE_COPY);
+    globalStateLock.unlock();
+
+    // Queued right before the command lists, work already on the queue keeps running.
+    for (const Dependency &dependency : dependencies)
+    {
+        InsertWait(*dependency.queue, dependency.fenceValue);
+    }
+
+    m_batchCommandLists.clear();
+    for (CommandListContext *context : m_batchContexts)
+    {
+        m_batchCommandLists.push_back(context->commandList.Get());
+    }
+
+    m_d3d12CommandQueue->ExecuteCommandLists(static_cast<UINT>(m_batchCommandLists.size()), m_batchCommandLists.data());
+    uint64_t fenceValue = m_fenceValue.load(std::memory_order_relaxed) + 1;
+    assert(SUCCEEDED(m_d3d12CommandQueue->Signal(m_d3d12Fence.Get(), fenceValue)));
+    m_fenceValue.store(fenceValue, std::memory_order_release);
+
+    m_numSubmissions.fetch_add(1, std::memory_order_relaxed);
+    m_numExecutedCommandLists.fetch_add(m_batchContexts.size(), std::memory_order_relaxed);
+    size_t numInFlight = m_numCommandListsInFlight.fetch_add(m_batchContexts.size(), std::memory_order_relaxed) + m_batchContexts.size();
+    UpdatePeak(m_maxCommandListsInFlight, numInFlight);
+
+    // Hand the contexts back to the threads that acquired them, all of them
+    // are recycled once the single fence value completes.
+    for (CommandListContext *context : m_batchContexts)
+    {
+        ReturnCommandListContext(*context, fenceValue);
+    }
 
     return fenceValue;
 }
 
+void CommandQueue::ReturnCommandListContext(CommandListContext &context, uint64_t fenceValue)
+{
+    context.fenceValue = fenceValue;
+
+    std::atomic<CommandListContext *> &returned = context.threadPool->returned;
+    CommandListContext *head = returned.load(std::memory_order_relaxed);
+    do
+    {
+        context.nextReturned = head;
+    } while (!returned.compare_exchange_weak(head, &context, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void CommandQueue::QueueCommandList(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList)
+{
+    std::lock_guard<std::mutex> lock(m_queuedCommandListsMutex);
+    m_queuedCommandLists.push_back(commandList);
+}
+
+uint64_t CommandQueue::ExecuteQueuedCommandLists()
+{
+    std::lock_guard<std::mutex> executingLock(m_executingCommandListsMutex);
+    {
+        std::lock_guard<std::mutex> lock(m_queuedCommandListsMutex);
+        std::swap(m_queuedCommandLists, m_executingCommandLists);
+    }
+
+    if (m_executingCommandLists.empty())
+    {
+        return GetLastSignaledFenceValue();
+    }
+
+    uint64_t fenceValue = ExecuteCommandLists(m_executingCommandLists);
+    m_executingCommandLists.clear();
+    return fenceValue;
+}
+
 uint64_t CommandQueue::Signal()
 {
-    uint64_t fenceValueForSignal = ++m_fenceValue;
+    std::lock_guard<std::mutex> submitLock(m_submitMutex);
+    uint64_t fenceValueForSignal = m_fenceValue.load(std::memory_order_relaxed) + 1;
     assert(SUCCEEDED(m_d3d12CommandQueue->Signal(m_d3d12Fence.Get(), fenceValueForSignal)));
+    m_fenceValue.store(fenceValueForSignal, std::memory_order_release);
 
     return fenceValueForSignal;
 }
@@ -111,13 +366,52 @@ bool CommandQueue::IsFenceComplete(uint64_t fenceValue)
     return m_d3d12Fence->GetCompletedValue() >= fenceValue;
 }
 
+uint64_t CommandQueue::GetCompletedFenceValue() const
+{
+    return m_d3d12Fence->GetCompletedValue();
+}
+
 void CommandQueue::WaitForFenceValue(uint64_t fenceValue)
 {
-    if (!IsFenceComplete(fenceValue))
+    CommandQueueFence fence(m_d3d12Fence.Get());
+    m_fenceWaiter.Wait(fence, fenceValue);
+}
+
+bool CommandQueue::Wait(const CommandQueue &other, uint64_t fenceValue)
+{
+    std::lock_guard<std::mutex> submitLock(m_submitMutex);
+    return InsertWait(other, fenceValue);
+}
+
+bool CommandQueue::InsertWait(const CommandQueue &other, uint64_t fenceValue)
+{
+    assert(&other != this && "A queue cannot wait for itself.");
+
+    // Nothing to wait for, not a wait that was avoided.
+    if (fenceValue == 0)
+    {
+        return false;
+    }
+
+    auto waited = std::find_if(m_waitedFenceValues.begin(), m_waitedFenceValues.end(), [&other](const std::pair<const CommandQueue *, uint64_t> &entry)
+                               { return entry.first == &other; });
+    if (waited == m_waitedFenceValues.end())
+    {
+        m_waitedFenceValues.push_back({&other, 0});
+        waited = m_waitedFenceValues.end() - 1;
+    }
+
+    // Waits on a queue are ordered, a later one covers every earlier fence value.
+    if (fenceValue <= waited->second || other.GetCompletedFenceValue() >= fenceValue)
     {
-        m_d3d12Fence->SetEventOnCompletion(fenceValue, m_FenceEvent);
-        ::WaitForSingleObject(m_FenceEvent, DWORD_MAX);
+        m_numSkippedGpuWaits.fetch_add(1, std::memory_order_relaxed);
+        return false;
     }
+
+    assert(SUCCEEDED(m_d3d12CommandQueue->Wait(other.m_d3d12Fence.Get(), fenceValue)));
+    waited->second = fenceValue;
+    m_numGpuWaits.fetch_add(1, std::memory_order_relaxed);
+    return true;
 }
 
 void CommandQueue::Flush()
@@ -1,53 +1,189 @@
 #pragma once
 
+#include "FenceWaiter.h"
+
 #include <d3d12.h>
 #include <wrl.h>
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
-#include <queue>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <utility>
+#include <vector>
+
+class ResourceStateTracker;
 
+// Command lists may be acquired, recorded and executed from any thread. Every
+// thread recycles the command lists it acquired, each with an allocator of its
+// own, so recording threads never contend. Executed command lists go back to
+// the pool of the thread that acquired them through a lock-free stack.
+//
+// An allocator keeps the memory of the largest command list it recorded across
+// resets. D3D12 reports neither that memory nor the commands recorded, so the
+// pools are not sorted by size, they are capped in count instead.
 class CommandQueue
 {
 public:
-    CommandQueue(Microsoft::WRL::ComPtr<ID3D12Device2> device, D3D12_COMMAND_LIST_TYPE type);
+    // Command lists a thread keeps before waiting for one to complete rather
+    // than creating another. Exceeded only when none are in flight.
+    static constexpr size_t s_maxCommandListsPerThread = 16;
+
+    // Work submitted to another queue that command lists must not start before.
+    // The dependency is resolved on the GPU, the CPU does not block.
+    struct Dependency
+    {
+        const CommandQueue *queue;
+        uint64_t fenceValue;
+    };
+
+    struct AllocatorStats
+    {
+        size_t numCreated;
+        uint64_t numReused;
+        // Times a thread waited for the GPU because its pool was full.
+        uint64_t numWaits;
+        // Most allocators one thread's pool has held. They are never freed,
+        // each keeps the memory of the largest command list it recorded.
+        size_t maxPerThread;
+        // Command lists executed and not reset for reuse yet, and the most at once.
+        size_t numInFlight;
+        size_t maxInFlight;
+    };
+
+    // maxThreads is the number of threads alive at the same time that may
+    // acquire command lists, each gets a pool of its own.
+    CommandQueue(Microsoft::WRL::ComPtr<ID3D12Device2> device, D3D12_COMMAND_LIST_TYPE type, uint32_t maxThreads);
     virtual ~CommandQueue();
 
-    // Get an available command list from the command queue.
+    // Get an available command list from the calling thread's pool.
     Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> GetCommandList();
 
-    // Execute a command list.
+    // Execute a command list once its dependencies have completed.
     // Returns the fence value to wait for for this command list.
-    uint64_t ExecuteCommandList(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList);
+    uint64_t ExecuteCommandList(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList, std::span<const Dependency> dependencies = {});
+
+    // Execute command lists in order with a single ExecuteCommandLists call and
+    // a single Signal, once their dependencies have completed. Returns the fence
+    // value to wait for for all of them.
+    uint64_t ExecuteCommandLists(std::span<const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>> commandLists, std::span<const Dependency> dependencies = {});
+
+    // Collect command lists, from any thread, to be executed together later.
+    void QueueCommandList(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList);
+    // Execute the queued command lists in the order they were queued. Returns
+    // the last fence value signaled if none are queued. Concurrent calls run
+    // one after the other.
+    uint64_t ExecuteQueuedCommandLists();
+
+    // State tracker of a command list obtained from GetCommandList. Its queued
+    // barriers are flushed and its pending ones resolved when the list is executed.
+    ResourceStateTracker &GetResourceStateTracker(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList);
 
     uint64_t Signal();
     bool IsFenceComplete(uint64_t fenceValue);
+    uint64_t GetCompletedFenceValue() const;
+    // Fence value of the last Signal, it covers every command list executed so far.
+    uint64_t GetLastSignaledFenceValue() const { return m_fenceValue.load(std::memory_order_acquire); }
+    // Block the calling thread until the fence value completes, following the wait policy.
     void WaitForFenceValue(uint64_t fenceValue);
     void Flush();
 
+    // How WaitForFenceValue waits, and how long its waits took.
+    void SetWaitPolicy(FenceWaiter::Policy policy) { m_fenceWaiter.SetPolicy(policy); }
+    const FenceWaiter &GetFenceWaiter() const { return m_fenceWaiter; }
+
+    // Make this queue wait on the GPU until the other queue's fence reaches
+    // fenceValue. The CPU does not block. Nothing is issued when the fence value
+    // has completed or this queue already waits for it, returns whether a wait was.
+    // A fence value of 0 is no dependency and is not counted as a skipped wait.
+    bool Wait(const CommandQueue &other, uint64_t fenceValue);
+
     Microsoft::WRL::ComPtr<ID3D12CommandQueue> GetD3D12CommandQueue() const { return m_d3d12CommandQueue; }
+    Microsoft::WRL::ComPtr<ID3D12Fence> GetD3D12Fence() const { return m_d3d12Fence; }
+
+    // Command lists and allocators created and reused over all threads.
+    size_t GetNumCommandLists() const { return m_numCommandLists.load(std::memory_order_relaxed); }
+    AllocatorStats GetAllocatorStats() const;
+    // ExecuteCommandLists calls made on the D3D12 queue and the command lists they
+    // executed, including the ones holding the pending barriers, for statistics.
+    uint64_t GetNumSubmissions() const { return m_numSubmissions.load(std::memory_order_relaxed); }
+    uint64_t GetNumExecutedCommandLists() const { return m_numExecutedCommandLists.load(std::memory_order_relaxed); }
+    // GPU waits issued on other queues, and the ones found unnecessary.
+    uint64_t GetNumGpuWaits() const { return m_numGpuWaits.load(std::memory_order_relaxed); }
+    uint64_t GetNumSkippedGpuWaits() const { return m_numSkippedGpuWaits.load(std::memory_order_relaxed); }
 
 protected:
     Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CreateCommandAllocator();
     Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> CreateCommandList(Microsoft::WRL::ComPtr<ID3D12CommandAllocator> allocator);
 
 private:
-    // Keep track of command allocators that are "in-flight"
-    struct CommandAllocatorEntry
+    struct ThreadPool;
+
+    // A command list and the allocator it records into, recycled together.
+    struct CommandListContext
     {
-        uint64_t fenceValue;
+        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList;
         Microsoft::WRL::ComPtr<ID3D12CommandAllocator> commandAllocator;
+        std::unique_ptr<ResourceStateTracker> resourceStateTracker;
+        ThreadPool *threadPool;
+        // Set by ExecuteCommandList before the context is returned.
+        uint64_t fenceValue;
+        CommandListContext *nextReturned;
+        // Acquired before submitting a command list with pending barriers, to
+        // resolve them into. Submitting must not wait for a command list.
+        CommandListContext *barrierContext;
+    };
+
+    // Only the owning thread touches the contexts and the in-flight list,
+    // other threads only push to the returned stack.
+    struct ThreadPool
+    {
+        std::vector<std::unique_ptr<CommandListContext>> contexts;
+        std::vector<CommandListContext *> inFlight;
+        std::atomic<CommandListContext *> returned = nullptr;
     };
 
-    using CommandAllocatorQueue = std::queue<CommandAllocatorEntry>;
-    using CommandListQueue = std::queue<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>>;
+    CommandListContext &GetCommandListContext(ID3D12GraphicsCommandList2 *commandList);
+    // Hand a closed context back to the thread that acquired it, it is reused
+    // once the fence value has completed.
+    static void ReturnCommandListContext(CommandListContext &context, uint64_t fenceValue);
+    // Wait for the other queue on the GPU unless it is unnecessary. Requires the submit lock.
+    bool InsertWait(const CommandQueue &other, uint64_t fenceValue);
 
     D3D12_COMMAND_LIST_TYPE m_CommandListType;
     Microsoft::WRL::ComPtr<ID3D12Device2> m_d3d12Device;
     Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_d3d12CommandQueue;
     Microsoft::WRL::ComPtr<ID3D12Fence> m_d3d12Fence;
-    HANDLE m_FenceEvent;
-    uint64_t m_fenceValue;
+    std::atomic<uint64_t> m_fenceValue;
+    FenceWaiter m_fenceWaiter;
+
+    // Keeps fence values in the order the work was submitted in, and guards
+    // the batch being submitted.
+    std::mutex m_submitMutex;
+    std::vector<CommandListContext *> m_batchContexts;
+    std::vector<ID3D12CommandList *> m_batchCommandLists;
+    std::vector<D3D12_RESOURCE_BARRIER> m_pendingBarriers;
+    // Highest fence value of each other queue this queue waits for on the GPU.
+    std::vector<std::pair<const CommandQueue *, uint64_t>> m_waitedFenceValues;
+
+    std::mutex m_queuedCommandListsMutex;
+    std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>> m_queuedCommandLists;
+    // Held while executing the queued command lists, by one thread at a time.
+    std::mutex m_executingCommandListsMutex;
+    std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>> m_executingCommandLists;
 
-    CommandAllocatorQueue m_CommandAllocatorQueue;
-    CommandListQueue m_CommandListQueue;
-};
\ No newline at end of file
+    // Indexed by thread, see GetThreadIndex in CommandQueue.cpp.
+    std::vector<std::unique_ptr<ThreadPool>> m_threadPools;
+    std::atomic<size_t> m_numCommandLists = 0;
+    std::atomic<uint64_t> m_numCommandListReuses = 0;
+    std::atomic<uint64_t> m_numCommandListWaits = 0;
+    std::atomic<size_t> m_maxCommandListsPerThread = 0;
+    std::atomic<size_t> m_numCommandListsInFlight = 0;
+    std::atomic<size_t> m_maxCommandListsInFlight = 0;
+    std::atomic<uint64_t> m_numSubmissions = 0;
+    std::atomic<uint64_t> m_numExecutedCommandLists = 0;
+    std::atomic<uint64_t> m_numGpuWaits = 0;
+    std::atomic<uint64_t> m_numSkippedGpuWaits = 0;
+};
@@ -2,6 +2,8 @@
 
 #include "WinHelpers.h"
 #include "Engine.h"
+#include "GpuMemoryAllocator.h"
+#include "UploadRing.h"
 #include <cassert>
 
 #pragma warning(push)
@@ -289,47 +291,20 @@ namespace DXHelpers
         commandList->ResourceBarrier(1, &barrier);
     }
 
-    void UpdateBufferResource(ComPtr<ID3D12GraphicsCommandList2> commandList, ComPtr<ID3D12Resource> &destinationResource, ComPtr<ID3D12Resource>* intermediateResource, size_t numElements, size_t elementSize, const void *bufferData, D3D12_RESOURCE_FLAGS flags)
+    void UpdateBufferResource(ComPtr<ID3D12GraphicsCommandList2> commandList, UploadRing &uploadRing, ComPtr<ID3D12Resource> &destinationResource, size_t numElements, size_t elementSize, const void *bufferData, D3D12_RESOURCE_FLAGS flags)
     {
-        auto device = Engine::Get().GetDevice();
-        LONG_PTR bufferSize = numElements * elementSize;
+        size_t bufferSize = numElements * elementSize;
 
-        CD3DX12_HEAP_PROPERTIES resourceHeapProps(D3D12_HEAP_TYPE_DEFAULT);
         CD3DX12_RESOURCE_DESC resourceBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize, flags);
 
-        // Create a committed resource for the GPU resource in a default heap.
-        assert(SUCCEEDED(device->CreateCommittedResource(
-            &resourceHeapProps,
-            D3D12_HEAP_FLAG_NONE,
-            &resourceBufferDesc,
-            D3D12_RESOURCE_STATE_COMMON,
-            nullptr,
-            IID_PPV_ARGS(&destinationResource))));
+        // Place the GPU resource in a default heap.
+        destinationResource = Engine::Get().GetGpuMemoryAllocator().CreateResource(D3D12_HEAP_TYPE_DEFAULT, resourceBufferDesc, D3D12_RESOURCE_STATE_COMMON);
 
-        // Create an committed resource for the upload.
+        // Stage the data in the upload ring, the range is reclaimed once the copy completes.
         if (bufferData)
         {
-            assert(intermediateResource);
-
-            CD3DX12_HEAP_PROPERTIES uploadHeapProps(D3D12_HEAP_TYPE_UPLOAD);
-            CD3DX12_RESOURCE_DESC uploadBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
-
-            assert(SUCCEEDED(device->CreateCommittedResource(
-                &uploadHeapProps,
-                D3D12_HEAP_FLAG_NONE,
-                &uploadBufferDesc,
-                D3D12_RESOURCE_STATE_GENERIC_READ,
-                nullptr,
-                IID_PPV_ARGS(&(*intermediateResource)))));
-
-            D3D12_SUBRESOURCE_DATA subresourceData[1] = {
-                {.pData = bufferData,
-                 .RowPitch = bufferSize,
-                 .SlicePitch = bufferSize}};
-
-            UpdateSubresources(commandList.Get(),
-                               destinationResource.Get(), intermediateResource->Get(),
-                               0, 0, 1, subresourceData);
+            UploadRing::Allocation allocation = uploadRing.Upload(bufferData, bufferSize);
+            commandList->CopyBufferRegion(destinationResource.Get(), 0, allocation.resource, allocation.offset, bufferSize);
         }
     }
 }
\ No newline at end of file
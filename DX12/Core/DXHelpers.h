@@ -12,6 +12,8 @@
 
 #include <wrl.h>
 
+class UploadRing;
+
 namespace DXHelpers
 {
     using namespace Microsoft::WRL;
@@ -42,5 +44,7 @@ namespace DXHelpers
 
     void TransitionResource(ComPtr<ID3D12GraphicsCommandList2> commandList, ComPtr<ID3D12Resource> resource, D3D12_RESOURCE_STATES beforeState, D3D12_RESOURCE_STATES afterState);
 
-    void UpdateBufferResource(ComPtr<ID3D12GraphicsCommandList2> commandList, ComPtr<ID3D12Resource>& destinationResource, ComPtr<ID3D12Resource>* intermediateResource, size_t numElements, size_t elementSize, const void* bufferData, D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE);
+    // Create the destination buffer and record a copy of bufferData into it. The data is
+    // staged in the upload ring, which the caller submits with the fence value of the copy.
+    void UpdateBufferResource(ComPtr<ID3D12GraphicsCommandList2> commandList, UploadRing &uploadRing, ComPtr<ID3D12Resource>& destinationResource, size_t numElements, size_t elementSize, const void* bufferData, D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE);
 }
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include "DeferredReleaseQueue.h"
+
+#include <cassert>
+#include <utility>
+
+void DeferredReleaseQueue::Enqueue(std::function<void()> release, const QueueFences::FenceValues &fenceValues)
+{
+    m_entries.push_back({fenceValues, std::move(release)});
+}
+
+size_t DeferredReleaseQueue::Collect(const QueueFences::FenceValues &completedFenceValues)
+{
+    assert(m_releasedEntries.empty() && "Collect called from a release function.");
+    QueueFences::MoveCompleted(m_entries, m_releasedEntries, [&completedFenceValues](const Entry &entry)
+                               { return QueueFences::IsComplete(entry.fenceValues, completedFenceValues); });
+
+    // A release function may enqueue again, they run once the entries are consistent.
+    for (Entry &entry : m_releasedEntries)
+    {
+        entry.release();
+    }
+
+    size_t numReleased = m_releasedEntries.size();
+    m_releasedEntries.clear();
+    m_numReleased += numReleased;
+    return numReleased;
+}
+
+void DeferredReleaseQueue::Flush()
+{
+    std::vector<Entry> entries = std::move(m_entries);
+    m_entries.clear();
+
+    for (Entry &entry : entries)
+    {
+        entry.release();
+    }
+
+    m_numReleased += entries.size();
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "QueueFences.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Delays releasing objects until the GPU is done with them, without blocking.
+// Each entry records the last fence value signaled on every queue at the time it
+// was released, its release function runs once all of those have completed.
+// Knows nothing about D3D12, queues are identified by their QueueFences index.
+// Not thread-safe.
+class DeferredReleaseQueue
+{
+public:
+    DeferredReleaseQueue() = default;
+
+    DeferredReleaseQueue(const DeferredReleaseQueue &) = delete;
+    DeferredReleaseQueue(DeferredReleaseQueue &&) = delete;
+    DeferredReleaseQueue &operator=(const DeferredReleaseQueue &) = delete;
+    DeferredReleaseQueue &operator=(DeferredReleaseQueue &&) = delete;
+
+    // Run release once every queue has completed its fence value. A fence value
+    // of 0 means the queue never used the object.
+    void Enqueue(std::function<void()> release, const QueueFences::FenceValues &fenceValues);
+
+    // Run the release functions of the entries whose fence values have all
+    // completed, in the order they were enqueued. Returns how many ran.
+    size_t Collect(const QueueFences::FenceValues &completedFenceValues);
+
+    // Run every release function, the GPU must be idle.
+    void Flush();
+
+    size_t GetNumPending() const { return m_entries.size(); }
+    size_t GetNumReleased() const { return m_numReleased; }
+
+private:
+    struct Entry
+    {
+        QueueFences::FenceValues fenceValues;
+        std::function<void()> release;
+    };
+
+    std::vector<Entry> m_entries;
+    // Entries released by Collect, kept to reuse their storage.
+    std::vector<Entry> m_releasedEntries;
+    size_t m_numReleased = 0;
+};
@@ -0,0 +1,48 @@
+#include "DirtyIndexTracker.h"
+
+#include <algorithm>
+#include <cassert>
+
+DirtyIndexTracker::DirtyIndexTracker(size_t numElements)
+{
+    Resize(numElements);
+}
+
+void DirtyIndexTracker::Resize(size_t numElements)
+{
+    m_numElements = numElements;
+    m_numWords = (numElements + s_bitsPerWord - 1) / s_bitsPerWord;
+    m_words = std::make_unique<std::atomic<uint64_t>[]>(m_numWords);
+    for (size_t i = 0; i < m_numWords; ++i)
+    {
+        m_words[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void DirtyIndexTracker::MarkDirty(size_t index)
+{
+    assert(index < m_numElements);
+    m_words[index / s_bitsPerWord].fetch_or(uint64_t(1) << (index % s_bitsPerWord), std::memory_order_relaxed);
+}
+
+void DirtyIndexTracker::MarkDirty(size_t begin, size_t end)
+{
+    assert(begin <= end && end <= m_numElements);
+
+    while (begin < end)
+    {
+        size_t word = begin / s_bitsPerWord;
+        size_t firstBit = begin % s_bitsPerWord;
+        size_t numBits = std::min(end - begin, s_bitsPerWord - firstBit);
+
+        uint64_t mask = numBits == s_bitsPerWord ? ~uint64_t(0) : ((uint64_t(1) << numBits) - 1) << firstBit;
+        m_words[word].fetch_or(mask, std::memory_order_relaxed);
+        begin += numBits;
+    }
+}
+
+bool DirtyIndexTracker::IsDirty(size_t index) const
+{
+    assert(index < m_numElements);
+    return (m_words[index / s_bitsPerWord].load(std::memory_order_relaxed) >> (index % s_bitsPerWord)) & 1;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Set of element indices changed since the last collection, stored as a bitset.
+// Marking is lock-free so jobs can mark elements concurrently, collecting
+// returns the indices in ascending order.
+class DirtyIndexTracker
+{
+public:
+    DirtyIndexTracker() = default;
+    explicit DirtyIndexTracker(size_t numElements);
+
+    DirtyIndexTracker(const DirtyIndexTracker &) = delete;
+    DirtyIndexTracker(DirtyIndexTracker &&) = delete;
+    DirtyIndexTracker &operator=(const DirtyIndexTracker &) = delete;
+    DirtyIndexTracker &operator=(DirtyIndexTracker &&) = delete;
+
+    // Track numElements elements, all of them clean. Not thread-safe.
+    void Resize(size_t numElements);
+    size_t GetNumElements() const { return m_numElements; }
+
+    void MarkDirty(size_t index);
+    void MarkDirty(size_t begin, size_t end);
+    void MarkAllDirty() { MarkDirty(0, m_numElements); }
+
+    bool IsDirty(size_t index) const;
+
+    // Replace the contents of indices with the dirty indices in ascending order
+    // and mark every element clean. Must not run concurrently with marking.
+    template <typename Allocator>
+    void Collect(std::vector<uint32_t, Allocator> &indices);
+
+private:
+    static constexpr size_t s_bitsPerWord = 64;
+
+    std::unique_ptr<std::atomic<uint64_t>[]> m_words;
+    size_t m_numWords = 0;
+    size_t m_numElements = 0;
+};
+
+template <typename Allocator>
+void DirtyIndexTracker::Collect(std::vector<uint32_t, Allocator> &indices)
+{
+    indices.clear();
+
+    for (size_t word = 0; word < m_numWords; ++word)
+    {
+        uint64_t bits = m_words[word].exchange(0, std::memory_order_acquire);
+        while (bits != 0)
+        {
+            size_t bit = static_cast<size_t>(std::countr_zero(bits));
+            indices.push_back(static_cast<uint32_t>(word * s_bitsPerWord + bit));
+            bits &= bits - 1;
+        }
+    }
+}
@@ -9,6 +9,12 @@
 #include "directx/d3dx12.h"
 #include "CommandQueue.h"
 #pragma warning(pop)
+#include "DeferredReleaseQueue.h"
+#include "GpuMemoryAllocator.h"
+#include "ReadbackService.h"
+#include "ResidencyManager.h"
+#include "UploadManager.h"
+#include "UploadRing.h"
 #include "Window.h"
 
 #ifdef _DEBUG
@@ -20,8 +26,14 @@
 #pragma comment(lib, "dxguid.lib")
 #endif
 
+#include <algorithm>
 #include <iostream>
 
+// Initial size of the upload ring, it grows when a request does not fit.
+constexpr size_t g_uploadRingCapacity = 4 << 20;
+// Size of the heaps resources are placed in, larger resources get their own heap.
+constexpr uint64_t g_gpuHeapSize = 64 << 20;
+
 Engine *Engine::s_singleton = nullptr;
 
 void Engine::Init(HINSTANCE applicationInstance, std::wstring cmdLine)
@@ -75,12 +87,78 @@ void Engine::RegisterRenderEventHandler(std::shared_ptr<IRenderEventHandler> ren
     m_renderEventHandlers.push_back(renderEventHandler);
 }
 
-void Engine::WaitForGPU()
+void Engine::DeferRelease(std::function<void()> release)
+{
+    m_deferredReleaseQueue->Enqueue(std::move(release), GetLastSignaledFenceValues());
+}
+
+void Engine::CollectDeferredReleases()
+{
+    if (m_deferredReleaseQueue->GetNumPending() == 0)
+    {
+        return;
+    }
+
+    m_deferredReleaseQueue->Collect(GetCompletedFenceValues());
+}
+
+void Engine::StartTask(FenceScheduler::Task task)
+{
+    m_fenceScheduler->Start(std::move(task));
+}
+
+FenceScheduler::Awaitable Engine::WaitForFenceAsync(D3D12_COMMAND_LIST_TYPE commandQueueType, uint64_t fenceValue)
+{
+    switch (commandQueueType)
+    {
+    case D3D12_COMMAND_LIST_TYPE_DIRECT:
+        return m_fenceScheduler->WaitFor(QueueFences::s_directQueue, fenceValue);
+    case D3D12_COMMAND_LIST_TYPE_COMPUTE:
+        return m_fenceScheduler->WaitFor(QueueFences::s_computeQueue, fenceValue);
+    case D3D12_COMMAND_LIST_TYPE_COPY:
+        return m_fenceScheduler->WaitFor(QueueFences::s_copyQueue, fenceValue);
+    default:
+        assert(false && "Invalid command queue type.");
+    }
+    return m_fenceScheduler->WaitFor(QueueFences::s_directQueue, fenceValue);
+}
 
+void Engine::ResumeFenceTasks()
 {
-    m_directCommandQueue->WaitForFenceValue(m_directCommandQueue->Signal());
-    m_computeCommandQueue->WaitForFenceValue(m_computeCommandQueue->Signal());
-    m_copyCommandQueue->WaitForFenceValue(m_copyCommandQueue->Signal());
+    // One poll of each fence covers every suspended task.
+    if (m_fenceScheduler->GetNumWaiting() == 0)
+    {
+        return;
+    }
+
+    m_fenceScheduler->Resume(GetCompletedFenceValues());
+}
+
+QueueFences::FenceValues Engine::GetLastSignaledFenceValues() const
+{
+    QueueFences::FenceValues fenceValues;
+    fenceValues[QueueFences::s_directQueue] = m_directCommandQueue->GetLastSignaledFenceValue();
+    fenceValues[QueueFences::s_computeQueue] = m_computeCommandQueue->GetLastSignaledFenceValue();
+    fenceValues[QueueFences::s_copyQueue] = m_copyCommandQueue->GetLastSignaledFenceValue();
+    return fenceValues;
+}
+
+QueueFences::FenceValues Engine::GetCompletedFenceValues() const
+{
+    QueueFences::FenceValues fenceValues;
+    fenceValues[QueueFences::s_directQueue] = m_directCommandQueue->GetCompletedFenceValue();
+    fenceValues[QueueFences::s_computeQueue] = m_computeCommandQueue->GetCompletedFenceValue();
+    fenceValues[QueueFences::s_copyQueue] = m_copyCommandQueue->GetCompletedFenceValue();
+    return fenceValues;
+}
+
+void Engine::WaitForGPU()
+{
+    // Every submission signals its queue's fence. The direct queue waits on the
+    // GPU for the other queues' last signals, so one CPU wait covers all three.
+    m_directCommandQueue->Wait(*m_computeCommandQueue, m_computeCommandQueue->GetLastSignaledFenceValue());
+    m_directCommandQueue->Wait(*m_copyCommandQueue, m_copyCommandQueue->GetLastSignaledFenceValue());
+    m_directCommandQueue->Flush();
 }
 
 void Engine::Run()
@@ -110,6 +188,11 @@ void Engine::Run()
         double deltaTime = newTime - curTime;
         curTime = newTime;
 
+        CollectDeferredReleases();
+        ResumeFenceTasks();
+        m_residencyManager->Update();
+        m_readbackService->Update();
+
         for (std::shared_ptr<IUpdateEventHandler> &updateEventHandler : m_updateEventHandlers)
         {
             updateEventHandler->Update(deltaTime);
@@ -122,6 +205,7 @@ void Engine::Run()
     }
 
     WaitForGPU();
+    m_deferredReleaseQueue->Flush();
 
 #ifdef DX12_ENABLE_DEBUG_LAYER
     IDXGIDebug1 *pDebug = nullptr;
@@ -138,7 +222,7 @@ void Engine::Exit()
     m_shouldRun = false;
 }
 
-Engine::Engine(HINSTANCE applicationInstance, std::wstring cmdLine) : m_applicationInstance(applicationInstance)
+Engine::Engine(HINSTANCE applicationInstance, std::wstring cmdLine) : m_applicationInstance(applicationInstance), m_commandLine(cmdLine)
 {
 
     // Windows 10 Creators update adds Per Monitor V2 DPI awareness context.
@@ -161,9 +245,21 @@ Engine::Engine(HINSTANCE applicationInstance, std::wstring cmdLine) : m_applicat
     m_adapter = DXHelpers::GetAdapter(false);
     m_device = DXHelpers::CreateDevice(m_adapter);
 
-    m_directCommandQueue = std::make_shared<CommandQueue>(m_device, D3D12_COMMAND_LIST_TYPE_DIRECT);
-    m_computeCommandQueue = std::make_shared<CommandQueue>(m_device, D3D12_COMMAND_LIST_TYPE_COMPUTE);
-    m_copyCommandQueue = std::make_shared<CommandQueue>(m_device, D3D12_COMMAND_LIST_TYPE_COPY);
+    // Only the job threads record command lists, the queues keep a pool for each.
+    // The job system must not be resized beyond its initial thread count.
+    m_jobSystem = std::make_unique<JobSystem>(std::max(std::thread::hardware_concurrency(), 1u));
+    uint32_t maxRecordingThreads = m_jobSystem->GetNumThreads();
+
+    m_directCommandQueue = std::make_shared<CommandQueue>(m_device, D3D12_COMMAND_LIST_TYPE_DIRECT, maxRecordingThreads);
+    m_computeCommandQueue = std::make_shared<CommandQueue>(m_device, D3D12_COMMAND_LIST_TYPE_COMPUTE, maxRecordingThreads);
+    m_copyCommandQueue = std::make_shared<CommandQueue>(m_device, D3D12_COMMAND_LIST_TYPE_COPY, maxRecordingThreads);
+    m_residencyManager = std::make_unique<ResidencyManager>(m_device, m_adapter, m_directCommandQueue);
+    m_gpuMemoryAllocator = std::make_unique<GpuMemoryAllocator>(m_device, *m_residencyManager, g_gpuHeapSize);
+    m_uploadRing = std::make_unique<UploadRing>(m_device, m_copyCommandQueue, g_uploadRingCapacity);
+    m_uploadManager = std::make_unique<UploadManager>(m_copyCommandQueue, *m_uploadRing);
+    m_deferredReleaseQueue = std::make_unique<DeferredReleaseQueue>();
+    m_fenceScheduler = std::make_unique<FenceScheduler>();
+    m_readbackService = std::make_unique<ReadbackService>(m_device, m_directCommandQueue);
 }
 
 bool Engine::CheckTearingSupport()
@@ -12,14 +12,25 @@
 #include <dxgi1_6.h>
 #include <wrl.h>
 
+#include <functional>
 #include <string>
 #include <memory>
 #include <unordered_map>
 
 #include "Interfaces/EngineEventHandlers.h"
 #include "Clock.h"
+#include "CommandLine.h"
+#include "FenceScheduler.h"
+#include "JobSystem.h"
+#include "QueueFences.h"
 
 class CommandQueue;
+class DeferredReleaseQueue;
+class GpuMemoryAllocator;
+class ReadbackService;
+class ResidencyManager;
+class UploadManager;
+class UploadRing;
 class Window;
 
 class Engine
@@ -34,10 +45,41 @@ public:
 
     HINSTANCE GetApplicationInstance() { return m_applicationInstance; }
 
+    // Arguments the application was started with.
+    const CommandLine &GetCommandLineArguments() const { return m_commandLine; }
+
     std::shared_ptr<CommandQueue> GetCommandQueue(D3D12_COMMAND_LIST_TYPE commandQueueType);
 
     Microsoft::WRL::ComPtr<ID3D12Device2> GetDevice() { return m_device; }
 
+    JobSystem &GetJobSystem() { return *m_jobSystem; }
+
+    // Keeps the heaps of the GpuMemoryAllocator within the video memory budget.
+    ResidencyManager &GetResidencyManager() { return *m_residencyManager; }
+
+    // Places resources in shared heaps instead of committed resources.
+    GpuMemoryAllocator &GetGpuMemoryAllocator() { return *m_gpuMemoryAllocator; }
+
+    // Staging memory for copies on the copy queue.
+    UploadRing &GetUploadRing() { return *m_uploadRing; }
+
+    // Batches uploads on the copy queue, see UploadManager.
+    UploadManager &GetUploadManager() { return *m_uploadManager; }
+
+    // Copies GPU data back to the CPU on the direct queue.
+    ReadbackService &GetReadbackService() { return *m_readbackService; }
+
+    // Run release once every queue has finished the work submitted so far,
+    // without blocking. Pending releases are checked once per frame.
+    void DeferRelease(std::function<void()> release);
+    const DeferredReleaseQueue &GetDeferredReleaseQueue() const { return *m_deferredReleaseQueue; }
+
+    // Run a coroutine that waits for fences with co_await WaitForFenceAsync
+    // instead of blocking. Suspended tasks are resumed once per frame.
+    void StartTask(FenceScheduler::Task task);
+    FenceScheduler::Awaitable WaitForFenceAsync(D3D12_COMMAND_LIST_TYPE commandQueueType, uint64_t fenceValue);
+    const FenceScheduler &GetFenceScheduler() const { return *m_fenceScheduler; }
+
     bool IsTearingSupported() const { return m_isTearingSupported; }
 
     std::shared_ptr<Window> CreateWindow(const wchar_t *windowTitle, uint32_t width, uint32_t height);
@@ -56,10 +98,18 @@ private:
 
     bool CheckTearingSupport();
 
+    void CollectDeferredReleases();
+    void ResumeFenceTasks();
+
+    // Fence values of every command queue, indexed as in QueueFences.
+    QueueFences::FenceValues GetLastSignaledFenceValues() const;
+    QueueFences::FenceValues GetCompletedFenceValues() const;
+
 private:
     static Engine *s_singleton;
 
     const HINSTANCE m_applicationInstance;
+    const CommandLine m_commandLine;
 
     bool m_shouldRun;
 
@@ -72,6 +122,15 @@ private:
     std::shared_ptr<CommandQueue> m_computeCommandQueue;
     std::shared_ptr<CommandQueue> m_copyCommandQueue;
 
+    std::unique_ptr<JobSystem> m_jobSystem;
+    std::unique_ptr<ResidencyManager> m_residencyManager;
+    std::unique_ptr<GpuMemoryAllocator> m_gpuMemoryAllocator;
+    std::unique_ptr<UploadRing> m_uploadRing;
+    std::unique_ptr<UploadManager> m_uploadManager;
+    std::unique_ptr<DeferredReleaseQueue> m_deferredReleaseQueue;
+    std::unique_ptr<FenceScheduler> m_fenceScheduler;
+    std::unique_ptr<ReadbackService> m_readbackService;
+
     std::vector<std::shared_ptr<IStartupEventHandler>> m_startupEventHandlers;
     std::vector<std::shared_ptr<IUpdateEventHandler>> m_updateEventHandlers;
     std::vector<std::shared_ptr<IRenderEventHandler>> m_renderEventHandlers;
@@ -0,0 +1,62 @@
+#include "FenceScheduler.h"
+
+#include <algorithm>
+#include <cassert>
+
+FenceScheduler::~FenceScheduler()
+{
+    for (std::coroutine_handle<Task::promise_type> task : m_tasks)
+    {
+        task.destroy();
+    }
+}
+
+void FenceScheduler::Start(Task task)
+{
+    std::coroutine_handle<Task::promise_type> handle = std::exchange(task.m_handle, nullptr);
+    assert(handle && "Task was moved from.");
+
+    m_tasks.push_back(handle);
+    handle.resume();
+
+    if (handle.done())
+    {
+        DestroyFinishedTasks();
+    }
+}
+
+size_t FenceScheduler::Resume(const QueueFences::FenceValues &completedFenceValues)
+{
+    assert(m_resumedWaiters.empty() && "Resume called from a task.");
+    m_completedFenceValues = completedFenceValues;
+    QueueFences::MoveCompleted(m_waiters, m_resumedWaiters, [&completedFenceValues](const Waiter &waiter)
+                               { return QueueFences::IsComplete(waiter.queueIndex, waiter.fenceValue, completedFenceValues); });
+
+    // A resumed task may wait again, it is resumed once the waiters are consistent.
+    for (Waiter &waiter : m_resumedWaiters)
+    {
+        waiter.handle.resume();
+    }
+
+    size_t numResumed = m_resumedWaiters.size();
+    m_resumedWaiters.clear();
+    if (numResumed > 0)
+    {
+        DestroyFinishedTasks();
+    }
+
+    m_numResumed += numResumed;
+    return numResumed;
+}
+
+void FenceScheduler::DestroyFinishedTasks()
+{
+    std::erase_if(m_tasks, [](std::coroutine_handle<Task::promise_type> task)
+                  {
+                      if (!task.done())
+                      {
+                          return false;
+                      }
+                      task.destroy();
+                      return true; });
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "QueueFences.h"
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <utility>
+#include <vector>
+
+// Runs coroutines that wait for GPU fences without blocking a thread. A task
+// suspends on co_await WaitFor(queue, fenceValue) and is resumed by the first
+// Resume call that reports the fence value as completed. Resume is meant to be
+// called once per frame, so the fences are polled once for all suspended tasks.
+// Knows nothing about D3D12, queues are identified by their QueueFences index
+// and the completed fence values are passed in. Not thread-safe, tasks run on
+// the thread calling Start and Resume.
+class FenceScheduler
+{
+public:
+    // Return type of the coroutines run by the scheduler. A task does nothing
+    // until it is started, the scheduler then owns it and destroys it once it
+    // finishes, or when the scheduler is destroyed while it is suspended.
+    class [[nodiscard]] Task
+    {
+    public:
+        struct promise_type
+        {
+            Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+
+        Task(Task &&other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+        ~Task()
+        {
+            if (m_handle)
+            {
+                m_handle.destroy();
+            }
+        }
+
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+        Task &operator=(Task &&) = delete;
+
+    private:
+        friend class FenceScheduler;
+
+        explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+        std::coroutine_handle<promise_type> m_handle;
+    };
+
+    // Suspends the awaiting task until the fence value of the queue completes.
+    // Does not suspend when it is known to have completed already.
+    class Awaitable
+    {
+    public:
+        Awaitable(FenceScheduler &scheduler, size_t queueIndex, uint64_t fenceValue)
+            : m_scheduler(&scheduler), m_queueIndex(queueIndex), m_fenceValue(fenceValue) {}
+
+        bool await_ready() const { return QueueFences::IsComplete(m_queueIndex, m_fenceValue, m_scheduler->m_completedFenceValues); }
+        void await_suspend(std::coroutine_handle<> handle) { m_scheduler->m_waiters.push_back({m_queueIndex, m_fenceValue, handle}); }
+        void await_resume() const {}
+
+    private:
+        FenceScheduler *m_scheduler;
+        size_t m_queueIndex;
+        uint64_t m_fenceValue;
+    };
+
+    FenceScheduler() = default;
+    ~FenceScheduler();
+
+    FenceScheduler(const FenceScheduler &) = delete;
+    FenceScheduler(FenceScheduler &&) = delete;
+    FenceScheduler &operator=(const FenceScheduler &) = delete;
+    FenceScheduler &operator=(FenceScheduler &&) = delete;
+
+    // Run the task until it first suspends.
+    void Start(Task task);
+
+    // For co_await in a task started on this scheduler. A fence value of 0 never waits.
+    Awaitable WaitFor(size_t queueIndex, uint64_t fenceValue) { return Awaitable(*this, queueIndex, fenceValue); }
+
+    // Resume the tasks waiting for fence values that have completed, in the
+    // order they suspended. Tasks waiting again are only resumed by a later call.
+    // Returns how many were resumed.
+    size_t Resume(const QueueFences::FenceValues &completedFenceValues);
+
+    size_t GetNumTasks() const { return m_tasks.size(); }
+    size_t GetNumWaiting() const { return m_waiters.size(); }
+    size_t GetNumResumed() const { return m_numResumed; }
+
+private:
+    struct Waiter
+    {
+        size_t queueIndex;
+        uint64_t fenceValue;
+        std::coroutine_handle<> handle;
+    };
+
+    // Destroy the tasks that have finished.
+    void DestroyFinishedTasks();
+
+    std::vector<std::coroutine_handle<Task::promise_type>> m_tasks;
+    std::vector<Waiter> m_waiters;
+    // Waiters resumed by Resume, kept to reuse their storage.
+    std::vector<Waiter> m_resumedWaiters;
+    // As reported by the last Resume call.
+    QueueFences::FenceValues m_completedFenceValues = {};
+    size_t m_numResumed = 0;
+};
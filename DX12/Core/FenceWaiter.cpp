@@ -0,0 +1,144 @@
+#include "FenceWaiter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <thread>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // Weight of the latest wait in the prediction of the next one.
+    constexpr double g_predictionSmoothing = 0.1;
+    // Spinning stops at this multiple of the predicted wait.
+    constexpr double g_spinBudgetFactor = 2.0;
+
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+
+    // Hint that the thread is spinning: the other hyper-thread of the core gets
+    // its execution resources and leaving the loop does not flush the pipeline.
+    void SpinPause()
+    {
+#if defined(_M_X64) || defined(__SSE2__)
+        _mm_pause();
+#endif
+    }
+}
+
+void FenceWaiter::Wait(Fence &fence, uint64_t fenceValue)
+{
+    if (fence.GetCompletedValue() >= fenceValue)
+    {
+        return;
+    }
+
+    Policy policy;
+    double predictedMs;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        policy = m_policy;
+        predictedMs = m_stats.predictedMs;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool blocked = false;
+    switch (policy)
+    {
+    case Policy::SpinThenBlock:
+    {
+        Milliseconds spinBudget = std::min<Milliseconds>(Milliseconds(predictedMs * g_spinBudgetFactor), s_maxSpinBudget);
+        // A wait predicted to outlast the budget would spin in vain.
+        bool spin = predictedMs * g_spinBudgetFactor <= Milliseconds(s_maxSpinBudget).count();
+        std::chrono::steady_clock::time_point spinEnd = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(spinBudget);
+        while (spin && fence.GetCompletedValue() < fenceValue && std::chrono::steady_clock::now() < spinEnd)
+        {
+            SpinPause();
+        }
+        if (fence.GetCompletedValue() < fenceValue)
+        {
+            fence.Block(fenceValue);
+            blocked = true;
+        }
+        break;
+    }
+    case Policy::Yield:
+        while (fence.GetCompletedValue() < fenceValue)
+        {
+            std::this_thread::yield();
+        }
+        break;
+    default:
+        fence.Block(fenceValue);
+        blocked = true;
+        break;
+    }
+    double actualMs = Milliseconds(std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.numWaits++;
+    m_stats.numBlockingWaits += blocked ? 1 : 0;
+    m_stats.totalWaitMs += actualMs;
+    m_stats.predictionErrorMs += (std::abs(actualMs - predictedMs) - m_stats.predictionErrorMs) * g_predictionSmoothing;
+    m_stats.predictedMs += (actualMs - m_stats.predictedMs) * g_predictionSmoothing;
+
+    if (m_samples.size() < s_maxSamples)
+    {
+        m_samples.push_back({predictedMs, actualMs, blocked});
+    }
+    else
+    {
+        m_samples[m_nextSample] = {predictedMs, actualMs, blocked};
+    }
+    m_nextSample = (m_nextSample + 1) % s_maxSamples;
+}
+
+void FenceWaiter::SetPolicy(Policy policy)
+{
+    assert(policy < Policy::Count);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_policy = policy;
+}
+
+FenceWaiter::Policy FenceWaiter::GetPolicy() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_policy;
+}
+
+const char *FenceWaiter::GetPolicyName(Policy policy)
+{
+    switch (policy)
+    {
+    case Policy::Block:
+        return "Block";
+    case Policy::SpinThenBlock:
+        return "Spin then block";
+    case Policy::Yield:
+        return "Yield";
+    default:
+        assert(false && "Invalid wait policy.");
+    }
+    return "";
+}
+
+FenceWaiter::Stats FenceWaiter::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void FenceWaiter::GetSamples(std::vector<Sample> &samples) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    samples.clear();
+
+    // Until the ring is full the oldest sample is the first one.
+    size_t oldest = m_samples.size() < s_maxSamples ? 0 : m_nextSample;
+    for (size_t i = 0; i < m_samples.size(); i++)
+    {
+        samples.push_back(m_samples[(oldest + i) % m_samples.size()]);
+    }
+}
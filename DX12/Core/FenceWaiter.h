@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Waits for a fence value with one of several policies, and records how long
+// each wait was predicted to take and actually took. Blocking in the OS costs a
+// scheduler wake-up, which matters for the short waits at the end of a frame.
+// Spinning first avoids it, the spin budget follows the smoothed length of the
+// previous waits and waits predicted to be long block right away. Platform
+// independent, fences are reached through the Fence interface so the policies
+// can run against a simulated fence. Thread-safe.
+class FenceWaiter
+{
+public:
+    enum class Policy
+    {
+        // Block in the OS until the fence completes.
+        Block,
+        // Poll for up to the spin budget, then block.
+        SpinThenBlock,
+        // Poll, giving up the time slice between polls, until the fence completes.
+        Yield,
+        Count
+    };
+
+    class Fence
+    {
+    public:
+        virtual ~Fence() = default;
+
+        virtual uint64_t GetCompletedValue() const = 0;
+        // Return once the fence has reached fenceValue, without using the CPU.
+        virtual void Block(uint64_t fenceValue) = 0;
+    };
+
+    struct Sample
+    {
+        double predictedMs;
+        double actualMs;
+        bool blocked;
+    };
+
+    struct Stats
+    {
+        // Waits on a fence that had not completed yet.
+        uint64_t numWaits;
+        // Waits that ended up blocking in the OS.
+        uint64_t numBlockingWaits;
+        double totalWaitMs;
+        // Smoothed length of the waits, the prediction of the next one.
+        double predictedMs;
+        // Smoothed difference between predicted and actual wait times.
+        double predictionErrorMs;
+    };
+
+    // Waits are never spun longer than this.
+    static constexpr std::chrono::microseconds s_maxSpinBudget = std::chrono::microseconds(1000);
+    // Waits kept for GetSamples.
+    static constexpr size_t s_maxSamples = 256;
+
+    FenceWaiter() = default;
+
+    FenceWaiter(const FenceWaiter &) = delete;
+    FenceWaiter(FenceWaiter &&) = delete;
+    FenceWaiter &operator=(const FenceWaiter &) = delete;
+    FenceWaiter &operator=(FenceWaiter &&) = delete;
+
+    // Return once the fence has reached fenceValue.
+    void Wait(Fence &fence, uint64_t fenceValue);
+
+    void SetPolicy(Policy policy);
+    Policy GetPolicy() const;
+    static const char *GetPolicyName(Policy policy);
+
+    Stats GetStats() const;
+    // Replace samples with the most recent waits, oldest first.
+    void GetSamples(std::vector<Sample> &samples) const;
+
+private:
+    mutable std::mutex m_mutex;
+    Policy m_policy = Policy::Block;
+    Stats m_stats = {};
+    // Ring buffer of the most recent waits.
+    std::vector<Sample> m_samples;
+    size_t m_nextSample = 0;
+};
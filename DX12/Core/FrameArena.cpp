@@ -0,0 +1,75 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+namespace
+{
+    size_t AlignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+FrameArena::FrameArena(size_t capacity)
+    : m_memory(std::make_unique<std::byte[]>(capacity)), m_capacity(capacity), m_offset(0)
+{
+}
+
+void *FrameArena::Allocate(size_t size, size_t alignment)
+{
+    assert(std::has_single_bit(alignment));
+
+    uintptr_t base = reinterpret_cast<uintptr_t>(m_memory.get());
+    size_t offset = m_offset.load(std::memory_order_relaxed);
+    while (true)
+    {
+        size_t alignedOffset = AlignUp(base + offset, alignment) - base;
+        if (alignedOffset + size > m_capacity)
+        {
+            return AllocateOverflow(size, alignment);
+        }
+
+        if (m_offset.compare_exchange_weak(offset, alignedOffset + size, std::memory_order_relaxed))
+        {
+            return m_memory.get() + alignedOffset;
+        }
+    }
+}
+
+void FrameArena::Reset()
+{
+    size_t usedBytes = GetUsedBytes();
+    m_highWaterMark = std::max(m_highWaterMark, usedBytes);
+
+    m_overflowBlocks.clear();
+    m_overflowBytes = 0;
+    m_offset.store(0, std::memory_order_relaxed);
+
+    // Grow to fit the whole frame the next time around.
+    if (usedBytes > m_capacity)
+    {
+        m_capacity = std::bit_ceil(usedBytes);
+        m_memory = std::make_unique<std::byte[]>(m_capacity);
+    }
+}
+
+size_t FrameArena::GetUsedBytes() const
+{
+    return std::min(m_offset.load(std::memory_order_relaxed), m_capacity) + m_overflowBytes;
+}
+
+void *FrameArena::AllocateOverflow(size_t size, size_t alignment)
+{
+    std::lock_guard<std::mutex> lock(m_overflowMutex);
+
+    auto block = std::make_unique<std::byte[]>(size + alignment - 1);
+    uintptr_t address = AlignUp(reinterpret_cast<uintptr_t>(block.get()), alignment);
+
+    m_overflowBlocks.push_back(std::move(block));
+    m_overflowBytes += size + alignment - 1;
+    ++m_numOverflows;
+
+    return reinterpret_cast<void *>(address);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Bump allocator for memory that only lives for a single frame.
+// Allocations are never freed individually, the whole arena is reset once the
+// GPU is done with the frame that used it. Allocation is lock-free; requests
+// that do not fit fall back to the heap and grow the arena on the next reset,
+// so a steady workload stops touching the heap after a few frames.
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t capacity);
+
+    FrameArena(const FrameArena &) = delete;
+    FrameArena(FrameArena &&) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+    FrameArena &operator=(FrameArena &&) = delete;
+
+    void *Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    template <typename T>
+    T *AllocateArray(size_t count)
+    {
+        return static_cast<T *>(Allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // Release every allocation. Must not run concurrently with Allocate.
+    void Reset();
+
+    size_t GetCapacity() const { return m_capacity; }
+    // Bytes allocated since the last reset, including heap fallbacks.
+    size_t GetUsedBytes() const;
+    // Largest GetUsedBytes observed at a reset.
+    size_t GetHighWaterMark() const { return m_highWaterMark; }
+    // Allocations that did not fit since the arena was created.
+    size_t GetNumOverflows() const { return m_numOverflows; }
+
+private:
+    void *AllocateOverflow(size_t size, size_t alignment);
+
+    std::unique_ptr<std::byte[]> m_memory;
+    size_t m_capacity;
+    std::atomic<size_t> m_offset;
+
+    std::mutex m_overflowMutex;
+    std::vector<std::unique_ptr<std::byte[]>> m_overflowBlocks;
+    size_t m_overflowBytes = 0;
+    size_t m_numOverflows = 0;
+
+    size_t m_highWaterMark = 0;
+};
+
+// Standard allocator adapter, so that containers can live in a frame arena.
+// Deallocation is a no-op, the memory is reclaimed by FrameArena::Reset.
+template <typename T>
+class FrameArenaAllocator
+{
+public:
+    using value_type = T;
+
+    explicit FrameArenaAllocator(FrameArena &arena) noexcept
+        : m_arena(&arena)
+    {
+    }
+
+    template <typename U>
+    FrameArenaAllocator(const FrameArenaAllocator<U> &other) noexcept
+        : m_arena(other.GetArena())
+    {
+    }
+
+    T *allocate(size_t count) { return m_arena->AllocateArray<T>(count); }
+    void deallocate(T *, size_t) noexcept {}
+
+    FrameArena *GetArena() const noexcept { return m_arena; }
+
+    template <typename U>
+    bool operator==(const FrameArenaAllocator<U> &other) const noexcept { return m_arena == other.GetArena(); }
+
+private:
+    FrameArena *m_arena;
+};
+
+template <typename T>
+using FrameVector = std::vector<T, FrameArenaAllocator<T>>;
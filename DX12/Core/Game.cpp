@@ -2,6 +2,12 @@
 #include "Window.h"
 #include "DXHelpers.h"
 #include "CommandQueue.h"
+#include "DeferredReleaseQueue.h"
+#include "GpuMemoryAllocator.h"
+#include "HeapStats.h"
+#include "ResourceStateTracker.h"
+#include "UploadRing.h"
+#include "DX12/Dependencies/ImGui/imgui.h"
 #include <iostream>
 
 using namespace Microsoft::WRL;
@@ -10,6 +16,12 @@ using namespace Microsoft::WRL;
 #include <d3dcompiler.h>
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <utility>
 
 using namespace DirectX;
 
@@ -40,12 +52,60 @@ static WORD g_indexes[36] =
         1, 5, 6, 1, 6, 2,
         4, 0, 3, 4, 3, 7};
 
-constexpr size_t g_numRows = 300;
-constexpr size_t g_numColumns = 300;
-constexpr float g_xStride = 0.05f;
-constexpr float g_yStride = 0.05f;
-constexpr float g_cubeSize = 0.01f;
-constexpr size_t g_numInstances = g_numRows * g_numColumns;
+// Root constants of InstanceTransforms_cs.hlsl.
+struct InstanceComputeConstants
+{
+    uint32_t numRows;
+    uint32_t numColumns;
+    float xStride;
+    float yStride;
+    float cubeSize;
+    float anglePhase;
+    uint32_t threadsPerRow;
+};
+
+// Root constants of InstanceScatter_cs.hlsl.
+struct InstanceScatterConstants
+{
+    uint32_t numUpdates;
+    uint32_t threadsPerRow;
+};
+
+constexpr uint32_t g_instanceComputeGroupSize = 64;
+constexpr uint32_t g_instanceScatterGroupSize = 64;
+
+// Thread groups covering numThreads. A dimension holds at most 65535 groups,
+// larger dispatches are split into rows and the shaders rebuild the linear
+// index from the threads per row.
+struct DispatchSize
+{
+    UINT numGroupsX;
+    UINT numGroupsY;
+    uint32_t threadsPerRow;
+};
+
+static DispatchSize GetDispatchSize(size_t numThreads, uint32_t groupSize)
+{
+    size_t numGroups = (numThreads + groupSize - 1) / groupSize;
+    UINT numGroupsX = static_cast<UINT>(std::clamp<size_t>(numGroups, 1, D3D12_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION));
+    UINT numGroupsY = static_cast<UINT>((numGroups + numGroupsX - 1) / numGroupsX);
+    assert(numGroupsY <= D3D12_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION);
+    return {numGroupsX, numGroupsY, numGroupsX * groupSize};
+}
+
+// View of the instances starting at first, so kernels can write packed updates.
+static InstanceTransforms::InstanceSoA OffsetInstances(const InstanceTransforms::InstanceSoA &instances, size_t first)
+{
+    return {instances.scale + first, instances.angle + first,
+            instances.axisX + first, instances.axisY + first, instances.axisZ + first,
+            instances.offsetX + first, instances.offsetY + first, instances.offsetZ + first};
+}
+
+// Initial size of the frame arenas, they grow to the largest frame seen.
+constexpr size_t g_frameArenaCapacity = 1 << 20;
+
+// Weight of the latest sample in the smoothed timings shown in the stats panel.
+constexpr double g_timingSmoothing = 0.05;
 
 Game::Game()
     : m_scissorRect(CD3DX12_RECT(0, 0, LONG_MAX, LONG_MAX)), m_FoV(45.0f)
@@ -55,7 +115,13 @@ Game::Game()
     m_windowHeight = m_window->GetHeight();
     m_viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(m_windowWidth), static_cast<float>(m_windowHeight));
 
+    ReadSettings();
+
     m_fenceValues.resize(m_window->GetNumBackBuffers());
+    for (uint32_t i = 0; i < m_window->GetNumBackBuffers(); i++)
+    {
+        m_frameArenas.push_back(std::make_unique<FrameArena>(g_frameArenaCapacity));
+    }
     ::ShowWindow(m_window->GetWindowHandle(), SW_SHOW);
     m_window->RegisterKeyEventHandler([this](const KeyEventArgs &event)
                                       { this->OnKeyEvent(event); });
@@ -64,20 +130,28 @@ Game::Game()
     m_window->RegisterDestroyEventHandler([this](const HWND)
                                           { this->OnWindowDestroyed(); });
 
+    m_bundleCache = std::make_unique<BundleCache>(Engine::Get().GetDevice());
+    m_renderCommandTranslator = std::make_unique<RenderCommandTranslator>();
+
     m_imGuiRenderer.emplace(m_window);
+    m_imGuiRenderer->RegisterPanelHandler([this]()
+                                          { this->DrawStatsPanel(); });
+
+    m_instanceUpdateMsPerThreadCount.resize(std::max(std::thread::hardware_concurrency(), 1u));
+    m_recordingMsPerThreadCount.resize(m_instanceUpdateMsPerThreadCount.size());
+    m_instanceTransformKernel = InstanceTransforms::GetBestKernel();
 }
 
 void Game::Startup()
 {
     auto device = Engine::Get().GetDevice();
-    auto commandQueue = Engine::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COPY);
-    auto commandList = commandQueue->GetCommandList();
+    UploadManager &uploadManager = Engine::Get().GetUploadManager();
+
+    Engine::Get().GetResidencyManager().RegisterBudgetChangedHandler([this](const ResidencyManager::Budget &budget)
+                                                                     { this->OnVideoMemoryBudgetChanged(budget); });
 
     // Upload vertex buffer data.
-    ComPtr<ID3D12Resource> intermediateVertexBuffer;
-    DXHelpers::UpdateBufferResource(commandList.Get(),
-                                    m_vertexBuffer, &intermediateVertexBuffer,
-                                    _countof(g_vertices), sizeof(VertexPosColor), g_vertices);
+    uploadManager.UploadBuffer(m_vertexBuffer, _countof(g_vertices), sizeof(VertexPosColor), g_vertices);
 
     // Create the vertex buffer view.
     m_vertexBufferView.BufferLocation = m_vertexBuffer->GetGPUVirtualAddress();
@@ -85,10 +159,11 @@ void Game::Startup()
     m_vertexBufferView.StrideInBytes = sizeof(VertexPosColor);
 
     // Upload index buffer data.
-    ComPtr<ID3D12Resource> intermediateIndexBuffer;
-    DXHelpers::UpdateBufferResource(commandList.Get(),
-                                    m_indexBuffer, &intermediateIndexBuffer,
-                                    _countof(g_indexes), sizeof(WORD), g_indexes);
+    uploadManager.UploadBuffer(m_indexBuffer, _countof(g_indexes), sizeof(WORD), g_indexes);
+
+    // The copies run while the rest of the startup work is done.
+    m_geometryUploadTicket = uploadManager.Submit();
+    Engine::Get().StartTask(TrackGeometryUpload(m_geometryUploadTicket));
 
     // Create index buffer view.
     m_indexBufferView.BufferLocation = m_indexBuffer->GetGPUVirtualAddress();
@@ -96,6 +171,8 @@ void Game::Startup()
     m_indexBufferView.SizeInBytes = sizeof(g_indexes);
 
     CreateInstanceBuffer();
+    InitInstanceAnimation();
+    CreateTimestampQueries();
 
     // Create the descriptor heap for the depth-stencil view.
     D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc = {};
@@ -121,10 +198,16 @@ void Game::Startup()
     D3D12_INPUT_ELEMENT_DESC inputLayout[] = {
         {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
         {"COLOR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+#if DX12_COMPACT_INSTANCES
+        {"INSTANCE_POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1},
+        {"INSTANCE_ROTATION", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1},
+        {"INSTANCE_SCALE", 0, DXGI_FORMAT_R16_FLOAT, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1}};
+#else
         {"MODEL", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1},
         {"MODEL", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1},
         {"MODEL", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1},
         {"MODEL", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1}};
+#endif
 
     // Create a root signature.
     D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {};
@@ -182,9 +265,12 @@ void Game::Startup()
     D3D12_PIPELINE_STATE_STREAM_DESC pipelineStateStreamDesc = {
         sizeof(PipelineStateStream), &pipelineStateStream};
     assert(SUCCEEDED(device->CreatePipelineState(&pipelineStateStreamDesc, IID_PPV_ARGS(&m_pipelineState))));
+    m_scenePipeline = m_renderCommandTranslator->RegisterPipeline(m_pipelineState, m_rootSignature, D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    // The scene bundles set the previous pipeline state.
+    m_bundleCache->Invalidate();
 
-    auto fenceValue = commandQueue->ExecuteCommandList(commandList);
-    commandQueue->WaitForFenceValue(fenceValue);
+    CreateInstanceComputePipeline();
+    CreateInstanceScatterPipeline();
 
     // Resize/Create the depth buffer.
     ResizeDepthBuffer(m_windowWidth, m_windowHeight);
@@ -199,6 +285,40 @@ void Game::Update(double deltaTime)
 
     m_currentTime += deltaTime;
 
+    uint64_t heapAllocations = HeapStats::GetNumAllocations();
+    m_heapAllocationsPerFrame = heapAllocations - m_frameStartHeapAllocations;
+    m_frameStartHeapAllocations = heapAllocations;
+
+    uint64_t barriers = ResourceStateTracker::GetNumBarriers();
+    uint64_t barrierCalls = ResourceStateTracker::GetNumBarrierCalls();
+    m_barriersPerFrame = barriers - m_frameStartBarriers;
+    m_barrierCallsPerFrame = barrierCalls - m_frameStartBarrierCalls;
+    m_frameStartBarriers = barriers;
+    m_frameStartBarrierCalls = barrierCalls;
+
+    const CommandQueue &directCommandQueue = *Engine::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+    uint64_t executedCommandLists = directCommandQueue.GetNumExecutedCommandLists();
+    uint64_t submissions = directCommandQueue.GetNumSubmissions();
+    m_executedCommandListsPerFrame = executedCommandLists - m_frameStartExecutedCommandLists;
+    m_submissionsPerFrame = submissions - m_frameStartSubmissions;
+    m_frameStartExecutedCommandLists = executedCommandLists;
+    m_frameStartSubmissions = submissions;
+
+    // This frame renders to the current back buffer. Once the frame that last
+    // used it has completed its transient memory can be reused. This is the
+    // only CPU wait of a frame, it is timed apart from the frame's own work.
+    m_currentFrameIndex = m_window->GetCurrentBackBufferIndex();
+    Clock waitClock;
+    Engine::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT)->WaitForFenceValue(m_fenceValues[m_currentFrameIndex]);
+    waitClock.Update();
+    m_frameArenas[m_currentFrameIndex]->Reset();
+
+    if (m_scalingBenchmark.has_value())
+    {
+        UpdateScalingBenchmark(deltaTime);
+    }
+    m_lastFrameWaitMs = waitClock.GetCurrentTime() * 1000.0;
+
     // Update the view matrix.
     const DirectX::XMVECTOR eyePosition = DirectX::XMVectorSet(0, 0, -10, 1);
     const DirectX::XMVECTOR focusPoint = DirectX::XMVectorSet(0, 0, 0, 1);
@@ -209,22 +329,39 @@ void Game::Update(double deltaTime)
     float aspectRatio = static_cast<float>(m_windowWidth) / static_cast<float>(m_windowHeight);
     m_projectionMatrix = DirectX::XMMatrixPerspectiveFovLH(DirectX::XMConvertToRadians(m_FoV), aspectRatio, 0.1f, 100.0f);
 
-    UpdateInstanceData();
+    if (m_useGpuInstanceTransforms)
+    {
+        DispatchInstanceCompute();
+    }
+    else
+    {
+        UpdateInstanceData();
+    }
 }
 
 void Game::Render()
 {
     auto commandQueue = Engine::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
-    auto commandList = commandQueue->GetCommandList();
+    JobSystem &jobSystem = Engine::Get().GetJobSystem();
 
     UINT currentBackBufferIndex = m_window->GetCurrentBackBufferIndex();
     auto backBuffer = m_window->GetCurrentBackBuffer();
     auto rtv = m_window->GetCurrentRenderTargetView();
     auto dsv = m_DSVHeap->GetCPUDescriptorHandleForHeapStart();
 
+    // The stats panel may change settings, this frame is recorded with the ones
+    // it was updated with.
+    bool useGpuInstanceTransforms = m_useGpuInstanceTransforms;
+    m_imGuiRenderer->BuildFrame();
+    bool useSceneBundles = m_useSceneBundles;
+
+    auto commandList = commandQueue->GetCommandList();
+    ResourceStateTracker &resourceStateTracker = commandQueue->GetResourceStateTracker(commandList);
+
     // Clear the render targets.
     {
-        DXHelpers::TransitionResource(commandList, backBuffer, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
+        resourceStateTracker.TransitionResource(backBuffer.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET);
+        resourceStateTracker.FlushResourceBarriers(commandList.Get());
 
         FLOAT clearColor[] = {0.4f, 0.6f, 0.9f, 1.0f};
 
@@ -232,15 +369,95 @@ void Game::Render()
         commandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
     }
 
-    UpdateInstanceBuffer(commandList);
+    UINT timestampIndex = currentBackBufferIndex * 2;
+    commandList->EndQuery(m_timestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, timestampIndex);
 
-    commandList->SetPipelineState(m_pipelineState.Get());
-    commandList->SetGraphicsRootSignature(m_rootSignature.Get());
+    if (!useGpuInstanceTransforms)
+    {
+        UpdateInstanceBuffer(commandList);
+        resourceStateTracker.TransitionResource(m_instanceBuffer.Get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+        resourceStateTracker.FlushResourceBarriers(commandList.Get());
+    }
 
-    commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    commandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
-    commandList->IASetVertexBuffers(1, 1, &m_instanceBufferView);
-    commandList->IASetIndexBuffer(&m_indexBufferView);
+    commandList->EndQuery(m_timestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, timestampIndex + 1);
+    Engine::Get().GetReadbackService().ResolveQueryData(commandList, m_timestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, timestampIndex, 2, [this](const ReadbackService::View &view)
+                                                        { this->ReadInstanceUploadTimestamps(view); });
+
+    // The scene draws are split over one command list per job thread and
+    // recorded in parallel with the UI, which goes last.
+    size_t numSceneCommandLists = std::min<size_t>(jobSystem.GetNumThreads(), m_numSceneDraws);
+    m_frameCommandLists.resize(numSceneCommandLists + 2);
+
+    // Bundles are keyed by scene command list, their draw ranges follow the count.
+    if (numSceneCommandLists != m_numSceneBundleCommandLists)
+    {
+        m_bundleCache->Invalidate();
+        m_numSceneBundleCommandLists = numSceneCommandLists;
+    }
+    // Every scene command list records its render commands into a stream of its own.
+    while (m_sceneCommandStreams.size() < numSceneCommandLists)
+    {
+        m_sceneCommandStreams.push_back(std::make_unique<RenderCommandStream>());
+    }
+    m_frameCommandLists[0] = commandList;
+
+    Clock recordingClock;
+    jobSystem.ParallelFor(1, m_frameCommandLists.size(), 1, [&](size_t begin, size_t end)
+                          {
+                              for (size_t i = begin; i < end; i++)
+                              {
+                                  ComPtr<ID3D12GraphicsCommandList2> &parallelCommandList = m_frameCommandLists[i];
+                                  size_t sceneCommandListIndex = i - 1;
+                                  if (sceneCommandListIndex < numSceneCommandLists)
+                                  {
+                                      size_t firstDraw = m_numSceneDraws * sceneCommandListIndex / numSceneCommandLists;
+                                      size_t endDraw = m_numSceneDraws * (sceneCommandListIndex + 1) / numSceneCommandLists;
+                                      parallelCommandList = commandQueue->GetCommandList();
+                                      RecordSceneDraws(parallelCommandList, backBuffer.Get(), rtv, dsv, *m_sceneCommandStreams[sceneCommandListIndex], firstDraw, endDraw, useSceneBundles);
+                                  }
+                                  else
+                                  {
+                                      parallelCommandList = commandQueue->GetCommandList();
+                                      commandQueue->GetResourceStateTracker(parallelCommandList).TransitionResource(backBuffer.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET);
+                                      parallelCommandList->OMSetRenderTargets(1, &rtv, FALSE, nullptr);
+                                      m_imGuiRenderer->RecordCommands(parallelCommandList);
+                                  }
+                              } });
+    recordingClock.Update();
+    UpdateRecordingTimes(recordingClock.GetCurrentTime() * 1000.0, useSceneBundles);
+
+    // Present
+    {
+        ResourceStateTracker &lastResourceStateTracker = commandQueue->GetResourceStateTracker(m_frameCommandLists.back());
+        lastResourceStateTracker.TransitionResource(backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT);
+
+        // Later frames are queued behind this one, a single wait covers them.
+        Engine::Get().GetUploadManager().WaitOnGpu(*commandQueue, m_geometryUploadTicket);
+        m_geometryUploadTicket = {};
+
+        // Let the GPU wait for the compute pass instead of blocking the CPU.
+        const CommandQueue::Dependency frameDependencies[] = {
+            {Engine::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COMPUTE).get(), useGpuInstanceTransforms ? m_instanceComputeFenceValue : 0}};
+
+        MarkResourcesUsed();
+        m_fenceValues[currentBackBufferIndex] = commandQueue->ExecuteCommandLists(m_frameCommandLists, frameDependencies);
+        m_lastRenderFenceValue = m_fenceValues[currentBackBufferIndex];
+        Engine::Get().GetReadbackService().Submit(m_lastRenderFenceValue);
+
+
+        // The next frame waits for its back buffer in Update.
+        m_window->Present();
+    }
+}
+
+void Game::RecordSceneDraws(ComPtr<ID3D12GraphicsCommandList2> commandList, ID3D12Resource *backBuffer, D3D12_CPU_DESCRIPTOR_HANDLE rtv, D3D12_CPU_DESCRIPTOR_HANDLE dsv, RenderCommandStream &commandStream, size_t firstDraw, size_t endDraw, bool useBundle)
+{
+    ResourceStateTracker &resourceStateTracker = Engine::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT)->GetResourceStateTracker(commandList);
+    resourceStateTracker.TransitionResource(backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+
+    // Bundles inherit the root signature and its arguments, and cannot set the
+    // viewport or the render targets.
+    commandList->SetGraphicsRootSignature(m_rootSignature.Get());
 
     commandList->RSSetViewports(1, &m_viewport);
     commandList->RSSetScissorRects(1, &m_scissorRect);
@@ -251,21 +468,58 @@ void Game::Render()
     DirectX::XMMATRIX vpMatrix = DirectX::XMMatrixMultiply(m_viewMatrix, m_projectionMatrix);
     commandList->SetGraphicsRoot32BitConstants(0, sizeof(DirectX::XMMATRIX) / 4, &vpMatrix, 0);
 
-    commandList->DrawIndexedInstanced(_countof(g_indexes), g_numInstances, 0, 0, 0);
-
-    m_imGuiRenderer->Render(commandList);
+    if (useBundle)
+    {
+        // Scene command lists keep their draw range until the bundles are invalidated.
+        ID3D12GraphicsCommandList2 *bundle = m_bundleCache->GetBundle(firstDraw, [this, &commandStream, firstDraw, endDraw](ID3D12GraphicsCommandList2 *bundle)
+                                                                      { this->RecordSceneDrawSequence(bundle, nullptr, commandStream, firstDraw, endDraw); });
+        commandList->ExecuteBundle(bundle);
+    }
+    else
+    {
+        RecordSceneDrawSequence(commandList.Get(), &resourceStateTracker, commandStream, firstDraw, endDraw);
+    }
+}
 
-    // Present
+void Game::RecordSceneDrawSequence(ID3D12GraphicsCommandList2 *commandList, ResourceStateTracker *resourceStateTracker, RenderCommandStream &commandStream, size_t firstDraw, size_t endDraw)
+{
+    commandStream.Reset();
+    commandStream.SetPipeline(m_scenePipeline);
+    commandStream.SetVertexBuffer(0, m_vertexBufferView.BufferLocation, m_vertexBufferView.SizeInBytes, m_vertexBufferView.StrideInBytes);
+    commandStream.SetVertexBuffer(1, m_instanceBufferView.BufferLocation, m_instanceBufferView.SizeInBytes, m_instanceBufferView.StrideInBytes);
+    commandStream.SetIndexBuffer(m_indexBufferView.BufferLocation, m_indexBufferView.SizeInBytes, static_cast<uint32_t>(sizeof(g_indexes[0])));
+
+    // Every draw covers a contiguous range of instances.
+    size_t instancesPerDraw = (m_numInstances + m_numSceneDraws - 1) / m_numSceneDraws;
+    for (size_t draw = firstDraw; draw < endDraw; draw++)
     {
-        DXHelpers::TransitionResource(commandList, backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+        size_t firstInstance = std::min(draw * instancesPerDraw, m_numInstances);
+        size_t numInstances = std::min(instancesPerDraw, m_numInstances - firstInstance);
+        commandStream.DrawIndexedInstanced(_countof(g_indexes), static_cast<UINT>(numInstances), 0, 0, static_cast<UINT>(firstInstance));
+    }
 
-        m_fenceValues[currentBackBufferIndex] = commandQueue->ExecuteCommandList(commandList);
+    // The caller has set the scene root signature.
+    commandStream.Sort();
+    m_renderCommandTranslator->Translate(commandStream, commandList, resourceStateTracker, m_rootSignature.Get());
+}
 
+FenceScheduler::Task Game::TrackGeometryUpload(UploadManager::Ticket ticket)
+{
+    double startTime = m_currentTime;
+    co_await Engine::Get().WaitForFenceAsync(D3D12_COMMAND_LIST_TYPE_COPY, ticket.fenceValue);
+    m_geometryUploadSeconds = m_currentTime - startTime;
+}
 
-        currentBackBufferIndex = m_window->Present();
+void Game::UpdateRecordingTimes(double recordingMs, bool usedSceneBundles)
+{
+    m_recordingMs += (recordingMs - m_recordingMs) * g_timingSmoothing;
 
-        commandQueue->WaitForFenceValue(m_fenceValues[currentBackBufferIndex]);
-    }
+    double &bundleUseMs = usedSceneBundles ? m_recordingMsWithBundles : m_recordingMsWithoutBundles;
+    bundleUseMs = bundleUseMs == 0.0 ? recordingMs : bundleUseMs + (recordingMs - bundleUseMs) * g_timingSmoothing;
+
+    size_t threadCountIndex = std::min<size_t>(Engine::Get().GetJobSystem().GetNumThreads(), m_recordingMsPerThreadCount.size()) - 1;
+    double &threadCountMs = m_recordingMsPerThreadCount[threadCountIndex];
+    threadCountMs = threadCountMs == 0.0 ? recordingMs : threadCountMs + (recordingMs - threadCountMs) * g_timingSmoothing;
 }
 
 void Game::Paint()
@@ -319,13 +573,11 @@ void Game::OnWindowDestroyed()
 
 void Game::ResizeDepthBuffer(uint32_t width, uint32_t height)
 {
-    // Flush any GPU commands that might be referencing the depth buffer.
-    Engine::Get().WaitForGPU();
-
     width = std::max(1u, width);
     height = std::max(1u, height);
 
     auto device = Engine::Get().GetDevice();
+    GpuMemoryAllocator &gpuMemoryAllocator = Engine::Get().GetGpuMemoryAllocator();
 
     // Resize screen dependent resources.
     // Create a depth buffer.
@@ -333,16 +585,19 @@ void Game::ResizeDepthBuffer(uint32_t width, uint32_t height)
     optimizedClearValue.Format = DXGI_FORMAT_D32_FLOAT;
     optimizedClearValue.DepthStencil = {1.0f, 0};
 
-    CD3DX12_HEAP_PROPERTIES depthBufferHeapProps(D3D12_HEAP_TYPE_DEFAULT);
     CD3DX12_RESOURCE_DESC depthBufferTexDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D32_FLOAT, width, height, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
 
-    assert(SUCCEEDED(device->CreateCommittedResource(
-        &depthBufferHeapProps,
-        D3D12_HEAP_FLAG_NONE,
-        &depthBufferTexDesc,
-        D3D12_RESOURCE_STATE_DEPTH_WRITE,
-        &optimizedClearValue,
-        IID_PPV_ARGS(&m_depthBuffer))));
+    // Frames in flight may still be using the old depth buffer, it keeps its
+    // memory until they are done. The depth-stencil view below is a CPU
+    // descriptor, recorded command lists hold a copy of the old one.
+    if (m_depthBuffer)
+    {
+        Engine::Get().DeferRelease([depthBuffer = std::move(m_depthBuffer)]() mutable
+                                   { Engine::Get().GetGpuMemoryAllocator().ReleaseResource(depthBuffer); });
+    }
+
+    // The depth buffer is cleared every frame, which also initializes the placed resource.
+    m_depthBuffer = gpuMemoryAllocator.CreateResource(D3D12_HEAP_TYPE_DEFAULT, depthBufferTexDesc, D3D12_RESOURCE_STATE_DEPTH_WRITE, &optimizedClearValue);
 
     // Update the depth-stencil view.
     D3D12_DEPTH_STENCIL_VIEW_DESC dsv = {};
@@ -354,70 +609,763 @@ void Game::ResizeDepthBuffer(uint32_t width, uint32_t height)
     device->CreateDepthStencilView(m_depthBuffer.Get(), &dsv, m_DSVHeap->GetCPUDescriptorHandleForHeapStart());
 }
 
+void Game::ReadSettings()
+{
+    const CommandLine &commandLine = Engine::Get().GetCommandLineArguments();
+
+    m_instanceGrid.numRows = std::max<size_t>(commandLine.GetSize(L"rows", m_instanceGrid.numRows), 1);
+    m_instanceGrid.numColumns = std::max<size_t>(commandLine.GetSize(L"columns", m_instanceGrid.numColumns), 1);
+    m_instanceGrid.xStride = commandLine.GetFloat(L"xStride", m_instanceGrid.xStride);
+    m_instanceGrid.yStride = commandLine.GetFloat(L"yStride", m_instanceGrid.yStride);
+    m_instanceGrid.cubeSize = commandLine.GetFloat(L"cubeSize", m_instanceGrid.cubeSize);
+    m_numInstances = m_instanceGrid.numRows * m_instanceGrid.numColumns;
+
+    m_animatedInstanceFraction = std::clamp(commandLine.GetFloat(L"animated", m_animatedInstanceFraction), 0.0f, 1.0f);
+    m_useTransformHierarchy = commandLine.HasFlag(L"hierarchy");
+    m_numSceneDraws = std::max<size_t>(commandLine.GetSize(L"sceneDraws", m_numSceneDraws), 1);
+    m_useSceneBundles = !commandLine.HasFlag(L"noBundles");
+
+    // Frames end waiting on the direct queue, 0 blocks, 1 spins then blocks, 2 yields.
+    size_t waitPolicy = std::min(commandLine.GetSize(L"waitPolicy", 0), static_cast<size_t>(FenceWaiter::Policy::Count) - 1);
+    Engine::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT)->SetWaitPolicy(static_cast<FenceWaiter::Policy>(waitPolicy));
+
+    if (commandLine.HasFlag(L"sweep"))
+    {
+        ScalingBenchmark::Settings settings;
+        settings.minInstances = commandLine.GetSize(L"sweepMin", settings.minInstances);
+        settings.maxInstances = commandLine.GetSize(L"sweepMax", settings.maxInstances);
+        settings.measuredFrames = static_cast<uint32_t>(commandLine.GetSize(L"sweepFrames", settings.measuredFrames));
+        // The upload timings of a step are read back once its frames in flight retire.
+        settings.warmupFrames = std::max(static_cast<uint32_t>(commandLine.GetSize(L"sweepWarmup", settings.warmupFrames)), m_window->GetNumBackBuffers());
+
+        m_scalingBenchmark.emplace(settings);
+        m_scalingBenchmarkOutput = commandLine.GetString(L"sweepOutput", L"scaling");
+        ResizeInstanceGrid(m_scalingBenchmark->GetTargetInstanceCount());
+    }
+}
+
+void Game::ResizeInstanceGrid(size_t numInstances)
+{
+    // Keep the grid square, the actual count is reported with the results.
+    m_instanceGrid.numRows = std::max<size_t>(static_cast<size_t>(std::lround(std::sqrt(static_cast<double>(numInstances)))), 1);
+    m_instanceGrid.numColumns = std::max<size_t>((numInstances + m_instanceGrid.numRows / 2) / m_instanceGrid.numRows, 1);
+    m_numInstances = m_instanceGrid.numRows * m_instanceGrid.numColumns;
+
+    std::fill(m_instanceUpdateMsPerThreadCount.begin(), m_instanceUpdateMsPerThreadCount.end(), 0.0);
+
+    // Before startup there are no instance resources yet. The GPU is not
+    // flushed, the warm-up frames of the benchmark step cover the frames still
+    // in flight with the previous buffers.
+    if (m_instanceBuffer)
+    {
+        CreateInstanceBuffer();
+        InitInstanceAnimation();
+    }
+}
+
+void Game::UpdateScalingBenchmark(double deltaTime)
+{
+    // Samples describe the previous frame. The GPU upload time lags a few frames
+    // behind, the warm-up frames of every step cover that.
+    ScalingBenchmark::FrameSample sample = {
+        .frameMs = deltaTime * 1000.0,
+        .waitMs = m_lastFrameWaitMs,
+        .cpuUpdateMs = m_lastInstanceUpdateMs,
+        .gpuUploadMs = m_lastInstanceUploadGpuMs,
+        .uploadBytes = m_instanceUploadBytes};
+
+    if (!m_scalingBenchmark->AddFrame(m_numInstances, sample))
+    {
+        return;
+    }
+
+    if (m_scalingBenchmark->IsComplete())
+    {
+        std::ofstream csvFile(std::filesystem::path(m_scalingBenchmarkOutput + L".csv"));
+        m_scalingBenchmark->WriteCsv(csvFile);
+
+        std::ofstream jsonFile(std::filesystem::path(m_scalingBenchmarkOutput + L".json"));
+        m_scalingBenchmark->WriteJson(jsonFile);
+
+        m_scalingBenchmark.reset();
+        Engine::Get().Exit();
+        return;
+    }
+
+    ResizeInstanceGrid(m_scalingBenchmark->GetTargetInstanceCount());
+}
+
 void Game::CreateInstanceBuffer()
 {
-    auto device = Engine::Get().GetDevice();
-    LONG_PTR bufferSize = g_numInstances * sizeof(InstanceData);
-
-    CD3DX12_HEAP_PROPERTIES instanceHeapProps(D3D12_HEAP_TYPE_DEFAULT);
-    CD3DX12_RESOURCE_DESC instanceBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
-
-    assert(SUCCEEDED(device->CreateCommittedResource(
-        &instanceHeapProps,
-        D3D12_HEAP_FLAG_NONE,
-        &instanceBufferDesc,
-        D3D12_RESOURCE_STATE_COMMON,
-        nullptr,
-        IID_PPV_ARGS(&m_instanceBuffer))));
-
-    CD3DX12_HEAP_PROPERTIES uploadHeapProps(D3D12_HEAP_TYPE_UPLOAD);
-    CD3DX12_RESOURCE_DESC uploadBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
-
-    assert(SUCCEEDED(device->CreateCommittedResource(
-        &uploadHeapProps,
-        D3D12_HEAP_FLAG_NONE,
-        &uploadBufferDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&m_instanceUploadBuffer))));
+    GpuMemoryAllocator &gpuMemoryAllocator = Engine::Get().GetGpuMemoryAllocator();
+    size_t bufferSize = m_numInstances * sizeof(InstanceData);
+
+    // Resizing the grid recreates the buffers while frames in flight may still
+    // read the old ones, they keep their memory until those frames are done.
+    if (m_instanceBuffer)
+    {
+        Engine::Get().DeferRelease([instanceBuffer = std::move(m_instanceBuffer), instanceUploadBuffer = std::move(m_instanceUploadBuffer), instanceIndexUploadBuffer = std::move(m_instanceIndexUploadBuffer)]() mutable
+                                   {
+            GpuMemoryAllocator &gpuMemoryAllocator = Engine::Get().GetGpuMemoryAllocator();
+            gpuMemoryAllocator.ReleaseResource(instanceBuffer);
+            gpuMemoryAllocator.ReleaseResource(instanceUploadBuffer);
+            gpuMemoryAllocator.ReleaseResource(instanceIndexUploadBuffer); });
+    }
+
+    // The instance buffer is written either by copies from the upload buffer or by the compute pass.
+    CD3DX12_RESOURCE_DESC instanceBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+    m_instanceBuffer = gpuMemoryAllocator.CreateResource(D3D12_HEAP_TYPE_DEFAULT, instanceBufferDesc, D3D12_RESOURCE_STATE_COMMON);
+
+    // One upload region per frame in flight, so the CPU never overwrites data
+    // the GPU is still copying from.
+    CD3DX12_RESOURCE_DESC uploadBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize * m_window->GetNumBackBuffers());
+    m_instanceUploadBuffer = gpuMemoryAllocator.CreateResource(D3D12_HEAP_TYPE_UPLOAD, uploadBufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ);
+
+    // Indices of the instances in each upload region, when only some of them are uploaded.
+    CD3DX12_RESOURCE_DESC indexUploadBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(m_numInstances * sizeof(uint32_t) * m_window->GetNumBackBuffers());
+    m_instanceIndexUploadBuffer = gpuMemoryAllocator.CreateResource(D3D12_HEAP_TYPE_UPLOAD, indexUploadBufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ);
+
+    // Map the upload buffers for their whole lifetime. They are write-combined
+    // memory, so they are only ever written sequentially and never read back.
+    D3D12_RANGE readRange = {0, 0}; // We won't read from this resource on the CPU
+    assert(SUCCEEDED(m_instanceUploadBuffer->Map(0, &readRange, reinterpret_cast<void **>(&m_mappedInstanceData))));
+    assert(SUCCEEDED(m_instanceIndexUploadBuffer->Map(0, &readRange, reinterpret_cast<void **>(&m_mappedInstanceIndices))));
+
+    m_dirtyInstances.Resize(m_numInstances);
+    m_instanceBufferValid = false;
 
     // Create instance buffer view.
     m_instanceBufferView.BufferLocation = m_instanceBuffer->GetGPUVirtualAddress();
     m_instanceBufferView.StrideInBytes = sizeof(InstanceData);
-    m_instanceBufferView.SizeInBytes = g_numInstances * sizeof(InstanceData);
+    m_instanceBufferView.SizeInBytes = static_cast<UINT>(m_numInstances * sizeof(InstanceData));
+
+    // The scene bundles bind the previous instance buffer and draw the previous instance count.
+    m_bundleCache->Invalidate();
+}
+
+void Game::CreateTimestampQueries()
+{
+    auto device = Engine::Get().GetDevice();
+    UINT numTimestamps = 2 * m_window->GetNumBackBuffers();
+
+    D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+    queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    queryHeapDesc.Count = numTimestamps;
+    assert(SUCCEEDED(device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_timestampQueryHeap))));
+
+    assert(SUCCEEDED(Engine::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT)->GetD3D12CommandQueue()->GetTimestampFrequency(&m_timestampFrequency)));
+}
+
+void Game::ReadInstanceUploadTimestamps(const ReadbackService::View &view)
+{
+    uint64_t timestamps[2];
+    std::memcpy(timestamps, view.data, sizeof(timestamps));
+    uint64_t begin = timestamps[0];
+    uint64_t end = timestamps[1];
+
+    m_lastInstanceUploadGpuMs = end > begin ? static_cast<double>(end - begin) * 1000.0 / static_cast<double>(m_timestampFrequency) : 0.0;
+    m_instanceUploadGpuMs += (m_lastInstanceUploadGpuMs - m_instanceUploadGpuMs) * g_timingSmoothing;
+}
+
+void Game::CreateInstanceComputePipeline()
+{
+    auto device = Engine::Get().GetDevice();
+
+    ComPtr<ID3DBlob> computeShaderBlob;
+    assert(SUCCEEDED(D3DReadFileToBlob(L"Shaders\\InstanceTransforms_cs.cso", &computeShaderBlob)));
+
+    D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {};
+    featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
+    if (FAILED(device->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE, &featureData, sizeof(featureData))))
+    {
+        featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
+    }
+
+    // The animation constants and the instance buffer, bound as a root UAV.
+    CD3DX12_ROOT_PARAMETER1 rootParameters[2];
+    rootParameters[0].InitAsConstants(sizeof(InstanceComputeConstants) / 4, 0, 0, D3D12_SHADER_VISIBILITY_ALL);
+    rootParameters[1].InitAsUnorderedAccessView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_ALL);
+
+    CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDescription;
+    rootSignatureDescription.Init_1_1(_countof(rootParameters), rootParameters, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_NONE);
+
+    ComPtr<ID3DBlob> rootSignatureBlob;
+    ComPtr<ID3DBlob> errorBlob;
+    assert(SUCCEEDED(D3DX12SerializeVersionedRootSignature(&rootSignatureDescription, featureData.HighestVersion, &rootSignatureBlob, &errorBlob)));
+    assert(SUCCEEDED(device->CreateRootSignature(0, rootSignatureBlob->GetBufferPointer(), rootSignatureBlob->GetBufferSize(), IID_PPV_ARGS(&m_instanceComputeRootSignature))));
+
+    struct PipelineStateStream
+    {
+        CD3DX12_PIPELINE_STATE_STREAM_ROOT_SIGNATURE pRootSignature;
+        CD3DX12_PIPELINE_STATE_STREAM_CS computeShader;
+    } pipelineStateStream;
+
+    pipelineStateStream.pRootSignature = m_instanceComputeRootSignature.Get();
+    pipelineStateStream.computeShader = CD3DX12_SHADER_BYTECODE(computeShaderBlob.Get());
+
+    D3D12_PIPELINE_STATE_STREAM_DESC pipelineStateStreamDesc = {
+        sizeof(PipelineStateStream), &pipelineStateStream};
+    assert(SUCCEEDED(device->CreatePipelineState(&pipelineStateStreamDesc, IID_PPV_ARGS(&m_instanceComputePipelineState))));
+}
+
+void Game::CreateInstanceScatterPipeline()
+{
+    auto device = Engine::Get().GetDevice();
+
+    ComPtr<ID3DBlob> computeShaderBlob;
+    assert(SUCCEEDED(D3DReadFileToBlob(L"Shaders\\InstanceScatter_cs.cso", &computeShaderBlob)));
+
+    D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {};
+    featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
+    if (FAILED(device->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE, &featureData, sizeof(featureData))))
+    {
+        featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
+    }
+
+    // The scatter constants, the packed updates and their indices in the upload
+    // buffers, and the instance buffer.
+    CD3DX12_ROOT_PARAMETER1 rootParameters[4];
+    rootParameters[0].InitAsConstants(sizeof(InstanceScatterConstants) / 4, 0, 0, D3D12_SHADER_VISIBILITY_ALL);
+    rootParameters[1].InitAsShaderResourceView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, D3D12_SHADER_VISIBILITY_ALL);
+    rootParameters[2].InitAsShaderResourceView(1, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, D3D12_SHADER_VISIBILITY_ALL);
+    rootParameters[3].InitAsUnorderedAccessView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_ALL);
+
+    CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDescription;
+    rootSignatureDescription.Init_1_1(_countof(rootParameters), rootParameters, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_NONE);
+
+    ComPtr<ID3DBlob> rootSignatureBlob;
+    ComPtr<ID3DBlob> errorBlob;
+    assert(SUCCEEDED(D3DX12SerializeVersionedRootSignature(&rootSignatureDescription, featureData.HighestVersion, &rootSignatureBlob, &errorBlob)));
+    assert(SUCCEEDED(device->CreateRootSignature(0, rootSignatureBlob->GetBufferPointer(), rootSignatureBlob->GetBufferSize(), IID_PPV_ARGS(&m_instanceScatterRootSignature))));
+
+    struct PipelineStateStream
+    {
+        CD3DX12_PIPELINE_STATE_STREAM_ROOT_SIGNATURE pRootSignature;
+        CD3DX12_PIPELINE_STATE_STREAM_CS computeShader;
+    } pipelineStateStream;
+
+    pipelineStateStream.pRootSignature = m_instanceScatterRootSignature.Get();
+    pipelineStateStream.computeShader = CD3DX12_SHADER_BYTECODE(computeShaderBlob.Get());
+
+    D3D12_PIPELINE_STATE_STREAM_DESC pipelineStateStreamDesc = {
+        sizeof(PipelineStateStream), &pipelineStateStream};
+    assert(SUCCEEDED(device->CreatePipelineState(&pipelineStateStreamDesc, IID_PPV_ARGS(&m_instanceScatterPipelineState))));
+}
+
+void Game::InitInstanceAnimation()
+{
+    m_instanceAnimation.scale.assign(m_numInstances, m_instanceGrid.cubeSize);
+    m_instanceAnimation.angle.assign(m_numInstances, 0.0f);
+
+    // Same axis as the DirectXMath path, normalized up front.
+    const float axisComponent = 1.0f / std::sqrt(2.0f);
+    m_instanceAnimation.axisX.assign(m_numInstances, 0.0f);
+    m_instanceAnimation.axisY.assign(m_numInstances, axisComponent);
+    m_instanceAnimation.axisZ.assign(m_numInstances, axisComponent);
+
+    m_instanceAnimation.offsetX.resize(m_numInstances);
+    m_instanceAnimation.offsetY.resize(m_numInstances);
+    m_instanceAnimation.offsetZ.assign(m_numInstances, 0.0f);
+    for (int32_t x = 0; x < (int32_t)m_instanceGrid.numRows; x++)
+    {
+        for (int32_t y = 0; y < (int32_t)m_instanceGrid.numColumns; y++)
+        {
+            m_instanceAnimation.offsetX[x * m_instanceGrid.numColumns + y] = (float)(x - (int32_t)m_instanceGrid.numRows / 2) * m_instanceGrid.xStride;
+            m_instanceAnimation.offsetY[x * m_instanceGrid.numColumns + y] = (float)(y - (int32_t)m_instanceGrid.numColumns / 2) * m_instanceGrid.yStride;
+        }
+    }
+
+    InitInstanceHierarchy();
+}
+
+void Game::InitInstanceHierarchy()
+{
+    // Nodes [0, numRows) are the rows, instance i is node numRows + i. Breadth-first
+    // order keeps the instances in instance buffer order after the rows.
+    std::vector<TransformHierarchy::NodeIndex> parents(m_instanceGrid.numRows + m_numInstances, TransformHierarchy::s_noParent);
+    for (size_t i = 0; i < m_numInstances; i++)
+    {
+        parents[m_instanceGrid.numRows + i] = static_cast<TransformHierarchy::NodeIndex>(i / m_instanceGrid.numColumns);
+    }
+    m_instanceHierarchy.Build(parents);
+
+    // Rows only offset their instances, which spin about their own centre like
+    // they do without the hierarchy.
+    for (int32_t x = 0; x < (int32_t)m_instanceGrid.numRows; x++)
+    {
+        TransformHierarchy::Transform row;
+        row.position[0] = (float)(x - (int32_t)m_instanceGrid.numRows / 2) * m_instanceGrid.xStride;
+        m_instanceHierarchy.SetLocalTransform(static_cast<TransformHierarchy::NodeIndex>(x), row);
+    }
+    for (size_t i = 0; i < m_numInstances; i++)
+    {
+        TransformHierarchy::Transform instance;
+        instance.position[1] = m_instanceAnimation.offsetY[i];
+        instance.scale = m_instanceGrid.cubeSize;
+        m_instanceHierarchy.SetLocalTransform(static_cast<TransformHierarchy::NodeIndex>(m_instanceGrid.numRows + i), instance);
+    }
 }
 
 void Game::UpdateInstanceData()
 {
-    if (m_instanceData.get() == nullptr)
+    // Write to the region of the back buffer this frame renders to. The region
+    // was last copied by the frame that used the same back buffer, which Update
+    // has already waited for.
+    m_currentInstanceUploadRegion = m_currentFrameIndex;
+
+    Clock updateClock;
+
+#if !DX12_COMPACT_INSTANCES
+    const DirectX::XMMATRIX scaleMatrix = DirectX::XMMatrixScaling(m_instanceGrid.cubeSize, m_instanceGrid.cubeSize, m_instanceGrid.cubeSize);
+#endif
+    const DirectX::XMVECTOR rotationAxis = DirectX::XMVectorSet(0, 1, 1, 0);
+
+#if DX12_COMPACT_INSTANCES
+    InstanceTransforms::CompactInstance *transforms = m_mappedInstanceData + m_currentInstanceUploadRegion * m_numInstances;
+#else
+    static_assert(sizeof(InstanceData) == sizeof(InstanceTransforms::Float4x4));
+    InstanceTransforms::Float4x4 *transforms = reinterpret_cast<InstanceTransforms::Float4x4 *>(m_mappedInstanceData + m_currentInstanceUploadRegion * m_numInstances);
+#endif
+    InstanceTransforms::InstanceSoA instances = {
+        m_instanceAnimation.scale.data(), m_instanceAnimation.angle.data(),
+        m_instanceAnimation.axisX.data(), m_instanceAnimation.axisY.data(), m_instanceAnimation.axisZ.data(),
+        m_instanceAnimation.offsetX.data(), m_instanceAnimation.offsetY.data(), m_instanceAnimation.offsetZ.data()};
+
+    // The kernels take angles in radians, wrap them to a single turn in double
+    // precision so the polynomial range reduction stays accurate over time.
+    auto rowAngle = [this](int32_t x)
     {
-        m_instanceData = std::make_unique<InstanceData[]>(g_numInstances);
+        return static_cast<float>(std::fmod((m_currentTime + (double)x) * 90.0, 360.0) * (DirectX::XM_PI / 180.0));
+    };
+
+    // Only the animated rows change from frame to frame, every other instance
+    // keeps what was uploaded to the instance buffer before.
+    size_t numAnimatedRows = static_cast<size_t>(std::lround(m_animatedInstanceFraction * static_cast<float>(m_instanceGrid.numRows)));
+    if (m_instanceBufferValid)
+    {
+        m_dirtyInstances.MarkDirty(0, numAnimatedRows * m_instanceGrid.numColumns);
     }
-    auto testData = std::make_unique<unsigned char[]>(16000);
-    for (int32_t x = 0; x < (int32_t)g_numRows; x++)
+    else
+    {
+        m_dirtyInstances.MarkAllDirty();
+        m_instanceBufferValid = true;
+    }
+
+    JobSystem &jobSystem = Engine::Get().GetJobSystem();
+
+    if (m_useTransformHierarchy)
     {
-        for (int32_t y = 0; y < (int32_t)g_numColumns; y++)
+        // Same axis and angle as the flat path, the instances of a row share them.
+        const float axisComponent = 1.0f / std::sqrt(2.0f);
+        for (int32_t x = 0; x < (int32_t)numAnimatedRows; x++)
         {
-            float angle = static_cast<float>((m_currentTime + (double)x) * 90.0);
-            const DirectX::XMVECTOR rotationAxis = DirectX::XMVectorSet(0, 1, 1, 0);
-            m_instanceData[x * g_numColumns + y].model = DirectX::XMMatrixScaling(g_cubeSize, g_cubeSize, g_cubeSize) * DirectX::XMMatrixRotationAxis(rotationAxis, DirectX::XMConvertToRadians(angle)) * DirectX::XMMatrixTranslation((float)(x - (int32_t)g_numRows / 2) * g_xStride, (float)(y - (int32_t)g_numColumns / 2) * g_yStride, 0);
+            float halfAngle = rowAngle(x) * 0.5f;
+            float sinHalfAngle = std::sin(halfAngle) * axisComponent;
+            float rotation[4] = {0.0f, sinHalfAngle, sinHalfAngle, std::cos(halfAngle)};
+            size_t rowBegin = m_instanceGrid.numRows + static_cast<size_t>(x) * m_instanceGrid.numColumns;
+            for (size_t node = rowBegin; node < rowBegin + m_instanceGrid.numColumns; node++)
+            {
+                m_instanceHierarchy.SetLocalRotation(static_cast<TransformHierarchy::NodeIndex>(node), rotation);
+            }
         }
+        m_numHierarchyNodesUpdated = m_instanceHierarchy.Update(jobSystem);
+    }
+
+    // The dirty list is only needed while this frame is built.
+    FrameVector<uint32_t> dirtyInstanceIndices{FrameArenaAllocator<uint32_t>(*m_frameArenas[m_currentFrameIndex])};
+    dirtyInstanceIndices.reserve(m_numInstances);
+    m_dirtyInstances.Collect(dirtyInstanceIndices);
+
+    // Updates are packed in dirty index order. When every instance is dirty
+    // that is the instance buffer layout already, and the indices are not needed.
+    m_numInstanceUpdates = dirtyInstanceIndices.size();
+    m_fullInstanceUpload = m_numInstanceUpdates == m_numInstances;
+    m_instanceUploadBytes = m_numInstanceUpdates * sizeof(InstanceData);
+    if (!m_fullInstanceUpload)
+    {
+        std::memcpy(m_mappedInstanceIndices + m_currentInstanceUploadRegion * m_numInstances, dirtyInstanceIndices.data(), m_numInstanceUpdates * sizeof(uint32_t));
+        m_instanceUploadBytes += m_numInstanceUpdates * sizeof(uint32_t);
     }
+
+    const uint32_t *dirtyIndices = dirtyInstanceIndices.data();
+
+    // Every chunk covers whole cache lines, so no two threads ever write to the same line.
+    jobSystem.ParallelFor(0, m_numInstanceUpdates, jobSystem.ComputeGrainSize(m_numInstanceUpdates, sizeof(InstanceData)), [&](size_t begin, size_t end)
+                          {
+        if (m_useTransformHierarchy)
+        {
+            // The world transforms are up to date, only gather them.
+            for (size_t update = begin; update < end; update++)
+            {
+                TransformHierarchy::NodeIndex node = static_cast<TransformHierarchy::NodeIndex>(m_instanceGrid.numRows + dirtyIndices[update]);
+#if DX12_COMPACT_INSTANCES
+                TransformHierarchy::Transform world = m_instanceHierarchy.GetWorldTransform(node);
+                InstanceTransforms::StoreTransform(InstanceTransforms::EncodeCompact(world.position, world.rotation, world.scale), transforms + update, InstanceTransforms::StoreMode::Streaming);
+#else
+                InstanceTransforms::StoreTransform(m_instanceHierarchy.GetWorldMatrix(node), transforms + update, InstanceTransforms::StoreMode::Streaming);
+#endif
+            }
+            InstanceTransforms::FlushStreamingStores();
+            return;
+        }
+
+        if (m_instanceTransformKernel.has_value())
+        {
+            // Compose each run of consecutive dirty instances with a single call.
+            size_t runBegin = begin;
+            while (runBegin < end)
+            {
+                size_t runEnd = runBegin + 1;
+                while (runEnd < end && dirtyIndices[runEnd] == dirtyIndices[runEnd - 1] + 1)
+                {
+                    runEnd++;
+                }
+
+                size_t first = dirtyIndices[runBegin];
+                size_t count = runEnd - runBegin;
+
+                int32_t row = -1;
+                float angle = 0.0f;
+                for (size_t i = first; i < first + count; i++)
+                {
+                    int32_t x = static_cast<int32_t>(i / m_instanceGrid.numColumns);
+                    if (x != row)
+                    {
+                        row = x;
+                        angle = rowAngle(x);
+                    }
+                    m_instanceAnimation.angle[i] = angle;
+                }
+
+                InstanceTransforms::Compose(*m_instanceTransformKernel, OffsetInstances(instances, first), 0, count, transforms + runBegin, InstanceTransforms::StoreMode::Streaming);
+                runBegin = runEnd;
+            }
+            return;
+        }
+
+        for (size_t update = begin; update < end; update++)
+        {
+            size_t i = dirtyIndices[update];
+            int32_t x = static_cast<int32_t>(i / m_instanceGrid.numColumns);
+            int32_t y = static_cast<int32_t>(i % m_instanceGrid.numColumns);
+            float angle = static_cast<float>((m_currentTime + (double)x) * 90.0);
+#if DX12_COMPACT_INSTANCES
+            DirectX::XMFLOAT4 rotation;
+            DirectX::XMStoreFloat4(&rotation, DirectX::XMQuaternionRotationAxis(rotationAxis, DirectX::XMConvertToRadians(angle)));
+            float position[3] = {(float)(x - (int32_t)m_instanceGrid.numRows / 2) * m_instanceGrid.xStride, (float)(y - (int32_t)m_instanceGrid.numColumns / 2) * m_instanceGrid.yStride, 0};
+
+            InstanceTransforms::StoreTransform(InstanceTransforms::EncodeCompact(position, &rotation.x, m_instanceGrid.cubeSize), transforms + update, InstanceTransforms::StoreMode::Streaming);
+#else
+            DirectX::XMMATRIX model = scaleMatrix * DirectX::XMMatrixRotationAxis(rotationAxis, DirectX::XMConvertToRadians(angle)) * DirectX::XMMatrixTranslation((float)(x - (int32_t)m_instanceGrid.numRows / 2) * m_instanceGrid.xStride, (float)(y - (int32_t)m_instanceGrid.numColumns / 2) * m_instanceGrid.yStride, 0);
+
+            InstanceTransforms::Float4x4 transform;
+            DirectX::XMStoreFloat4x4(reinterpret_cast<DirectX::XMFLOAT4X4 *>(&transform), model);
+            InstanceTransforms::StoreTransform(transform, transforms + update, InstanceTransforms::StoreMode::Streaming);
+#endif
+        }
+        InstanceTransforms::FlushStreamingStores(); });
+
+    updateClock.Update();
+    double updateMs = updateClock.GetCurrentTime() * 1000.0;
+    m_lastInstanceUpdateMs = updateMs;
+    m_instanceUpdateMs += (updateMs - m_instanceUpdateMs) * g_timingSmoothing;
+
+    size_t threadCountIndex = std::min<size_t>(jobSystem.GetNumThreads(), m_instanceUpdateMsPerThreadCount.size()) - 1;
+    double &threadCountMs = m_instanceUpdateMsPerThreadCount[threadCountIndex];
+    threadCountMs = threadCountMs == 0.0 ? updateMs : threadCountMs + (updateMs - threadCountMs) * g_timingSmoothing;
+}
+
+void Game::DispatchInstanceCompute()
+{
+    auto directCommandQueue = Engine::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+    auto computeCommandQueue = Engine::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COMPUTE);
+    auto commandList = computeCommandQueue->GetCommandList();
+
+    // x * 90 degrees is added per row on the GPU, only the time dependent part
+    // is wrapped here in double precision.
+    DispatchSize dispatchSize = GetDispatchSize(m_numInstances, g_instanceComputeGroupSize);
+    InstanceComputeConstants constants = {
+        .numRows = static_cast<uint32_t>(m_instanceGrid.numRows),
+        .numColumns = static_cast<uint32_t>(m_instanceGrid.numColumns),
+        .xStride = m_instanceGrid.xStride,
+        .yStride = m_instanceGrid.yStride,
+        .cubeSize = m_instanceGrid.cubeSize,
+        .anglePhase = static_cast<float>(std::fmod(m_currentTime * 90.0, 360.0)),
+        .threadsPerRow = dispatchSize.threadsPerRow};
+
+    commandList->SetPipelineState(m_instanceComputePipelineState.Get());
+    commandList->SetComputeRootSignature(m_instanceComputeRootSignature.Get());
+    commandList->SetComputeRoot32BitConstants(0, sizeof(InstanceComputeConstants) / 4, &constants, 0);
+    commandList->SetComputeRootUnorderedAccessView(1, m_instanceBuffer->GetGPUVirtualAddress());
+
+    // The CPU path has to upload every instance again once it takes over.
+    m_instanceBufferValid = false;
+
+    // Buffers are implicitly promoted from COMMON on first use and decay back
+    // once the command list completes, so no barriers are needed across queues.
+    commandList->Dispatch(dispatchSize.numGroupsX, dispatchSize.numGroupsY, 1);
+
+    // Residency follows the direct queue, which waits for this pass.
+    Engine::Get().GetGpuMemoryAllocator().MarkResourceUsed(m_instanceBuffer.Get());
+
+    // The previous frame has to be done drawing from the instance buffer
+    // before the compute pass overwrites it.
+    const CommandQueue::Dependency dependencies[] = {{directCommandQueue.get(), m_lastRenderFenceValue}};
+    m_instanceComputeFenceValue = computeCommandQueue->ExecuteCommandList(commandList, dependencies);
 }
 
 void Game::UpdateInstanceBuffer(ComPtr<ID3D12GraphicsCommandList2> commandList)
 {
-    void *mappedData;
-    D3D12_RANGE readRange = {0, 0}; // We won't read from this resource on the CPU
-    m_instanceUploadBuffer->Map(0, &readRange, &mappedData);
-    memcpy(mappedData, m_instanceData.get(), g_numInstances * sizeof(InstanceData));
-    m_instanceUploadBuffer->Unmap(0, nullptr);
+    if (m_numInstanceUpdates == 0)
+    {
+        return;
+    }
+
+    ResourceStateTracker &resourceStateTracker = Engine::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT)->GetResourceStateTracker(commandList);
+
+    UINT64 regionSize = m_numInstances * sizeof(InstanceData);
+    UINT64 regionOffset = m_currentInstanceUploadRegion * regionSize;
+
+    if (m_fullInstanceUpload)
+    {
+        resourceStateTracker.TransitionResource(m_instanceBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST);
+        resourceStateTracker.FlushResourceBarriers(commandList.Get());
+        commandList->CopyBufferRegion(m_instanceBuffer.Get(), 0, m_instanceUploadBuffer.Get(), regionOffset, regionSize);
+        return;
+    }
+
+    // Scatter the packed updates straight from the upload buffers.
+    DispatchSize dispatchSize = GetDispatchSize(m_numInstanceUpdates, g_instanceScatterGroupSize);
+    InstanceScatterConstants constants = {static_cast<uint32_t>(m_numInstanceUpdates), dispatchSize.threadsPerRow};
+    UINT64 indexRegionOffset = m_currentInstanceUploadRegion * m_numInstances * sizeof(uint32_t);
+
+    resourceStateTracker.TransitionResource(m_instanceBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    resourceStateTracker.FlushResourceBarriers(commandList.Get());
+
+    commandList->SetPipelineState(m_instanceScatterPipelineState.Get());
+    commandList->SetComputeRootSignature(m_instanceScatterRootSignature.Get());
+    commandList->SetComputeRoot32BitConstants(0, sizeof(InstanceScatterConstants) / 4, &constants, 0);
+    commandList->SetComputeRootShaderResourceView(1, m_instanceUploadBuffer->GetGPUVirtualAddress() + regionOffset);
+    commandList->SetComputeRootShaderResourceView(2, m_instanceIndexUploadBuffer->GetGPUVirtualAddress() + indexRegionOffset);
+    commandList->SetComputeRootUnorderedAccessView(3, m_instanceBuffer->GetGPUVirtualAddress());
+    commandList->Dispatch(dispatchSize.numGroupsX, dispatchSize.numGroupsY, 1);
+}
+
+void Game::MarkResourcesUsed()
+{
+    GpuMemoryAllocator &gpuMemoryAllocator = Engine::Get().GetGpuMemoryAllocator();
+    for (ID3D12Resource *resource : {m_vertexBuffer.Get(), m_indexBuffer.Get(), m_instanceBuffer.Get(), m_instanceUploadBuffer.Get(), m_instanceIndexUploadBuffer.Get(), m_depthBuffer.Get()})
+    {
+        gpuMemoryAllocator.MarkResourceUsed(resource);
+    }
+}
+
+void Game::OnVideoMemoryBudgetChanged(const ResidencyManager::Budget &budget)
+{
+    m_numVideoMemoryBudgetChanges++;
 
-    DXHelpers::TransitionResource(commandList, m_instanceBuffer, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, D3D12_RESOURCE_STATE_COPY_DEST);
-    commandList->CopyBufferRegion(m_instanceBuffer.Get(), 0, m_instanceUploadBuffer.Get(), 0, g_numInstances * sizeof(InstanceData));
-    DXHelpers::TransitionResource(commandList, m_instanceBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+    char str[128];
+    sprintf_s(str, "Video memory budget: %.1f MB, %.1f MB in use\n", static_cast<double>(budget.budget) / 1e6, static_cast<double>(budget.currentUsage) / 1e6);
+    OutputDebugString(str);
 }
 
 void Game::InitImGui()
 {
 }
+
+void Game::DrawStatsPanel()
+{
+    JobSystem &jobSystem = Engine::Get().GetJobSystem();
+
+    ImGui::Text("Grid: %zu x %zu, %zu instances", m_instanceGrid.numRows, m_instanceGrid.numColumns, m_numInstances);
+    if (m_scalingBenchmark.has_value())
+    {
+        ImGui::Text("Sweep: step %zu, %zu instances", m_scalingBenchmark->GetResults().size() + 1, m_scalingBenchmark->GetTargetInstanceCount());
+    }
+
+    ImGui::Checkbox("GPU instance transforms", &m_useGpuInstanceTransforms);
+    bool previousUseTransformHierarchy = m_useTransformHierarchy;
+    ImGui::Checkbox("Transform hierarchy", &m_useTransformHierarchy);
+    if (m_useTransformHierarchy != previousUseTransformHierarchy)
+    {
+        // Switching changes the rotation axis of every row.
+        m_instanceBufferValid = false;
+    }
+
+    int numThreads = static_cast<int>(jobSystem.GetNumThreads());
+    if (ImGui::SliderInt("Job threads", &numThreads, 1, static_cast<int>(m_instanceUpdateMsPerThreadCount.size())))
+    {
+        jobSystem.SetNumThreads(static_cast<uint32_t>(numThreads));
+    }
+
+    std::optional<InstanceTransforms::Kernel> previousKernel = m_instanceTransformKernel;
+    const char *kernelName = m_instanceTransformKernel.has_value() ? InstanceTransforms::GetKernelName(*m_instanceTransformKernel) : "DirectXMath";
+    if (ImGui::BeginCombo("Transform kernel", kernelName))
+    {
+        if (ImGui::Selectable("DirectXMath", !m_instanceTransformKernel.has_value()))
+        {
+            m_instanceTransformKernel.reset();
+        }
+        for (InstanceTransforms::Kernel kernel : {InstanceTransforms::Kernel::Reference, InstanceTransforms::Kernel::Scalar, InstanceTransforms::Kernel::SSE, InstanceTransforms::Kernel::AVX2})
+        {
+            if (InstanceTransforms::IsKernelSupported(kernel) && ImGui::Selectable(InstanceTransforms::GetKernelName(kernel), m_instanceTransformKernel == kernel))
+            {
+                m_instanceTransformKernel = kernel;
+            }
+        }
+        ImGui::EndCombo();
+    }
+
+    float previousAnimatedFraction = m_animatedInstanceFraction;
+    ImGui::SliderFloat("Animated instances", &m_animatedInstanceFraction, 0.0f, 1.0f, "%.2f");
+
+    // The per thread count timings only compare runs of the same workload.
+    if (m_instanceTransformKernel != previousKernel || m_animatedInstanceFraction != previousAnimatedFraction || m_useTransformHierarchy != previousUseTransformHierarchy)
+    {
+        std::fill(m_instanceUpdateMsPerThreadCount.begin(), m_instanceUpdateMsPerThreadCount.end(), 0.0);
+    }
+
+#if DX12_COMPACT_INSTANCES
+    ImGui::Text("Instance layout: compact, %zu bytes", sizeof(InstanceData));
+#else
+    ImGui::Text("Instance layout: matrix, %zu bytes", sizeof(InstanceData));
+#endif
+    ImGui::Text("Instance update: %.3f ms/frame", m_instanceUpdateMs);
+    if (m_useTransformHierarchy && !m_useGpuInstanceTransforms)
+    {
+        ImGui::Text("Hierarchy: %zu levels, %zu of %zu nodes updated", m_instanceHierarchy.GetNumLevels(), m_numHierarchyNodesUpdated, m_instanceHierarchy.GetNumNodes());
+    }
+    ImGui::Text("Instance upload (GPU): %.3f ms/frame", m_instanceUploadGpuMs);
+    if (!m_useGpuInstanceTransforms)
+    {
+        // Only the dirty instances are written, straight into the mapped upload buffers.
+        ImGui::Text("Uploaded: %.1f KB/frame, %zu of %zu instances", static_cast<double>(m_instanceUploadBytes) / 1e3, m_numInstanceUpdates, m_numInstances);
+        if (m_instanceUpdateMs > 0.0)
+        {
+            ImGui::Text("Upload writes: %.2f GB/s", static_cast<double>(m_instanceUploadBytes) / (m_instanceUpdateMs * 1e6));
+        }
+    }
+    for (size_t i = 0; i < m_instanceUpdateMsPerThreadCount.size(); i++)
+    {
+        if (m_instanceUpdateMsPerThreadCount[i] > 0.0)
+        {
+            ImGui::Text("  %zu threads: %.3f ms/frame", i + 1, m_instanceUpdateMsPerThreadCount[i]);
+        }
+    }
+
+    int numSceneDraws = static_cast<int>(m_numSceneDraws);
+    if (ImGui::SliderInt("Scene draws", &numSceneDraws, 1, 16384, "%d", ImGuiSliderFlags_Logarithmic))
+    {
+        m_numSceneDraws = static_cast<size_t>(numSceneDraws);
+        std::fill(m_recordingMsPerThreadCount.begin(), m_recordingMsPerThreadCount.end(), 0.0);
+        m_recordingMsWithoutBundles = 0.0;
+        m_recordingMsWithBundles = 0.0;
+        m_bundleCache->Invalidate();
+    }
+    if (ImGui::Checkbox("Scene bundles", &m_useSceneBundles))
+    {
+        std::fill(m_recordingMsPerThreadCount.begin(), m_recordingMsPerThreadCount.end(), 0.0);
+    }
+    const CommandQueue &directCommandQueue = *Engine::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+    ImGui::Text("Recording: %.3f ms/frame, %.0f draws/ms, %zu command lists created",
+                m_recordingMs, m_recordingMs > 0.0 ? static_cast<double>(m_numSceneDraws) / m_recordingMs : 0.0, directCommandQueue.GetNumCommandLists());
+    for (size_t i = 0; i < m_recordingMsPerThreadCount.size(); i++)
+    {
+        if (m_recordingMsPerThreadCount[i] > 0.0)
+        {
+            ImGui::Text("  %zu threads: %.3f ms/frame, %.0f draws/ms", i + 1, m_recordingMsPerThreadCount[i], static_cast<double>(m_numSceneDraws) / m_recordingMsPerThreadCount[i]);
+        }
+    }
+    ImGui::Text("Recording without bundles: %.3f ms/frame, with bundles: %.3f ms/frame", m_recordingMsWithoutBundles, m_recordingMsWithBundles);
+    ImGui::Text("Bundles: %zu cached, %llu recorded, %llu replayed, %zu invalidations",
+                m_bundleCache->GetNumBundles(), m_bundleCache->GetNumRecords(), m_bundleCache->GetNumHits(), m_bundleCache->GetNumInvalidations());
+    size_t commandStreamBytes = 0;
+    for (const std::unique_ptr<RenderCommandStream> &commandStream : m_sceneCommandStreams)
+    {
+        commandStreamBytes += commandStream->GetSize();
+    }
+    ImGui::Text("Render commands: %.1f KB recorded, %llu draws, %llu state changes, %llu redundant states dropped",
+                static_cast<double>(commandStreamBytes) / 1e3, m_renderCommandTranslator->GetNumDraws(), m_renderCommandTranslator->GetNumStateChanges(), m_renderCommandTranslator->GetNumRedundantStates());
+
+    CommandQueue &frameCommandQueue = *Engine::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+    const FenceWaiter &fenceWaiter = frameCommandQueue.GetFenceWaiter();
+    FenceWaiter::Policy waitPolicy = fenceWaiter.GetPolicy();
+    if (ImGui::BeginCombo("Frame wait policy", FenceWaiter::GetPolicyName(waitPolicy)))
+    {
+        for (size_t i = 0; i < static_cast<size_t>(FenceWaiter::Policy::Count); i++)
+        {
+            FenceWaiter::Policy policy = static_cast<FenceWaiter::Policy>(i);
+            if (ImGui::Selectable(FenceWaiter::GetPolicyName(policy), policy == waitPolicy))
+            {
+                frameCommandQueue.SetWaitPolicy(policy);
+            }
+        }
+        ImGui::EndCombo();
+    }
+    FenceWaiter::Stats waitStats = fenceWaiter.GetStats();
+    ImGui::Text("Fence waits: %llu, %llu blocking, %.3f ms predicted, %.3f ms prediction error, %.1f ms total",
+                waitStats.numWaits, waitStats.numBlockingWaits, waitStats.predictedMs, waitStats.predictionErrorMs, waitStats.totalWaitMs);
+    fenceWaiter.GetSamples(m_waitSamples);
+    m_waitSampleMs.resize(m_waitSamples.size());
+    std::transform(m_waitSamples.begin(), m_waitSamples.end(), m_waitSampleMs.begin(), [](const FenceWaiter::Sample &sample)
+                   { return static_cast<float>(sample.actualMs); });
+    ImGui::PlotLines("Fence wait ms", m_waitSampleMs.data(), static_cast<int>(m_waitSampleMs.size()));
+
+    const std::pair<const char *, D3D12_COMMAND_LIST_TYPE> commandListTypes[] = {
+        {"Direct", D3D12_COMMAND_LIST_TYPE_DIRECT},
+        {"Compute", D3D12_COMMAND_LIST_TYPE_COMPUTE},
+        {"Copy", D3D12_COMMAND_LIST_TYPE_COPY}};
+    for (const auto &[name, type] : commandListTypes)
+    {
+        const CommandQueue &queue = *Engine::Get().GetCommandQueue(type);
+        CommandQueue::AllocatorStats allocatorStats = queue.GetAllocatorStats();
+        ImGui::Text("%s allocators: %zu created, %llu reused, %llu waits",
+                    name, allocatorStats.numCreated, allocatorStats.numReused, allocatorStats.numWaits);
+        ImGui::Text("%s allocators: %zu peak per thread, %zu lists in flight, %zu peak",
+                    name, allocatorStats.maxPerThread, allocatorStats.numInFlight, allocatorStats.maxInFlight);
+        ImGui::Text("%s queue: %llu GPU waits on other queues, %llu unnecessary ones skipped", name, queue.GetNumGpuWaits(), queue.GetNumSkippedGpuWaits());
+    }
+
+    const FrameArena &frameArena = *m_frameArenas[m_currentFrameIndex];
+    ImGui::Text("Frame arena: %.1f KB used, %.1f KB peak of %.1f KB, %zu overflows",
+                static_cast<double>(frameArena.GetUsedBytes()) / 1e3, static_cast<double>(frameArena.GetHighWaterMark()) / 1e3,
+                static_cast<double>(frameArena.GetCapacity()) / 1e3, frameArena.GetNumOverflows());
+    ImGui::Text("Heap allocations: %llu/frame", m_heapAllocationsPerFrame);
+    ImGui::Text("Resource barriers: %llu in %llu calls/frame", m_barriersPerFrame, m_barrierCallsPerFrame);
+    ImGui::Text("Direct queue: %llu command lists in %llu submissions/frame", m_executedCommandListsPerFrame, m_submissionsPerFrame);
+
+    GpuMemoryAllocator::Stats gpuMemoryStats = Engine::Get().GetGpuMemoryAllocator().GetStats();
+    ImGui::Text("GPU heaps: %zu, %.1f MB used of %.1f MB, %zu resources, %zu free blocks, %.0f%% fragmented",
+                gpuMemoryStats.numHeaps, static_cast<double>(gpuMemoryStats.usedBytes) / 1e6, static_cast<double>(gpuMemoryStats.reservedBytes) / 1e6,
+                gpuMemoryStats.numAllocations, gpuMemoryStats.numFreeBlocks, gpuMemoryStats.fragmentation * 100.0);
+
+    const ResidencyManager &residencyManager = Engine::Get().GetResidencyManager();
+    const ResidencyManager::Budget &videoMemoryBudget = residencyManager.GetBudget();
+    ImGui::Text("Video memory: %.1f MB used of %.1f MB budget, %zu budget changes",
+                static_cast<double>(videoMemoryBudget.currentUsage) / 1e6, static_cast<double>(videoMemoryBudget.budget) / 1e6, m_numVideoMemoryBudgetChanges);
+    ImGui::Text("Residency: %.1f MB resident, %.1f MB evicted, %zu evictions, %zu made resident",
+                static_cast<double>(residencyManager.GetResidencySet().GetResidentBytes()) / 1e6, static_cast<double>(residencyManager.GetResidencySet().GetEvictedBytes()) / 1e6,
+                residencyManager.GetNumEvictions(), residencyManager.GetNumMakeResidents());
+
+    const ReadbackService &readbackService = Engine::Get().GetReadbackService();
+    ImGui::Text("Readbacks: %zu pending, %zu buffers, %zu buffer reuses", readbackService.GetNumPending(), readbackService.GetNumBuffers(), readbackService.GetNumBufferReuses());
+
+    const DeferredReleaseQueue &deferredReleaseQueue = Engine::Get().GetDeferredReleaseQueue();
+    ImGui::Text("Deferred releases: %zu pending, %zu released", deferredReleaseQueue.GetNumPending(), deferredReleaseQueue.GetNumReleased());
+
+    const FenceScheduler &fenceScheduler = Engine::Get().GetFenceScheduler();
+    ImGui::Text("Fence tasks: %zu running, %zu waiting, %zu resumed", fenceScheduler.GetNumTasks(), fenceScheduler.GetNumWaiting(), fenceScheduler.GetNumResumed());
+    if (m_geometryUploadSeconds)
+    {
+        ImGui::Text("Geometry upload: seen complete after %.1f ms", *m_geometryUploadSeconds * 1000.0);
+    }
+
+    const UploadManager &uploadManager = Engine::Get().GetUploadManager();
+    ImGui::Text("Uploads: %zu in %zu batches, %zu CPU stalls avoided, %zu CPU stalls",
+                uploadManager.GetNumUploads(), uploadManager.GetNumBatches(), uploadManager.GetNumAvoidedCpuStalls(), uploadManager.GetNumCpuStalls());
+
+    const UploadRing &uploadRing = Engine::Get().GetUploadRing();
+    ImGui::Text("Upload ring: %.1f KB used, %.1f KB peak of %.1f KB, %zu growths",
+                static_cast<double>(uploadRing.GetUsedBytes()) / 1e3, static_cast<double>(uploadRing.GetPeakUsedBytes()) / 1e3,
+                static_cast<double>(uploadRing.GetCapacity()) / 1e3, uploadRing.GetNumGrowths());
+}
@@ -1,9 +1,21 @@
 #pragma once
 
 #include "Interfaces/EngineEventHandlers.h"
+#include "BundleCache.h"
+#include "DirtyIndexTracker.h"
 #include "Engine.h"
 #include "Events.h"
+#include "FrameArena.h"
 #include "ImGui/ImGuiRenderer.h"
+#include "InstanceLayout.h"
+#include "ReadbackService.h"
+#include "RenderCommandStream.h"
+#include "RenderCommandTranslator.h"
+#include "Math/InstanceTransforms.h"
+#include "ResidencyManager.h"
+#include "ScalingBenchmark.h"
+#include "TransformHierarchy.h"
+#include "UploadManager.h"
 #include <DirectXMath.h>
 
 #include <optional>
@@ -32,11 +44,29 @@ protected:
     void ResizeDepthBuffer(uint32_t width, uint32_t height);
 
 private:
+    void ReadSettings();
+    void ResizeInstanceGrid(size_t numInstances);
+    void UpdateScalingBenchmark(double deltaTime);
+
     void CreateInstanceBuffer();
+    void CreateTimestampQueries();
+    void ReadInstanceUploadTimestamps(const ReadbackService::View &view);
+    void CreateInstanceComputePipeline();
+    void CreateInstanceScatterPipeline();
+    void InitInstanceAnimation();
+    void InitInstanceHierarchy();
+    void DispatchInstanceCompute();
     void UpdateInstanceData();
     void UpdateInstanceBuffer(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList);
+    void MarkResourcesUsed();
+    void RecordSceneDraws(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList, ID3D12Resource *backBuffer, D3D12_CPU_DESCRIPTOR_HANDLE rtv, D3D12_CPU_DESCRIPTOR_HANDLE dsv, RenderCommandStream &commandStream, size_t firstDraw, size_t endDraw, bool useBundle);
+    void RecordSceneDrawSequence(ID3D12GraphicsCommandList2 *commandList, ResourceStateTracker *resourceStateTracker, RenderCommandStream &commandStream, size_t firstDraw, size_t endDraw);
+    void UpdateRecordingTimes(double recordingMs, bool usedSceneBundles);
+    void OnVideoMemoryBudgetChanged(const ResidencyManager::Budget &budget);
+    FenceScheduler::Task TrackGeometryUpload(UploadManager::Ticket ticket);
 
     void InitImGui();
+    void DrawStatsPanel();
 
     std::shared_ptr<Window> m_window;
 
@@ -45,12 +75,23 @@ private:
 
     std::vector<uint64_t> m_fenceValues;
 
+    // Copies of the vertex and index buffers, the first frame waits for them on the GPU.
+    UploadManager::Ticket m_geometryUploadTicket;
+    // Time from startup until the CPU saw the copies complete, once they have.
+    std::optional<double> m_geometryUploadSeconds;
+
+    // Transient CPU memory, one arena per back buffer, reset once the fence of
+    // the frame that last used the back buffer has completed.
+    std::vector<std::unique_ptr<FrameArena>> m_frameArenas;
+    uint32_t m_currentFrameIndex = 0;
+
     Microsoft::WRL::ComPtr<ID3D12Resource> m_vertexBuffer;
     D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView;
     Microsoft::WRL::ComPtr<ID3D12Resource> m_indexBuffer;
     D3D12_INDEX_BUFFER_VIEW m_indexBufferView;
     Microsoft::WRL::ComPtr<ID3D12Resource> m_instanceBuffer;
     Microsoft::WRL::ComPtr<ID3D12Resource> m_instanceUploadBuffer;
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_instanceIndexUploadBuffer;
     D3D12_VERTEX_BUFFER_VIEW m_instanceBufferView;
 
     Microsoft::WRL::ComPtr<ID3D12Resource> m_depthBuffer;
@@ -59,6 +100,12 @@ private:
     Microsoft::WRL::ComPtr<ID3D12RootSignature> m_rootSignature;
     Microsoft::WRL::ComPtr<ID3D12PipelineState> m_pipelineState;
 
+    Microsoft::WRL::ComPtr<ID3D12RootSignature> m_instanceComputeRootSignature;
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> m_instanceComputePipelineState;
+
+    Microsoft::WRL::ComPtr<ID3D12RootSignature> m_instanceScatterRootSignature;
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> m_instanceScatterPipelineState;
+
     D3D12_VIEWPORT m_viewport;
     D3D12_RECT m_scissorRect;
 
@@ -67,13 +114,149 @@ private:
     DirectX::XMMATRIX m_viewMatrix;
     DirectX::XMMATRIX m_projectionMatrix;
 
-    struct InstanceData
+    // Layout of the instance grid, set from the command line.
+    struct InstanceGrid
+    {
+        size_t numRows = 300;
+        size_t numColumns = 300;
+        float xStride = 0.05f;
+        float yStride = 0.05f;
+        float cubeSize = 0.01f;
+    };
+    InstanceGrid m_instanceGrid;
+    size_t m_numInstances = 0;
+
+#if DX12_COMPACT_INSTANCES
+    // Quantized position, rotation and scale, the vertex shader rebuilds the matrix.
+    using InstanceData = InstanceTransforms::CompactInstance;
+#else
+    // Instances are updated in parallel, keep each one on its own cache line.
+    struct alignas(JobSystem::s_cacheLineSize) InstanceData
     {
         DirectX::XMMATRIX model;
     };
-    std::unique_ptr<InstanceData[]> m_instanceData;
+#endif
+    // The upload buffer stays mapped, instance updates write straight into it.
+    // It holds one region per back buffer, each one reused once the fence value
+    // of the frame that last copied from it has completed.
+    InstanceData *m_mappedInstanceData = nullptr;
+    uint32_t m_currentInstanceUploadRegion = 0;
+
+    // The instance buffer persists across frames, only the instances marked dirty
+    // are uploaded. Their data is packed in the upload region, followed by their
+    // indices in the index upload buffer, and scattered by a compute pass.
+    DirtyIndexTracker m_dirtyInstances;
+    uint32_t *m_mappedInstanceIndices = nullptr;
+    size_t m_numInstanceUpdates = 0;
+    // Every instance changed, the upload region is copied as a whole instead.
+    bool m_fullInstanceUpload = false;
+    // Cleared when the compute path overwrites the instance buffer.
+    bool m_instanceBufferValid = false;
+
+    // Share of the rows animated every frame, the others stay static.
+    float m_animatedInstanceFraction = 1.0f;
+
+    // Per-instance inputs of the batched transform kernels, in structure-of-arrays layout.
+    struct InstanceAnimation
+    {
+        std::vector<float> scale;
+        std::vector<float> angle;
+        std::vector<float> axisX;
+        std::vector<float> axisY;
+        std::vector<float> axisZ;
+        std::vector<float> offsetX;
+        std::vector<float> offsetY;
+        std::vector<float> offsetZ;
+    };
+    InstanceAnimation m_instanceAnimation;
+
+    // Rows as parent nodes of their instances. Each row spins about its own axis,
+    // so its rotation is computed once and only composed with every instance.
+    TransformHierarchy m_instanceHierarchy;
+    bool m_useTransformHierarchy = false;
+    size_t m_numHierarchyNodesUpdated = 0;
+
+    // Batched kernel computing the instance transforms, DirectXMath is used per instance when empty.
+    std::optional<InstanceTransforms::Kernel> m_instanceTransformKernel;
+
+    // Generate the instance transforms with a compute shader on the compute queue
+    // instead of computing and uploading them on the CPU.
+    bool m_useGpuInstanceTransforms = false;
+    uint64_t m_instanceComputeFenceValue = 0;
+    uint64_t m_lastRenderFenceValue = 0;
 
     double m_currentTime = 0;
 
+    // Time the previous frame's Update blocked waiting for its back buffer.
+    double m_lastFrameWaitMs = 0;
+
+    // Smoothed CPU time of UpdateInstanceData, overall and per job thread count.
+    double m_instanceUpdateMs = 0;
+    double m_lastInstanceUpdateMs = 0;
+    std::vector<double> m_instanceUpdateMsPerThreadCount;
+
+    // GPU time of the instance upload, from a pair of timestamps per back buffer.
+    // The readback service reports them once the frame has completed.
+    Microsoft::WRL::ComPtr<ID3D12QueryHeap> m_timestampQueryHeap;
+    uint64_t m_timestampFrequency = 0;
+    double m_instanceUploadGpuMs = 0;
+    double m_lastInstanceUploadGpuMs = 0;
+
+    // Sweep over instance counts, enabled with -sweep.
+    std::optional<ScalingBenchmark> m_scalingBenchmark;
+    std::wstring m_scalingBenchmarkOutput;
+
+    // Bytes written to the upload buffers by the last instance update.
+    size_t m_instanceUploadBytes = 0;
+
+    // Global heap allocations made during the last frame.
+    uint64_t m_frameStartHeapAllocations = 0;
+    uint64_t m_heapAllocationsPerFrame = 0;
+
+    // Resource barriers issued and ResourceBarrier calls made during the last frame.
+    uint64_t m_frameStartBarriers = 0;
+    uint64_t m_frameStartBarrierCalls = 0;
+    uint64_t m_barriersPerFrame = 0;
+    uint64_t m_barrierCallsPerFrame = 0;
+
+    // Command lists executed on the direct queue during the last frame, and the
+    // ExecuteCommandLists calls they took.
+    uint64_t m_frameStartExecutedCommandLists = 0;
+    uint64_t m_frameStartSubmissions = 0;
+    uint64_t m_executedCommandListsPerFrame = 0;
+    uint64_t m_submissionsPerFrame = 0;
+
+    // The frame's command lists, executed in a single batch: the clear and
+    // instance upload, then the scene draw command lists and the UI command
+    // list, which are recorded in parallel.
+    std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>> m_frameCommandLists;
+    // The instances are drawn with this many draw calls, to load the recording threads.
+    size_t m_numSceneDraws = 1;
+    // Smoothed CPU time of the parallel recording, overall and per job thread count.
+    double m_recordingMs = 0;
+    std::vector<double> m_recordingMsPerThreadCount;
+    // The same, with and without the scene draw sequences replayed from bundles.
+    double m_recordingMsWithoutBundles = 0;
+    double m_recordingMsWithBundles = 0;
+
+    // The scene draw sequences of each scene command list, recorded once into bundles.
+    std::unique_ptr<BundleCache> m_bundleCache;
+    bool m_useSceneBundles = true;
+    // Scene command lists the cached bundles were recorded for.
+    size_t m_numSceneBundleCommandLists = 0;
+
+    // The scene draw sequences are recorded as render commands, one stream per
+    // scene command list, sorted and then translated into D3D12 calls.
+    std::unique_ptr<RenderCommandTranslator> m_renderCommandTranslator;
+    RenderCommandStream::PipelineHandle m_scenePipeline = RenderCommandStream::s_none;
+    std::vector<std::unique_ptr<RenderCommandStream>> m_sceneCommandStreams;
+
+    // Recent waits of the direct queue, kept to plot them without allocating.
+    std::vector<FenceWaiter::Sample> m_waitSamples;
+    std::vector<float> m_waitSampleMs;
+
+    // Times the OS changed the local video memory budget.
+    size_t m_numVideoMemoryBudgetChanges = 0;
+
     std::optional<ImGuiRenderer> m_imGuiRenderer;
 };
\ No newline at end of file
@@ -0,0 +1,214 @@
+#include "GpuMemoryAllocator.h"
+
+#include "ResidencyManager.h"
+#include "ResourceStateTracker.h"
+
+#pragma warning(push)
+#pragma warning(disable : 4365)
+#pragma warning(disable : 4626)
+#include "directx/d3dx12.h"
+#pragma warning(pop)
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+    constexpr size_t g_numHeapTypes = 3;
+
+    size_t GetHeapTypeIndex(D3D12_HEAP_TYPE heapType)
+    {
+        switch (heapType)
+        {
+        case D3D12_HEAP_TYPE_DEFAULT:
+            return 0;
+        case D3D12_HEAP_TYPE_UPLOAD:
+            return 1;
+        case D3D12_HEAP_TYPE_READBACK:
+            return 2;
+        default:
+            assert(false && "Unsupported heap type.");
+        }
+        return 0;
+    }
+
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+GpuMemoryAllocator::GpuMemoryAllocator(Microsoft::WRL::ComPtr<ID3D12Device2> device, ResidencyManager &residencyManager, uint64_t heapSize)
+    : m_device(device), m_residencyManager(residencyManager), m_heapSize(heapSize)
+{
+    D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+    assert(SUCCEEDED(m_device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options))));
+    m_separateResourceCategories = options.ResourceHeapTier == D3D12_RESOURCE_HEAP_TIER_1;
+
+    m_pools.resize(g_numHeapTypes * static_cast<size_t>(ResourceCategory::Count));
+}
+
+size_t GpuMemoryAllocator::GetPoolIndex(D3D12_HEAP_TYPE heapType, ResourceCategory category) const
+{
+    size_t categoryIndex = m_separateResourceCategories ? static_cast<size_t>(category) : 0;
+    return GetHeapTypeIndex(heapType) * static_cast<size_t>(ResourceCategory::Count) + categoryIndex;
+}
+
+GpuMemoryAllocator::Heap &GpuMemoryAllocator::CreateHeap(D3D12_HEAP_TYPE heapType, ResourceCategory category, uint64_t size, uint64_t alignment)
+{
+    D3D12_HEAP_FLAGS flags = D3D12_HEAP_FLAG_ALLOW_ALL_BUFFERS_AND_TEXTURES;
+    if (m_separateResourceCategories)
+    {
+        switch (category)
+        {
+        case ResourceCategory::Buffer:
+            flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+            break;
+        case ResourceCategory::RenderTargetOrDepthTexture:
+            flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+            break;
+        default:
+            flags = D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+            break;
+        }
+    }
+
+    // Heaps holding multi-sampled resources need the larger alignment.
+    alignment = std::max<uint64_t>(alignment, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+    size = AlignUp(size, alignment);
+
+    CD3DX12_HEAP_DESC heapDesc(size, heapType, alignment, flags);
+    Microsoft::WRL::ComPtr<ID3D12Heap> heap;
+    assert(SUCCEEDED(m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&heap))));
+
+    m_residencyManager.Track(heap.Get(), size);
+
+    std::vector<std::unique_ptr<Heap>> &pool = m_pools[GetPoolIndex(heapType, category)];
+    pool.push_back(std::make_unique<Heap>(Heap{heap, alignment, TlsfAllocator(size)}));
+    return *pool.back();
+}
+
+Microsoft::WRL::ComPtr<ID3D12Resource> GpuMemoryAllocator::CreateResource(D3D12_HEAP_TYPE heapType, const D3D12_RESOURCE_DESC &desc, D3D12_RESOURCE_STATES initialState, const D3D12_CLEAR_VALUE *optimizedClearValue)
+{
+    ResourceCategory category = ResourceCategory::Texture;
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+    {
+        category = ResourceCategory::Buffer;
+    }
+    else if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+    {
+        category = ResourceCategory::RenderTargetOrDepthTexture;
+    }
+
+    // Small textures may use 4 KB alignment instead of 64 KB, the device tells
+    // whether this one qualifies.
+    D3D12_RESOURCE_DESC resourceDesc = desc;
+    D3D12_RESOURCE_ALLOCATION_INFO allocationInfo = {};
+    if (category == ResourceCategory::Texture && resourceDesc.SampleDesc.Count == 1)
+    {
+        resourceDesc.Alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+        allocationInfo = m_device->GetResourceAllocationInfo(0, 1, &resourceDesc);
+    }
+    if (allocationInfo.Alignment != D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT)
+    {
+        resourceDesc.Alignment = desc.Alignment;
+        allocationInfo = m_device->GetResourceAllocationInfo(0, 1, &resourceDesc);
+    }
+
+    size_t poolIndex = GetPoolIndex(heapType, category);
+    Heap *heap = nullptr;
+    TlsfAllocator::Allocation allocation = {0, TlsfAllocator::s_invalidHandle};
+    for (std::unique_ptr<Heap> &candidate : m_pools[poolIndex])
+    {
+        if (candidate->alignment >= allocationInfo.Alignment)
+        {
+            allocation = candidate->allocator.Allocate(allocationInfo.SizeInBytes, allocationInfo.Alignment);
+            if (allocation.handle != TlsfAllocator::s_invalidHandle)
+            {
+                heap = candidate.get();
+                break;
+            }
+        }
+    }
+
+    if (!heap)
+    {
+        heap = &CreateHeap(heapType, category, std::max(m_heapSize, allocationInfo.SizeInBytes), allocationInfo.Alignment);
+        allocation = heap->allocator.Allocate(allocationInfo.SizeInBytes, allocationInfo.Alignment);
+        assert(allocation.handle != TlsfAllocator::s_invalidHandle);
+    }
+
+    Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+    assert(SUCCEEDED(m_device->CreatePlacedResource(
+        heap->heap.Get(),
+        allocation.offset,
+        &resourceDesc,
+        initialState,
+        optimizedClearValue,
+        IID_PPV_ARGS(&resource))));
+
+    // An existing heap may have been evicted, and the resource is about to be used.
+    m_residencyManager.MarkUsed(heap->heap.Get());
+
+    m_placements[resource.Get()] = {poolIndex, heap, allocation.handle};
+    ResourceStateTracker::AddGlobalResourceState(resource.Get(), initialState);
+    return resource;
+}
+
+void GpuMemoryAllocator::ReleaseResource(Microsoft::WRL::ComPtr<ID3D12Resource> &resource)
+{
+    if (!resource)
+    {
+        return;
+    }
+
+    auto placement = m_placements.find(resource.Get());
+    assert(placement != m_placements.end());
+    ResourceStateTracker::RemoveGlobalResourceState(resource.Get());
+    resource.Reset();
+
+    Heap *heap = placement->second.heap;
+    heap->allocator.Free(placement->second.handle);
+
+    // Keep one heap per pool around, give the other ones back once they are empty.
+    std::vector<std::unique_ptr<Heap>> &pool = m_pools[placement->second.poolIndex];
+    if (heap->allocator.GetNumAllocations() == 0 && pool.size() > 1)
+    {
+        m_residencyManager.Untrack(heap->heap.Get());
+        std::erase_if(pool, [heap](const std::unique_ptr<Heap> &candidate)
+                      { return candidate.get() == heap; });
+    }
+
+    m_placements.erase(placement);
+}
+
+void GpuMemoryAllocator::MarkResourceUsed(ID3D12Resource *resource)
+{
+    auto placement = m_placements.find(resource);
+    assert(placement != m_placements.end());
+    m_residencyManager.MarkUsed(placement->second.heap->heap.Get());
+}
+
+GpuMemoryAllocator::Stats GpuMemoryAllocator::GetStats() const
+{
+    Stats stats = {};
+    uint64_t largestFreeBlocks = 0;
+    for (const std::vector<std::unique_ptr<Heap>> &pool : m_pools)
+    {
+        for (const std::unique_ptr<Heap> &heap : pool)
+        {
+            uint64_t largestFreeBlock = heap->allocator.GetLargestFreeBlock();
+            stats.numHeaps++;
+            stats.numAllocations += heap->allocator.GetNumAllocations();
+            stats.numFreeBlocks += heap->allocator.GetNumFreeBlocks();
+            stats.reservedBytes += heap->allocator.GetSize();
+            stats.usedBytes += heap->allocator.GetUsedBytes();
+            stats.largestFreeBlock = std::max(stats.largestFreeBlock, largestFreeBlock);
+            largestFreeBlocks += largestFreeBlock;
+        }
+    }
+
+    uint64_t freeBytes = stats.reservedBytes - stats.usedBytes;
+    stats.fragmentation = freeBytes > 0 ? 1.0 - static_cast<double>(largestFreeBlocks) / static_cast<double>(freeBytes) : 0.0;
+    return stats;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "TlsfAllocator.h"
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class ResidencyManager;
+
+// Places resources in large ID3D12Heaps instead of giving each one a committed
+// resource. There is a pool of heaps per heap type, and on resource heap tier 1
+// hardware also per resource category (buffers, render target and depth
+// textures, other textures), since tier 1 heaps cannot mix them. Ranges within
+// a heap are managed by a TlsfAllocator. Heaps are the unit of residency, they
+// are tracked by the ResidencyManager. Not thread-safe.
+class GpuMemoryAllocator
+{
+public:
+    struct Stats
+    {
+        size_t numHeaps;
+        size_t numAllocations;
+        size_t numFreeBlocks;
+        uint64_t reservedBytes;
+        uint64_t usedBytes;
+        uint64_t largestFreeBlock;
+        // Share of the free bytes outside of the largest free block of their heap.
+        double fragmentation;
+    };
+
+    GpuMemoryAllocator(Microsoft::WRL::ComPtr<ID3D12Device2> device, ResidencyManager &residencyManager, uint64_t heapSize);
+
+    GpuMemoryAllocator(const GpuMemoryAllocator &) = delete;
+    GpuMemoryAllocator(GpuMemoryAllocator &&) = delete;
+    GpuMemoryAllocator &operator=(const GpuMemoryAllocator &) = delete;
+    GpuMemoryAllocator &operator=(GpuMemoryAllocator &&) = delete;
+
+    // Same as CreateCommittedResource with default heap flags. Resources larger
+    // than the heap size get a heap of their own. The initial state is registered
+    // with the ResourceStateTracker.
+    Microsoft::WRL::ComPtr<ID3D12Resource> CreateResource(D3D12_HEAP_TYPE heapType, const D3D12_RESOURCE_DESC &desc, D3D12_RESOURCE_STATES initialState, const D3D12_CLEAR_VALUE *optimizedClearValue = nullptr);
+
+    // Release the resource and return its range to the heap. The GPU must be done
+    // with it. Does nothing for a null resource.
+    void ReleaseResource(Microsoft::WRL::ComPtr<ID3D12Resource> &resource);
+
+    // Mark the heap of the resource as used by the next submission on the
+    // residency manager's queue, making it resident again if it was evicted.
+    void MarkResourceUsed(ID3D12Resource *resource);
+
+    Stats GetStats() const;
+
+private:
+    enum class ResourceCategory
+    {
+        Buffer,
+        RenderTargetOrDepthTexture,
+        Texture,
+        Count
+    };
+
+    struct Heap
+    {
+        Microsoft::WRL::ComPtr<ID3D12Heap> heap;
+        uint64_t alignment;
+        TlsfAllocator allocator;
+    };
+
+    struct Placement
+    {
+        size_t poolIndex;
+        Heap *heap;
+        TlsfAllocator::Handle handle;
+    };
+
+    size_t GetPoolIndex(D3D12_HEAP_TYPE heapType, ResourceCategory category) const;
+    Heap &CreateHeap(D3D12_HEAP_TYPE heapType, ResourceCategory category, uint64_t size, uint64_t alignment);
+
+    Microsoft::WRL::ComPtr<ID3D12Device2> m_device;
+    ResidencyManager &m_residencyManager;
+    uint64_t m_heapSize;
+    // Tier 2 heaps hold every kind of resource, tier 1 heaps a single category.
+    bool m_separateResourceCategories;
+
+    // Indexed by GetPoolIndex.
+    std::vector<std::vector<std::unique_ptr<Heap>>> m_pools;
+    std::unordered_map<ID3D12Resource *, Placement> m_placements;
+};
@@ -0,0 +1,56 @@
+#include "GrowingRingAllocator.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+GrowingRingAllocator::GrowingRingAllocator(size_t capacity)
+    : m_allocator(capacity)
+{
+}
+
+GrowingRingAllocator::Allocation GrowingRingAllocator::Allocate(size_t size, size_t alignment)
+{
+    size_t offset = m_allocator.Allocate(size, alignment);
+    bool grew = offset == RingAllocator::s_invalidOffset;
+    if (grew)
+    {
+        // Keep the current ring alive until the work using it completes, the
+        // pending allocations in it are submitted with the next batch.
+        size_t capacity = std::max(2 * m_allocator.GetCapacity(), std::bit_ceil(size + alignment));
+        m_retiredFenceValues.push_back(m_allocator.GetPendingBytes() > 0 ? 0 : m_lastSubmittedFenceValue);
+
+        m_allocator = RingAllocator(capacity);
+        m_numGrowths++;
+
+        offset = m_allocator.Allocate(size, alignment);
+        assert(offset != RingAllocator::s_invalidOffset);
+    }
+
+    m_peakUsedBytes = std::max(m_peakUsedBytes, m_allocator.GetUsedBytes());
+    return {offset, grew};
+}
+
+void GrowingRingAllocator::Submit(uint64_t fenceValue)
+{
+    m_allocator.Submit(fenceValue);
+    m_lastSubmittedFenceValue = fenceValue;
+
+    for (uint64_t &retiredFenceValue : m_retiredFenceValues)
+    {
+        if (retiredFenceValue == 0)
+        {
+            retiredFenceValue = fenceValue;
+        }
+    }
+}
+
+void GrowingRingAllocator::Reclaim(uint64_t completedFenceValue)
+{
+    m_allocator.Reclaim(completedFenceValue);
+
+    // Fence values only grow in retirement order, the freed rings are a prefix.
+    auto firstLive = std::find_if(m_retiredFenceValues.begin(), m_retiredFenceValues.end(), [completedFenceValue](uint64_t fenceValue)
+                                  { return fenceValue == 0 || fenceValue > completedFenceValue; });
+    m_retiredFenceValues.erase(m_retiredFenceValues.begin(), firstLive);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "RingAllocator.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// RingAllocator that moves to a ring twice as large when a request does not
+// fit, instead of failing. The rings left behind are retired: each is freed
+// once the fence value of the last batch allocated from it has completed.
+// Retired rings complete in the order they were retired. Only deals with
+// offsets, UploadRing owns the buffers behind them.
+class GrowingRingAllocator
+{
+public:
+    struct Allocation
+    {
+        size_t offset;
+        // The allocation is in a new ring of GetCapacity() bytes, the previous one was retired.
+        bool grew;
+    };
+
+    explicit GrowingRingAllocator(size_t capacity);
+
+    // Reclaim before allocating, a completed batch may leave enough room.
+    Allocation Allocate(size_t size, size_t alignment);
+
+    // Close the current batch, it and the rings retired while it was recorded
+    // are freed once fenceValue has completed.
+    void Submit(uint64_t fenceValue);
+
+    // Free the batches and retired rings up to completedFenceValue.
+    void Reclaim(uint64_t completedFenceValue);
+
+    size_t GetCapacity() const { return m_allocator.GetCapacity(); }
+    size_t GetUsedBytes() const { return m_allocator.GetUsedBytes(); }
+    size_t GetPeakUsedBytes() const { return m_peakUsedBytes; }
+    size_t GetNumGrowths() const { return m_numGrowths; }
+    // Retired rings not freed yet, the oldest is freed first.
+    size_t GetNumRetiredRings() const { return m_retiredFenceValues.size(); }
+
+private:
+    RingAllocator m_allocator;
+
+    // Fence value freeing each retired ring, oldest first. Zero until the batch
+    // that last used the ring is submitted.
+    std::vector<uint64_t> m_retiredFenceValues;
+    uint64_t m_lastSubmittedFenceValue = 0;
+
+    size_t m_peakUsedBytes = 0;
+    size_t m_numGrowths = 0;
+};
@@ -0,0 +1,89 @@
+#include "HeapStats.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+namespace
+{
+    std::atomic<uint64_t> s_numAllocations = 0;
+
+    void *Allocate(size_t size)
+    {
+        s_numAllocations.fetch_add(1, std::memory_order_relaxed);
+        if (void *memory = std::malloc(size == 0 ? 1 : size))
+        {
+            return memory;
+        }
+        throw std::bad_alloc();
+    }
+
+    void *AllocateAligned(size_t size, std::align_val_t alignment)
+    {
+        s_numAllocations.fetch_add(1, std::memory_order_relaxed);
+#if defined(_MSC_VER)
+        void *memory = _aligned_malloc(size == 0 ? 1 : size, static_cast<size_t>(alignment));
+#else
+        // aligned_alloc wants a multiple of the alignment, and is released with free.
+        size_t alignedSize = (size + static_cast<size_t>(alignment) - 1) & ~(static_cast<size_t>(alignment) - 1);
+        void *memory = std::aligned_alloc(static_cast<size_t>(alignment), alignedSize == 0 ? static_cast<size_t>(alignment) : alignedSize);
+#endif
+        if (memory)
+        {
+            return memory;
+        }
+        throw std::bad_alloc();
+    }
+
+    void FreeAligned(void *memory)
+    {
+#if defined(_MSC_VER)
+        _aligned_free(memory);
+#else
+        std::free(memory);
+#endif
+    }
+}
+
+namespace HeapStats
+{
+    uint64_t GetNumAllocations()
+    {
+        return s_numAllocations.load(std::memory_order_relaxed);
+    }
+}
+
+// The array and nothrow forms forward to these by default.
+void *operator new(size_t size)
+{
+    return Allocate(size);
+}
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+    return AllocateAligned(size, alignment);
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept
+{
+    FreeAligned(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, size_t, std::align_val_t) noexcept
+{
+    FreeAligned(memory);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts global operator new calls, to keep the frame loop free of heap allocations.
+// Allocations made through malloc directly (e.g. by ImGui) are not counted.
+namespace HeapStats
+{
+    uint64_t GetNumAllocations();
+}
@@ -69,7 +69,18 @@ ImGuiRenderer::ImGuiRenderer(std::shared_ptr<Window> window) : m_window(window)
     ImGui_ImplWin32_Init(m_window->GetWindowHandle());
 }
 
+void ImGuiRenderer::RegisterPanelHandler(PanelHandler &&handler)
+{
+    m_panelHandlers.emplace_back(std::move(handler));
+}
+
 void ImGuiRenderer::Render(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList)
+{
+    BuildFrame();
+    RecordCommands(commandList);
+}
+
+void ImGuiRenderer::BuildFrame()
 {
     ImGui_ImplDX12_NewFrame();
     ImGui_ImplWin32_NewFrame();
@@ -77,11 +88,18 @@ void ImGuiRenderer::Render(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> co
 
     ImGui::ShowDemoWindow(&m_showingDemoWindow);
 
-    ImGui::Begin("Hello, world!");
+    ImGui::Begin("Stats");
+    for (const PanelHandler &handler : m_panelHandlers)
+    {
+        handler();
+    }
     ImGui::End();
 
     ImGui::Render();
+}
 
+void ImGuiRenderer::RecordCommands(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList)
+{
     auto heap = g_descriptorHeapAllocator.GetDescriptorHeap().Get();
     commandList->SetDescriptorHeaps(1, &heap);
     ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), commandList.Get());
@@ -1,17 +1,31 @@
 #include "DX12/Core/Engine.h"
 
+#include <functional>
 #include <vector>
 
 class ImGuiRenderer
 {
 public:
+    using PanelHandler = std::function<void()>;
+
     ImGuiRenderer(std::shared_ptr<Window> window);
 
+    // Register a handler that draws its widgets inside the stats window.
+    void RegisterPanelHandler(PanelHandler &&handler);
+
+    // Build the UI and record it.
     void Render(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList);
 
+    // Build the UI, the panel handlers run here. Call from the window's thread.
+    void BuildFrame();
+    // Record the UI built by the last BuildFrame, from any thread.
+    void RecordCommands(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList);
+
 private:
     static bool InitImGui();
 
     std::shared_ptr<Window> m_window;
     bool m_showingDemoWindow = true;
+
+    std::vector<PanelHandler> m_panelHandlers;
 };
\ No newline at end of file
@@ -0,0 +1,13 @@
+// Included by both C++ and HLSL, so it uses include guards rather than #pragma once.
+#ifndef DX12_INSTANCE_LAYOUT_H
+#define DX12_INSTANCE_LAYOUT_H
+
+// Per-instance vertex data layout.
+// 0: full 4x4 model matrix (64 bytes).
+// 1: float3 position, snorm16 rotation quaternion and half scale (24 bytes),
+//    the vertex shader rebuilds the transform from it.
+#ifndef DX12_COMPACT_INSTANCES
+#define DX12_COMPACT_INSTANCES 0
+#endif
+
+#endif
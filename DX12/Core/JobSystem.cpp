@@ -0,0 +1,244 @@
+#include "JobSystem.h"
+
+#include <cassert>
+#include <numeric>
+
+namespace
+{
+    // Index of the deque owned by the calling thread, valid when s_threadJobSystem matches.
+    thread_local const JobSystem *s_threadJobSystem = nullptr;
+    thread_local uint32_t s_threadIndex = 0;
+}
+
+JobSystem::JobSystem(uint32_t numThreads)
+    : m_running(false), m_numQueuedJobs(0), m_numSleepingWorkers(0), m_nextExternalQueue(0)
+{
+    // The creating thread owns the first deque.
+    s_threadJobSystem = this;
+    s_threadIndex = 0;
+
+    StartWorkers(numThreads);
+}
+
+JobSystem::~JobSystem()
+{
+    StopWorkers();
+}
+
+void JobSystem::SetNumThreads(uint32_t numThreads)
+{
+    assert(s_threadJobSystem == this && s_threadIndex == 0);
+    assert(m_numQueuedJobs.load() == 0 && "Cannot resize the job system while jobs are pending.");
+
+    StopWorkers();
+    StartWorkers(numThreads);
+}
+
+void JobSystem::Submit(const Job &job)
+{
+    if (!Push(GetQueueIndex(), job))
+    {
+        Execute(job);
+        return;
+    }
+
+    WakeWorkers(false);
+}
+
+void JobSystem::Wait(JobCounter &counter)
+{
+    uint32_t queueIndex = GetQueueIndex();
+
+    while (counter.load(std::memory_order_acquire) != 0)
+    {
+        Job job;
+        if (FindJob(queueIndex, job))
+        {
+            Execute(job);
+        }
+        else
+        {
+            // The remaining jobs are running on other threads.
+            std::this_thread::yield();
+        }
+    }
+}
+
+size_t JobSystem::ComputeGrainSize(size_t count, size_t elementSize) const
+{
+    size_t elementsPerAlignment = std::lcm(std::max<size_t>(elementSize, 1), s_cacheLineSize) / std::max<size_t>(elementSize, 1);
+    size_t numChunks = std::max<size_t>(GetNumThreads() * s_chunksPerThread, 1);
+    size_t grainSize = (count + numChunks - 1) / numChunks;
+
+    return std::max<size_t>((grainSize + elementsPerAlignment - 1) / elementsPerAlignment, 1) * elementsPerAlignment;
+}
+
+void JobSystem::StartWorkers(uint32_t numThreads)
+{
+    numThreads = std::max(numThreads, 1u);
+
+    m_queues.clear();
+    for (uint32_t i = 0; i < numThreads; ++i)
+    {
+        auto queue = std::make_unique<WorkQueue>();
+        queue->jobs.resize(s_queueCapacity);
+        m_queues.push_back(std::move(queue));
+    }
+
+    m_running = true;
+    for (uint32_t i = 1; i < numThreads; ++i)
+    {
+        m_workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+    }
+}
+
+void JobSystem::StopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_running = false;
+    }
+    m_wakeCondition.notify_all();
+
+    for (std::thread &worker : m_workers)
+    {
+        worker.join();
+    }
+    m_workers.clear();
+}
+
+void JobSystem::WorkerLoop(uint32_t threadIndex)
+{
+    s_threadJobSystem = this;
+    s_threadIndex = threadIndex;
+
+    while (m_running.load(std::memory_order_relaxed))
+    {
+        Job job;
+        if (FindJob(threadIndex, job))
+        {
+            Execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_numSleepingWorkers.fetch_add(1);
+        m_wakeCondition.wait(lock, [this]()
+                             { return !m_running.load() || m_numQueuedJobs.load() > 0; });
+        m_numSleepingWorkers.fetch_sub(1);
+    }
+}
+
+uint32_t JobSystem::GetQueueIndex()
+{
+    if (s_threadJobSystem == this)
+    {
+        return s_threadIndex;
+    }
+
+    // Threads outside of the job system spread their jobs over all deques.
+    return m_nextExternalQueue.fetch_add(1, std::memory_order_relaxed) % GetNumThreads();
+}
+
+bool JobSystem::Push(uint32_t queueIndex, const Job &job)
+{
+    WorkQueue &queue = *m_queues[queueIndex];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tail - queue.head == s_queueCapacity)
+        {
+            return false;
+        }
+
+        queue.jobs[queue.tail % s_queueCapacity] = job;
+        ++queue.tail;
+    }
+
+    m_numQueuedJobs.fetch_add(1);
+    return true;
+}
+
+bool JobSystem::Pop(uint32_t queueIndex, Job &job)
+{
+    WorkQueue &queue = *m_queues[queueIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tail == queue.head)
+    {
+        return false;
+    }
+
+    --queue.tail;
+    job = queue.jobs[queue.tail % s_queueCapacity];
+    m_numQueuedJobs.fetch_sub(1);
+    return true;
+}
+
+bool JobSystem::Steal(uint32_t queueIndex, Job &job)
+{
+    WorkQueue &queue = *m_queues[queueIndex];
+    std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+    if (!lock.owns_lock() || queue.tail == queue.head)
+    {
+        return false;
+    }
+
+    job = queue.jobs[queue.head % s_queueCapacity];
+    ++queue.head;
+    m_numQueuedJobs.fetch_sub(1);
+    return true;
+}
+
+bool JobSystem::FindJob(uint32_t queueIndex, Job &job)
+{
+    if (m_numQueuedJobs.load(std::memory_order_relaxed) == 0)
+    {
+        return false;
+    }
+
+    if (Pop(queueIndex, job))
+    {
+        return true;
+    }
+
+    // Start stealing from the neighbouring deque so that thieves spread out.
+    uint32_t numQueues = GetNumThreads();
+    for (uint32_t i = 1; i < numQueues; ++i)
+    {
+        if (Steal((queueIndex + i) % numQueues, job))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void JobSystem::Execute(const Job &job)
+{
+    job.function(job.context, job.begin, job.end);
+
+    if (job.counter)
+    {
+        job.counter->fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void JobSystem::WakeWorkers(bool all)
+{
+    // A worker registers itself as sleeping before re-checking the queued job
+    // count under the sleep mutex, so no wake-up can be lost here.
+    if (m_numSleepingWorkers.load() == 0)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+    if (all)
+    {
+        m_wakeCondition.notify_all();
+    }
+    else
+    {
+        m_wakeCondition.notify_one();
+    }
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Work-stealing job system.
+// Every thread that executes jobs (the worker threads plus the thread that
+// created the job system) owns a deque. The owner pushes and pops jobs at the
+// back of its deque, idle threads steal jobs from the front of the others.
+class JobSystem
+{
+public:
+    // Number of jobs of a group that have not finished yet.
+    using JobCounter = std::atomic<uint32_t>;
+    using JobFunction = void (*)(void *context, size_t begin, size_t end);
+
+    struct Job
+    {
+        JobFunction function;
+        void *context;
+        size_t begin;
+        size_t end;
+        JobCounter *counter;
+    };
+
+    static constexpr size_t s_cacheLineSize = 64;
+    // Jobs each deque holds, further jobs run right away on the submitting thread.
+    static constexpr size_t s_queueCapacity = 1024;
+
+    explicit JobSystem(uint32_t numThreads);
+    ~JobSystem();
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem(JobSystem &&) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+    JobSystem &operator=(JobSystem &&) = delete;
+
+    // Number of threads executing jobs, including the thread that owns the job system.
+    uint32_t GetNumThreads() const { return static_cast<uint32_t>(m_queues.size()); }
+
+    // Restart the worker threads. Must be called from the owning thread while no jobs are pending.
+    void SetNumThreads(uint32_t numThreads);
+
+    // Queue a job. The job counter (if any) must already account for it.
+    void Submit(const Job &job);
+
+    // Execute pending jobs until the counter reaches zero.
+    void Wait(JobCounter &counter);
+
+    // Invoke function(chunkBegin, chunkEnd) over [begin, end) in chunks of grainSize
+    // elements and return once every chunk has been executed.
+    template <typename Function>
+    void ParallelFor(size_t begin, size_t end, size_t grainSize, Function &&function);
+
+    // Grain size giving every thread a few chunks to balance the load, rounded
+    // so that each chunk covers a whole number of cache lines.
+    size_t ComputeGrainSize(size_t count, size_t elementSize) const;
+
+private:
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::vector<Job> jobs;
+        size_t head = 0;
+        size_t tail = 0;
+    };
+
+    template <typename Function>
+    static void InvokeRange(void *context, size_t begin, size_t end)
+    {
+        (*static_cast<Function *>(context))(begin, end);
+    }
+
+    void StartWorkers(uint32_t numThreads);
+    void StopWorkers();
+    void WorkerLoop(uint32_t threadIndex);
+
+    uint32_t GetQueueIndex();
+    bool Push(uint32_t queueIndex, const Job &job);
+    bool Pop(uint32_t queueIndex, Job &job);
+    bool Steal(uint32_t queueIndex, Job &job);
+    bool FindJob(uint32_t queueIndex, Job &job);
+    void Execute(const Job &job);
+    void WakeWorkers(bool all);
+
+    static constexpr size_t s_chunksPerThread = 4;
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+
+    std::atomic<bool> m_running;
+    std::atomic<uint32_t> m_numQueuedJobs;
+    std::atomic<uint32_t> m_numSleepingWorkers;
+    std::atomic<uint32_t> m_nextExternalQueue;
+
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeCondition;
+};
+
+template <typename Function>
+void JobSystem::ParallelFor(size_t begin, size_t end, size_t grainSize, Function &&function)
+{
+    if (begin >= end)
+    {
+        return;
+    }
+
+    using FunctionType = std::remove_reference_t<Function>;
+    void *context = const_cast<void *>(static_cast<const void *>(&function));
+
+    grainSize = std::max<size_t>(grainSize, 1);
+    uint32_t queueIndex = GetQueueIndex();
+
+    JobCounter counter = 0;
+    for (size_t chunkBegin = begin; chunkBegin < end; chunkBegin += grainSize)
+    {
+        size_t chunkEnd = std::min(chunkBegin + grainSize, end);
+        Job job = {&InvokeRange<FunctionType>, context, chunkBegin, chunkEnd, &counter};
+
+        counter.fetch_add(1, std::memory_order_relaxed);
+        if (!Push(queueIndex, job))
+        {
+            // The deque is full, run the chunk right away.
+            Execute(job);
+        }
+    }
+
+    WakeWorkers(true);
+    Wait(counter);
+}
@@ -0,0 +1,75 @@
+#include "LruResidencySet.h"
+
+#include <cassert>
+
+void LruResidencySet::Add(Key key, uint64_t size, uint64_t fenceValue)
+{
+    assert(!m_entries.contains(key));
+
+    m_resident.push_back({key, size, fenceValue});
+    m_entries[key] = {std::prev(m_resident.end()), true};
+    m_residentBytes += size;
+}
+
+void LruResidencySet::Remove(Key key)
+{
+    auto entry = m_entries.find(key);
+    assert(entry != m_entries.end());
+
+    if (entry->second.isResident)
+    {
+        m_residentBytes -= entry->second.object->size;
+        m_resident.erase(entry->second.object);
+    }
+    else
+    {
+        m_evictedBytes -= entry->second.object->size;
+        m_evicted.erase(entry->second.object);
+    }
+    m_entries.erase(entry);
+}
+
+bool LruResidencySet::MarkUsed(Key key, uint64_t fenceValue)
+{
+    auto entry = m_entries.find(key);
+    assert(entry != m_entries.end());
+
+    std::list<Object>::iterator object = entry->second.object;
+    assert(fenceValue >= object->lastUsedFenceValue);
+    object->lastUsedFenceValue = fenceValue;
+
+    if (entry->second.isResident)
+    {
+        m_resident.splice(m_resident.end(), m_resident, object);
+        return false;
+    }
+
+    m_resident.splice(m_resident.end(), m_evicted, object);
+    entry->second.isResident = true;
+    m_evictedBytes -= object->size;
+    m_residentBytes += object->size;
+    return true;
+}
+
+uint64_t LruResidencySet::SelectEvictions(uint64_t bytesToEvict, uint64_t completedFenceValue, std::vector<Key> &evictions)
+{
+    uint64_t evictedBytes = 0;
+    while (evictedBytes < bytesToEvict && !m_resident.empty() && m_resident.front().lastUsedFenceValue <= completedFenceValue)
+    {
+        std::list<Object>::iterator object = m_resident.begin();
+        m_evicted.splice(m_evicted.end(), m_resident, object);
+        m_entries[object->key].isResident = false;
+
+        m_residentBytes -= object->size;
+        m_evictedBytes += object->size;
+        evictedBytes += object->size;
+        evictions.push_back(object->key);
+    }
+    return evictedBytes;
+}
+
+bool LruResidencySet::IsResident(Key key) const
+{
+    auto entry = m_entries.find(key);
+    return entry != m_entries.end() && entry->second.isResident;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+// Least-recently-used bookkeeping for residency, without a device. Objects are
+// identified by an opaque key and stamped with the fence value of the last
+// submission that used them. Use fence values must not decrease, then the
+// resident list stays sorted by them and eviction stops at the first object
+// the GPU may still be using. Not thread-safe.
+class LruResidencySet
+{
+public:
+    using Key = const void *;
+
+    LruResidencySet() = default;
+
+    LruResidencySet(const LruResidencySet &) = delete;
+    LruResidencySet(LruResidencySet &&) = delete;
+    LruResidencySet &operator=(const LruResidencySet &) = delete;
+    LruResidencySet &operator=(LruResidencySet &&) = delete;
+
+    // Add a resident object, as used by the submission with fenceValue.
+    void Add(Key key, uint64_t size, uint64_t fenceValue);
+    void Remove(Key key);
+
+    // Mark the object as used by the submission with fenceValue. Returns true
+    // when it was evicted, it is resident again and the caller has to make it so.
+    bool MarkUsed(Key key, uint64_t fenceValue);
+
+    // Mark least recently used resident objects whose last use has completed as
+    // evicted until at least bytesToEvict are, and append their keys. Returns the
+    // bytes evicted, less than asked for when the remaining objects are in use.
+    uint64_t SelectEvictions(uint64_t bytesToEvict, uint64_t completedFenceValue, std::vector<Key> &evictions);
+
+    bool Contains(Key key) const { return m_entries.contains(key); }
+    bool IsResident(Key key) const;
+
+    size_t GetNumObjects() const { return m_entries.size(); }
+    uint64_t GetResidentBytes() const { return m_residentBytes; }
+    uint64_t GetEvictedBytes() const { return m_evictedBytes; }
+
+private:
+    struct Object
+    {
+        Key key;
+        uint64_t size;
+        uint64_t lastUsedFenceValue;
+    };
+
+    struct Entry
+    {
+        std::list<Object>::iterator object;
+        bool isResident;
+    };
+
+    // Least recently used first.
+    std::list<Object> m_resident;
+    std::list<Object> m_evicted;
+    std::unordered_map<Key, Entry> m_entries;
+
+    uint64_t m_residentBytes = 0;
+    uint64_t m_evictedBytes = 0;
+};
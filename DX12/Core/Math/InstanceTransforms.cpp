@@ -0,0 +1,682 @@
+#include "InstanceTransforms.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define INSTANCE_TRANSFORMS_SSE
+#include <emmintrin.h>
+#endif
+
+// MSVC always accepts AVX2 intrinsics, GCC and Clang in functions targeting
+// AVX2, so the kernel is built for any x64 CPU and only used where supported.
+#if defined(_M_X64) || defined(__x86_64__)
+#define INSTANCE_TRANSFORMS_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace InstanceTransforms
+{
+    namespace
+    {
+        // Cody-Waite split of pi / 2 so that the range reduction stays exact for
+        // the first few thousand periods.
+        constexpr float s_twoOverPi = 0.636619772367581343f;
+        constexpr float s_halfPi0 = 1.5703125f;
+        constexpr float s_halfPi1 = 4.837512969970703125e-4f;
+        constexpr float s_halfPi2 = 7.54978995489188216e-8f;
+
+        // Minimax polynomials on [-pi/4, pi/4].
+        constexpr float s_sin0 = -1.6666654611e-1f;
+        constexpr float s_sin1 = 8.3321608736e-3f;
+        constexpr float s_sin2 = -1.9515295891e-4f;
+        constexpr float s_cos0 = 4.166664568298827e-2f;
+        constexpr float s_cos1 = -1.388731625493765e-3f;
+        constexpr float s_cos2 = 2.443315711809948e-5f;
+
+        void BuildTransform(float scale, float s, float c, float x, float y, float z, float tx, float ty, float tz, Float4x4 &out)
+        {
+            float t = 1.0f - c;
+
+            out.m[0][0] = (c + t * x * x) * scale;
+            out.m[0][1] = (t * x * y + z * s) * scale;
+            out.m[0][2] = (t * x * z - y * s) * scale;
+            out.m[0][3] = 0.0f;
+
+            out.m[1][0] = (t * x * y - z * s) * scale;
+            out.m[1][1] = (c + t * y * y) * scale;
+            out.m[1][2] = (t * y * z + x * s) * scale;
+            out.m[1][3] = 0.0f;
+
+            out.m[2][0] = (t * x * z + y * s) * scale;
+            out.m[2][1] = (t * y * z - x * s) * scale;
+            out.m[2][2] = (c + t * z * z) * scale;
+            out.m[2][3] = 0.0f;
+
+            out.m[3][0] = tx;
+            out.m[3][1] = ty;
+            out.m[3][2] = tz;
+            out.m[3][3] = 1.0f;
+        }
+
+#if defined(INSTANCE_TRANSFORMS_SSE)
+        void StoreRow(float *out, __m128 row, StoreMode mode)
+        {
+            if (mode == StoreMode::Streaming)
+            {
+                _mm_stream_ps(out, row);
+            }
+            else
+            {
+                _mm_storeu_ps(out, row);
+            }
+        }
+
+        void SinCos4(__m128 angle, __m128 *sin, __m128 *cos)
+        {
+            __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(angle, _mm_set1_ps(s_twoOverPi)));
+            __m128 j = _mm_cvtepi32_ps(quadrant);
+
+            __m128 r = _mm_sub_ps(angle, _mm_mul_ps(j, _mm_set1_ps(s_halfPi0)));
+            r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(s_halfPi1)));
+            r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(s_halfPi2)));
+            __m128 r2 = _mm_mul_ps(r, r);
+
+            __m128 sinPoly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(s_sin2), r2), _mm_set1_ps(s_sin1));
+            sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, r2), _mm_set1_ps(s_sin0));
+            sinPoly = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinPoly, r2), r), r);
+
+            __m128 cosPoly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(s_cos2), r2), _mm_set1_ps(s_cos1));
+            cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, r2), _mm_set1_ps(s_cos0));
+            cosPoly = _mm_mul_ps(_mm_mul_ps(cosPoly, r2), r2);
+            cosPoly = _mm_add_ps(_mm_sub_ps(cosPoly, _mm_mul_ps(r2, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+            // Odd quadrants swap sine and cosine, quadrants 2-3 negate the sine and 1-2 the cosine.
+            __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+            __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30));
+            __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+
+            __m128 s = _mm_or_ps(_mm_and_ps(swap, cosPoly), _mm_andnot_ps(swap, sinPoly));
+            __m128 c = _mm_or_ps(_mm_and_ps(swap, sinPoly), _mm_andnot_ps(swap, cosPoly));
+
+            *sin = _mm_xor_ps(s, sinSign);
+            *cos = _mm_xor_ps(c, cosSign);
+        }
+
+        void Compose4(__m128 scale, __m128 s, __m128 c, __m128 x, __m128 y, __m128 z, __m128 tx, __m128 ty, __m128 tz, Float4x4 *out, StoreMode mode)
+        {
+            __m128 t = _mm_sub_ps(_mm_set1_ps(1.0f), c);
+            __m128 tTimesX = _mm_mul_ps(t, x);
+            __m128 tTimesY = _mm_mul_ps(t, y);
+            __m128 txy = _mm_mul_ps(tTimesX, y);
+            __m128 txz = _mm_mul_ps(tTimesX, z);
+            __m128 tyz = _mm_mul_ps(tTimesY, z);
+            __m128 xs = _mm_mul_ps(x, s);
+            __m128 ys = _mm_mul_ps(y, s);
+            __m128 zs = _mm_mul_ps(z, s);
+            __m128 zero = _mm_setzero_ps();
+
+            // One vector per matrix element, transposed into one row per instance.
+            __m128 rows[4][4] = {
+                {_mm_mul_ps(_mm_add_ps(c, _mm_mul_ps(tTimesX, x)), scale),
+                 _mm_mul_ps(_mm_add_ps(txy, zs), scale),
+                 _mm_mul_ps(_mm_sub_ps(txz, ys), scale),
+                 zero},
+                {_mm_mul_ps(_mm_sub_ps(txy, zs), scale),
+                 _mm_mul_ps(_mm_add_ps(c, _mm_mul_ps(tTimesY, y)), scale),
+                 _mm_mul_ps(_mm_add_ps(tyz, xs), scale),
+                 zero},
+                {_mm_mul_ps(_mm_add_ps(txz, ys), scale),
+                 _mm_mul_ps(_mm_sub_ps(tyz, xs), scale),
+                 _mm_mul_ps(_mm_add_ps(c, _mm_mul_ps(_mm_mul_ps(t, z), z)), scale),
+                 zero},
+                {tx, ty, tz, _mm_set1_ps(1.0f)}};
+
+            for (size_t row = 0; row < 4; ++row)
+            {
+                _MM_TRANSPOSE4_PS(rows[row][0], rows[row][1], rows[row][2], rows[row][3]);
+            }
+
+            // Write the instances in address order.
+            for (size_t instance = 0; instance < 4; ++instance)
+            {
+                for (size_t row = 0; row < 4; ++row)
+                {
+                    StoreRow(out[instance].m[row], rows[row][instance], mode);
+                }
+            }
+        }
+#endif
+
+#if defined(INSTANCE_TRANSFORMS_AVX2)
+#if defined(__GNUC__) && !defined(__AVX2__)
+#define INSTANCE_TRANSFORMS_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define INSTANCE_TRANSFORMS_AVX2_TARGET
+#endif
+
+        INSTANCE_TRANSFORMS_AVX2_TARGET void SinCos8(__m256 angle, __m256 *sin, __m256 *cos)
+        {
+            __m256i quadrant = _mm256_cvtps_epi32(_mm256_mul_ps(angle, _mm256_set1_ps(s_twoOverPi)));
+            __m256 j = _mm256_cvtepi32_ps(quadrant);
+
+            __m256 r = _mm256_sub_ps(angle, _mm256_mul_ps(j, _mm256_set1_ps(s_halfPi0)));
+            r = _mm256_sub_ps(r, _mm256_mul_ps(j, _mm256_set1_ps(s_halfPi1)));
+            r = _mm256_sub_ps(r, _mm256_mul_ps(j, _mm256_set1_ps(s_halfPi2)));
+            __m256 r2 = _mm256_mul_ps(r, r);
+
+            __m256 sinPoly = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(s_sin2), r2), _mm256_set1_ps(s_sin1));
+            sinPoly = _mm256_add_ps(_mm256_mul_ps(sinPoly, r2), _mm256_set1_ps(s_sin0));
+            sinPoly = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(sinPoly, r2), r), r);
+
+            __m256 cosPoly = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(s_cos2), r2), _mm256_set1_ps(s_cos1));
+            cosPoly = _mm256_add_ps(_mm256_mul_ps(cosPoly, r2), _mm256_set1_ps(s_cos0));
+            cosPoly = _mm256_mul_ps(_mm256_mul_ps(cosPoly, r2), r2);
+            cosPoly = _mm256_add_ps(_mm256_sub_ps(cosPoly, _mm256_mul_ps(r2, _mm256_set1_ps(0.5f))), _mm256_set1_ps(1.0f));
+
+            __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+            __m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(2)), 30));
+            __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30));
+
+            *sin = _mm256_xor_ps(_mm256_blendv_ps(sinPoly, cosPoly, swap), sinSign);
+            *cos = _mm256_xor_ps(_mm256_blendv_ps(cosPoly, sinPoly, swap), cosSign);
+        }
+
+        INSTANCE_TRANSFORMS_AVX2_TARGET void StoreRows(float *out, __m256 rows, StoreMode mode)
+        {
+            if (mode == StoreMode::Cached)
+            {
+                _mm256_storeu_ps(out, rows);
+            }
+            else if ((reinterpret_cast<uintptr_t>(out) & 31) == 0)
+            {
+                _mm256_stream_ps(out, rows);
+            }
+            else
+            {
+                // Streaming destinations only have to be 16-byte aligned.
+                _mm_stream_ps(out, _mm256_castps256_ps128(rows));
+                _mm_stream_ps(out + 4, _mm256_extractf128_ps(rows, 1));
+            }
+        }
+
+        // Transposes the 4x4 blocks in each 128-bit lane.
+        INSTANCE_TRANSFORMS_AVX2_TARGET void TransposeLanes(__m256 *rows)
+        {
+            __m256 t0 = _mm256_unpacklo_ps(rows[0], rows[1]);
+            __m256 t1 = _mm256_unpackhi_ps(rows[0], rows[1]);
+            __m256 t2 = _mm256_unpacklo_ps(rows[2], rows[3]);
+            __m256 t3 = _mm256_unpackhi_ps(rows[2], rows[3]);
+            rows[0] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+            rows[1] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+            rows[2] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+            rows[3] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+        }
+
+        INSTANCE_TRANSFORMS_AVX2_TARGET void Compose8(const InstanceSoA &instances, size_t i, Float4x4 *out, StoreMode mode)
+        {
+            __m256 s;
+            __m256 c;
+            SinCos8(_mm256_loadu_ps(instances.angle + i), &s, &c);
+
+            __m256 scale = _mm256_loadu_ps(instances.scale + i);
+            __m256 x = _mm256_loadu_ps(instances.axisX + i);
+            __m256 y = _mm256_loadu_ps(instances.axisY + i);
+            __m256 z = _mm256_loadu_ps(instances.axisZ + i);
+
+            __m256 t = _mm256_sub_ps(_mm256_set1_ps(1.0f), c);
+            __m256 tTimesX = _mm256_mul_ps(t, x);
+            __m256 tTimesY = _mm256_mul_ps(t, y);
+            __m256 txy = _mm256_mul_ps(tTimesX, y);
+            __m256 txz = _mm256_mul_ps(tTimesX, z);
+            __m256 tyz = _mm256_mul_ps(tTimesY, z);
+            __m256 xs = _mm256_mul_ps(x, s);
+            __m256 ys = _mm256_mul_ps(y, s);
+            __m256 zs = _mm256_mul_ps(z, s);
+            __m256 zero = _mm256_setzero_ps();
+
+            // One vector per matrix element, as in Compose4.
+            __m256 rows[4][4] = {
+                {_mm256_mul_ps(_mm256_add_ps(c, _mm256_mul_ps(tTimesX, x)), scale),
+                 _mm256_mul_ps(_mm256_add_ps(txy, zs), scale),
+                 _mm256_mul_ps(_mm256_sub_ps(txz, ys), scale),
+                 zero},
+                {_mm256_mul_ps(_mm256_sub_ps(txy, zs), scale),
+                 _mm256_mul_ps(_mm256_add_ps(c, _mm256_mul_ps(tTimesY, y)), scale),
+                 _mm256_mul_ps(_mm256_add_ps(tyz, xs), scale),
+                 zero},
+                {_mm256_mul_ps(_mm256_add_ps(txz, ys), scale),
+                 _mm256_mul_ps(_mm256_sub_ps(tyz, xs), scale),
+                 _mm256_mul_ps(_mm256_add_ps(c, _mm256_mul_ps(_mm256_mul_ps(t, z), z)), scale),
+                 zero},
+                {_mm256_loadu_ps(instances.offsetX + i), _mm256_loadu_ps(instances.offsetY + i), _mm256_loadu_ps(instances.offsetZ + i), _mm256_set1_ps(1.0f)}};
+
+            // Afterwards rows[row][k] holds that row of instance k in the low
+            // lane and of instance k + 4 in the high lane.
+            for (size_t row = 0; row < 4; ++row)
+            {
+                TransposeLanes(rows[row]);
+            }
+
+            // Pair up the rows of each instance, written in address order.
+            for (size_t instance = 0; instance < 4; ++instance)
+            {
+                StoreRows(out[instance].m[0], _mm256_permute2f128_ps(rows[0][instance], rows[1][instance], 0x20), mode);
+                StoreRows(out[instance].m[2], _mm256_permute2f128_ps(rows[2][instance], rows[3][instance], 0x20), mode);
+            }
+            for (size_t instance = 0; instance < 4; ++instance)
+            {
+                StoreRows(out[instance + 4].m[0], _mm256_permute2f128_ps(rows[0][instance], rows[1][instance], 0x31), mode);
+                StoreRows(out[instance + 4].m[2], _mm256_permute2f128_ps(rows[2][instance], rows[3][instance], 0x31), mode);
+            }
+        }
+#endif
+
+        bool DetectAVX2()
+        {
+#if defined(INSTANCE_TRANSFORMS_AVX2) && defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7)
+            {
+                return false;
+            }
+
+            // The OS must save the AVX registers on context switches.
+            __cpuid(info, 1);
+            bool osxsave = (info[2] & (1 << 27)) != 0;
+            bool avx = (info[2] & (1 << 28)) != 0;
+            if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+            {
+                return false;
+            }
+
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+#elif defined(INSTANCE_TRANSFORMS_AVX2) && defined(__GNUC__)
+            return __builtin_cpu_supports("avx2");
+#else
+            return false;
+#endif
+        }
+    }
+
+    void SinCos(float angle, float *sin, float *cos)
+    {
+        int32_t quadrant = static_cast<int32_t>(std::nearbyint(angle * s_twoOverPi));
+        float j = static_cast<float>(quadrant);
+
+        float r = ((angle - j * s_halfPi0) - j * s_halfPi1) - j * s_halfPi2;
+        float r2 = r * r;
+
+        float sinPoly = ((s_sin2 * r2 + s_sin1) * r2 + s_sin0) * r2 * r + r;
+        float cosPoly = ((s_cos2 * r2 + s_cos1) * r2 + s_cos0) * r2 * r2 - r2 * 0.5f + 1.0f;
+
+        bool swap = (quadrant & 1) != 0;
+        float s = swap ? cosPoly : sinPoly;
+        float c = swap ? sinPoly : cosPoly;
+
+        *sin = (quadrant & 2) != 0 ? -s : s;
+        *cos = ((quadrant + 1) & 2) != 0 ? -c : c;
+    }
+
+    void StoreTransform(const Float4x4 &transform, Float4x4 *out, StoreMode mode)
+    {
+#if defined(INSTANCE_TRANSFORMS_SSE)
+        for (size_t row = 0; row < 4; ++row)
+        {
+            StoreRow(out->m[row], _mm_loadu_ps(transform.m[row]), mode);
+        }
+#else
+        *out = transform;
+#endif
+    }
+
+    void StoreTransform(const CompactInstance &transform, CompactInstance *out, StoreMode mode)
+    {
+#if defined(INSTANCE_TRANSFORMS_SSE)
+        if (mode == StoreMode::Streaming)
+        {
+            // Six dwords, out is only 8-byte aligned.
+            constexpr size_t numWords = sizeof(CompactInstance) / sizeof(int32_t);
+            int words[numWords];
+            std::memcpy(words, &transform, sizeof(CompactInstance));
+
+            int *destination = reinterpret_cast<int *>(out);
+            for (size_t i = 0; i < numWords; ++i)
+            {
+                _mm_stream_si32(destination + i, words[i]);
+            }
+            return;
+        }
+#endif
+        *out = transform;
+    }
+
+    void FlushStreamingStores()
+    {
+#if defined(INSTANCE_TRANSFORMS_SSE)
+        _mm_sfence();
+#endif
+    }
+
+    void ComposeReference(const InstanceSoA &instances, size_t begin, size_t end, Float4x4 *out, StoreMode mode)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            Float4x4 transform;
+            BuildTransform(instances.scale[i], std::sin(instances.angle[i]), std::cos(instances.angle[i]),
+                           instances.axisX[i], instances.axisY[i], instances.axisZ[i],
+                           instances.offsetX[i], instances.offsetY[i], instances.offsetZ[i], transform);
+            StoreTransform(transform, out + i, mode);
+        }
+    }
+
+    void ComposeScalar(const InstanceSoA &instances, size_t begin, size_t end, Float4x4 *out, StoreMode mode)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            float s;
+            float c;
+            SinCos(instances.angle[i], &s, &c);
+
+            Float4x4 transform;
+            BuildTransform(instances.scale[i], s, c,
+                           instances.axisX[i], instances.axisY[i], instances.axisZ[i],
+                           instances.offsetX[i], instances.offsetY[i], instances.offsetZ[i], transform);
+            StoreTransform(transform, out + i, mode);
+        }
+    }
+
+    void ComposeSSE(const InstanceSoA &instances, size_t begin, size_t end, Float4x4 *out, StoreMode mode)
+    {
+#if defined(INSTANCE_TRANSFORMS_SSE)
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4)
+        {
+            __m128 sin;
+            __m128 cos;
+            SinCos4(_mm_loadu_ps(instances.angle + i), &sin, &cos);
+
+            Compose4(_mm_loadu_ps(instances.scale + i), sin, cos,
+                     _mm_loadu_ps(instances.axisX + i), _mm_loadu_ps(instances.axisY + i), _mm_loadu_ps(instances.axisZ + i),
+                     _mm_loadu_ps(instances.offsetX + i), _mm_loadu_ps(instances.offsetY + i), _mm_loadu_ps(instances.offsetZ + i),
+                     out + i, mode);
+        }
+
+        ComposeScalar(instances, i, end, out, mode);
+#else
+        ComposeScalar(instances, begin, end, out, mode);
+#endif
+    }
+
+    void ComposeAVX2(const InstanceSoA &instances, size_t begin, size_t end, Float4x4 *out, StoreMode mode)
+    {
+#if defined(INSTANCE_TRANSFORMS_AVX2)
+        assert(IsKernelSupported(Kernel::AVX2));
+
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8)
+        {
+            Compose8(instances, i, out + i, mode);
+        }
+
+        ComposeSSE(instances, i, end, out, mode);
+#else
+        ComposeSSE(instances, begin, end, out, mode);
+#endif
+    }
+
+    uint16_t FloatToHalf(float value)
+    {
+        uint32_t bits = std::bit_cast<uint32_t>(value);
+        uint32_t sign = (bits >> 16) & 0x8000;
+        uint32_t exponent = (bits >> 23) & 0xff;
+        uint32_t mantissa = bits & 0x7fffff;
+
+        // Infinity and NaN, keeping NaNs quiet.
+        if (exponent == 0xff)
+        {
+            return static_cast<uint16_t>(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+        }
+
+        int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+        if (halfExponent >= 0x1f)
+        {
+            return static_cast<uint16_t>(sign | 0x7c00);
+        }
+
+        uint32_t half;
+        uint32_t remainder;
+        uint32_t halfway;
+        if (halfExponent <= 0)
+        {
+            // Denormal half, or zero once the value is below half of the smallest denormal.
+            if (halfExponent < -10)
+            {
+                return static_cast<uint16_t>(sign);
+            }
+
+            uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+            mantissa |= 0x800000;
+            half = mantissa >> shift;
+            remainder = mantissa & ((1u << shift) - 1);
+            halfway = 1u << (shift - 1);
+        }
+        else
+        {
+            half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+            remainder = mantissa & 0x1fff;
+            halfway = 0x1000;
+        }
+
+        // A carry out of the mantissa correctly bumps the exponent, up to infinity.
+        if (remainder > halfway || (remainder == halfway && (half & 1) != 0))
+        {
+            ++half;
+        }
+
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    float HalfToFloat(uint16_t value)
+    {
+        uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+        uint32_t exponent = (value >> 10) & 0x1f;
+        uint32_t mantissa = value & 0x3ff;
+
+        if (exponent == 0x1f)
+        {
+            return std::bit_cast<float>(sign | 0x7f800000 | (mantissa << 13));
+        }
+        if (exponent == 0)
+        {
+            float denormal = std::ldexp(static_cast<float>(mantissa), -24);
+            return sign != 0 ? -denormal : denormal;
+        }
+
+        return std::bit_cast<float>(sign | ((exponent + 127 - 15) << 23) | (mantissa << 13));
+    }
+
+    int16_t FloatToSnorm16(float value)
+    {
+        return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+    }
+
+    float Snorm16ToFloat(int16_t value)
+    {
+        // -32768 and -32767 both map to -1.
+        return std::max(static_cast<float>(value) / 32767.0f, -1.0f);
+    }
+
+    CompactInstance EncodeCompact(const float position[3], const float rotation[4], float scale)
+    {
+        float sign = rotation[3] < 0.0f ? -1.0f : 1.0f;
+
+        CompactInstance instance;
+        instance.position[0] = position[0];
+        instance.position[1] = position[1];
+        instance.position[2] = position[2];
+        for (size_t i = 0; i < 4; ++i)
+        {
+            instance.rotation[i] = FloatToSnorm16(rotation[i] * sign);
+        }
+        instance.scale = FloatToHalf(scale);
+        instance.padding = 0;
+        return instance;
+    }
+
+    Float4x4 DecodeCompact(const CompactInstance &instance)
+    {
+        float x = Snorm16ToFloat(instance.rotation[0]);
+        float y = Snorm16ToFloat(instance.rotation[1]);
+        float z = Snorm16ToFloat(instance.rotation[2]);
+        float w = Snorm16ToFloat(instance.rotation[3]);
+
+        // The quantized quaternion is only approximately unit length.
+        float length = std::sqrt(x * x + y * y + z * z + w * w);
+        if (length > 0.0f)
+        {
+            x /= length;
+            y /= length;
+            z /= length;
+            w /= length;
+        }
+
+        float scale = HalfToFloat(instance.scale);
+
+        Float4x4 out;
+        out.m[0][0] = (1.0f - 2.0f * (y * y + z * z)) * scale;
+        out.m[0][1] = 2.0f * (x * y + z * w) * scale;
+        out.m[0][2] = 2.0f * (x * z - y * w) * scale;
+        out.m[0][3] = 0.0f;
+
+        out.m[1][0] = 2.0f * (x * y - z * w) * scale;
+        out.m[1][1] = (1.0f - 2.0f * (x * x + z * z)) * scale;
+        out.m[1][2] = 2.0f * (y * z + x * w) * scale;
+        out.m[1][3] = 0.0f;
+
+        out.m[2][0] = 2.0f * (x * z + y * w) * scale;
+        out.m[2][1] = 2.0f * (y * z - x * w) * scale;
+        out.m[2][2] = (1.0f - 2.0f * (x * x + y * y)) * scale;
+        out.m[2][3] = 0.0f;
+
+        out.m[3][0] = instance.position[0];
+        out.m[3][1] = instance.position[1];
+        out.m[3][2] = instance.position[2];
+        out.m[3][3] = 1.0f;
+        return out;
+    }
+
+    bool IsKernelSupported(Kernel kernel)
+    {
+        switch (kernel)
+        {
+        case Kernel::SSE:
+#if defined(INSTANCE_TRANSFORMS_SSE)
+            return true;
+#else
+            return false;
+#endif
+        case Kernel::AVX2:
+        {
+            static const bool supported = DetectAVX2();
+            return supported;
+        }
+        default:
+            return true;
+        }
+    }
+
+    Kernel GetBestKernel()
+    {
+        if (IsKernelSupported(Kernel::AVX2))
+        {
+            return Kernel::AVX2;
+        }
+        if (IsKernelSupported(Kernel::SSE))
+        {
+            return Kernel::SSE;
+        }
+        return Kernel::Scalar;
+    }
+
+    const char *GetKernelName(Kernel kernel)
+    {
+        switch (kernel)
+        {
+        case Kernel::Reference:
+            return "Reference";
+        case Kernel::Scalar:
+            return "Scalar";
+        case Kernel::SSE:
+            return "SSE";
+        case Kernel::AVX2:
+            return "AVX2";
+        default:
+            return "Unknown";
+        }
+    }
+
+    void Compose(Kernel kernel, const InstanceSoA &instances, size_t begin, size_t end, Float4x4 *out, StoreMode mode)
+    {
+        switch (kernel)
+        {
+        case Kernel::Reference:
+            ComposeReference(instances, begin, end, out, mode);
+            break;
+        case Kernel::Scalar:
+            ComposeScalar(instances, begin, end, out, mode);
+            break;
+        case Kernel::SSE:
+            ComposeSSE(instances, begin, end, out, mode);
+            break;
+        case Kernel::AVX2:
+            ComposeAVX2(instances, begin, end, out, mode);
+            break;
+        default:
+            assert(false && "Invalid instance transform kernel.");
+        }
+
+        if (mode == StoreMode::Streaming)
+        {
+            FlushStreamingStores();
+        }
+    }
+
+    void Compose(Kernel kernel, const InstanceSoA &instances, size_t begin, size_t end, CompactInstance *out, StoreMode mode)
+    {
+        // Quantization dominates here, so every kernel shares the scalar loop.
+        for (size_t i = begin; i < end; ++i)
+        {
+            float halfAngle = instances.angle[i] * 0.5f;
+            float s;
+            float c;
+            if (kernel == Kernel::Reference)
+            {
+                s = std::sin(halfAngle);
+                c = std::cos(halfAngle);
+            }
+            else
+            {
+                SinCos(halfAngle, &s, &c);
+            }
+
+            float position[3] = {instances.offsetX[i], instances.offsetY[i], instances.offsetZ[i]};
+            float rotation[4] = {instances.axisX[i] * s, instances.axisY[i] * s, instances.axisZ[i] * s, c};
+            StoreTransform(EncodeCompact(position, rotation, instances.scale[i]), out + i, mode);
+        }
+
+        if (mode == StoreMode::Streaming)
+        {
+            FlushStreamingStores();
+        }
+    }
+}
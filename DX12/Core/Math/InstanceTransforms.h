@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Batched scale * rotate * translate composition for instance transforms.
+// Does not depend on DirectXMath or Windows so it can be built on any platform.
+namespace InstanceTransforms
+{
+    // Row-major 4x4 matrix using the row-vector convention, layout compatible
+    // with DirectX::XMFLOAT4X4 and DirectX::XMMATRIX.
+    struct Float4x4
+    {
+        float m[4][4];
+    };
+
+    // Structure-of-arrays input, one element per instance. Rotation axes must be
+    // normalized, angles are in radians and scales are uniform.
+    struct InstanceSoA
+    {
+        const float *scale;
+        const float *angle;
+        const float *axisX;
+        const float *axisY;
+        const float *axisZ;
+        const float *offsetX;
+        const float *offsetY;
+        const float *offsetZ;
+    };
+
+    // Quantized transform: position, rotation quaternion as 16-bit snorm and
+    // uniform scale as a half float. Matches the compact vertex shader input
+    // (R32G32B32_FLOAT, R16G16B16A16_SNORM, R16_FLOAT).
+    struct CompactInstance
+    {
+        float position[3];
+        int16_t rotation[4];
+        uint16_t scale;
+        uint16_t padding;
+    };
+    static_assert(sizeof(CompactInstance) == 24);
+
+    enum class StoreMode
+    {
+        Cached,
+        // Non-temporal stores, for write-combined memory such as mapped upload heaps.
+        // The destination must be 16-byte aligned.
+        Streaming
+    };
+
+    enum class Kernel
+    {
+        Reference,
+        Scalar,
+        SSE,
+        AVX2
+    };
+
+    // Polynomial sine/cosine shared by every kernel except the reference one.
+    void SinCos(float angle, float *sin, float *cos);
+
+    // Write a single transform, one instance after the other so that streaming
+    // stores fill whole cache lines in order.
+    void StoreTransform(const Float4x4 &transform, Float4x4 *out, StoreMode mode);
+
+    // Write a single compact transform, see StoreTransform.
+    void StoreTransform(const CompactInstance &transform, CompactInstance *out, StoreMode mode);
+
+    // Make the streaming stores of the calling thread visible to other agents (e.g. the GPU).
+    void FlushStreamingStores();
+
+    // Reference implementation using the standard library sine/cosine.
+    void ComposeReference(const InstanceSoA &instances, size_t begin, size_t end, Float4x4 *out, StoreMode mode = StoreMode::Cached);
+
+    // Portable fallback, matches the vector kernels up to floating point rounding.
+    void ComposeScalar(const InstanceSoA &instances, size_t begin, size_t end, Float4x4 *out, StoreMode mode = StoreMode::Cached);
+
+    // 4 instances per iteration.
+    void ComposeSSE(const InstanceSoA &instances, size_t begin, size_t end, Float4x4 *out, StoreMode mode = StoreMode::Cached);
+
+    // 8 instances per iteration.
+    void ComposeAVX2(const InstanceSoA &instances, size_t begin, size_t end, Float4x4 *out, StoreMode mode = StoreMode::Cached);
+
+    // IEEE half conversions, rounding to nearest even.
+    uint16_t FloatToHalf(float value);
+    float HalfToFloat(uint16_t value);
+
+    // Same mapping as DXGI_FORMAT_R16_SNORM, the input is clamped to [-1, 1].
+    int16_t FloatToSnorm16(float value);
+    float Snorm16ToFloat(int16_t value);
+
+    // Quantize a transform. The rotation is a unit quaternion (x, y, z, w), it is
+    // stored with w >= 0 since q and -q describe the same rotation.
+    CompactInstance EncodeCompact(const float position[3], const float rotation[4], float scale);
+
+    // Rebuild the matrix the same way the vertex shader does.
+    Float4x4 DecodeCompact(const CompactInstance &instance);
+
+    bool IsKernelSupported(Kernel kernel);
+    Kernel GetBestKernel();
+    const char *GetKernelName(Kernel kernel);
+
+    // Compose out[i] for every instance in [begin, end) with the given kernel.
+    // Streaming stores are flushed before returning.
+    void Compose(Kernel kernel, const InstanceSoA &instances, size_t begin, size_t end, Float4x4 *out, StoreMode mode = StoreMode::Cached);
+
+    // Quantize every instance in [begin, end) into out[i]. The Reference kernel uses
+    // the standard library sine/cosine, the others share the polynomial one.
+    void Compose(Kernel kernel, const InstanceSoA &instances, size_t begin, size_t end, CompactInstance *out, StoreMode mode = StoreMode::Cached);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Fence values of the direct, compute and copy queues, for the modules that
+// track GPU progress without knowing about D3D12. A fence value of 0 means the
+// queue is not waited on.
+namespace QueueFences
+{
+    constexpr size_t s_directQueue = 0;
+    constexpr size_t s_computeQueue = 1;
+    constexpr size_t s_copyQueue = 2;
+    constexpr size_t s_numQueues = 3;
+
+    using FenceValues = std::array<uint64_t, s_numQueues>;
+
+    inline bool IsComplete(size_t queueIndex, uint64_t fenceValue, const FenceValues &completedFenceValues)
+    {
+        return fenceValue <= completedFenceValues[queueIndex];
+    }
+
+    inline bool IsComplete(const FenceValues &fenceValues, const FenceValues &completedFenceValues)
+    {
+        for (size_t i = 0; i < s_numQueues; i++)
+        {
+            if (!IsComplete(i, fenceValues[i], completedFenceValues))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Move the entries for which isComplete holds to the end of completed and
+    // close the gaps they leave, both in their original order. Entries on
+    // different queues do not complete in order, every one is checked. Does
+    // not allocate once completed has grown to the usual number of entries.
+    template <typename Entry, typename Predicate>
+    void MoveCompleted(std::vector<Entry> &entries, std::vector<Entry> &completed, Predicate isComplete)
+    {
+        size_t numPending = 0;
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            if (isComplete(entries[i]))
+            {
+                completed.push_back(std::move(entries[i]));
+            }
+            else
+            {
+                if (numPending != i)
+                {
+                    entries[numPending] = std::move(entries[i]);
+                }
+                numPending++;
+            }
+        }
+        entries.erase(entries.begin() + static_cast<std::ptrdiff_t>(numPending), entries.end());
+    }
+}
@@ -0,0 +1,228 @@
+#include "ReadbackService.h"
+
+#include "CommandQueue.h"
+#include "ResourceStateTracker.h"
+
+#pragma warning(push)
+#pragma warning(disable : 4365)
+#pragma warning(disable : 4626)
+#include "directx/d3dx12.h"
+#pragma warning(pop)
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+ReadbackService::ReadbackService(Microsoft::WRL::ComPtr<ID3D12Device2> device, std::shared_ptr<CommandQueue> commandQueue)
+    : m_device(device), m_commandQueue(commandQueue)
+{
+}
+
+ReadbackService::~ReadbackService()
+{
+    for (std::vector<Buffer> &freeBuffers : m_freeBuffers)
+    {
+        for (Buffer &buffer : freeBuffers)
+        {
+            buffer.resource->Unmap(0, nullptr);
+        }
+    }
+    for (Request &request : m_requests)
+    {
+        request.buffer.resource->Unmap(0, nullptr);
+    }
+}
+
+ReadbackService::Buffer ReadbackService::AcquireBuffer(uint64_t size)
+{
+    uint32_t sizeClass = static_cast<uint32_t>(std::bit_width(std::max<uint64_t>(size, 1) - 1));
+    sizeClass = std::max(sizeClass, s_minSizeClassBits) - s_minSizeClassBits;
+
+    if (sizeClass < m_freeBuffers.size() && !m_freeBuffers[sizeClass].empty())
+    {
+        Buffer buffer = m_freeBuffers[sizeClass].back();
+        m_freeBuffers[sizeClass].pop_back();
+        m_numBufferReuses++;
+        return buffer;
+    }
+
+    CD3DX12_HEAP_PROPERTIES readbackHeapProps(D3D12_HEAP_TYPE_READBACK);
+    CD3DX12_RESOURCE_DESC readbackBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(uint64_t(1) << (sizeClass + s_minSizeClassBits));
+
+    Buffer buffer = {nullptr, nullptr, sizeClass};
+    assert(SUCCEEDED(m_device->CreateCommittedResource(
+        &readbackHeapProps,
+        D3D12_HEAP_FLAG_NONE,
+        &readbackBufferDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&buffer.resource))));
+
+    // Readback buffers stay mapped, the CPU only reads completed copies.
+    void *mappedData = nullptr;
+    assert(SUCCEEDED(buffer.resource->Map(0, nullptr, &mappedData)));
+    buffer.mappedData = static_cast<const std::byte *>(mappedData);
+
+    m_numBuffers++;
+    return buffer;
+}
+
+void ReadbackService::ReleaseBuffer(Buffer &buffer)
+{
+    if (buffer.sizeClass >= m_freeBuffers.size())
+    {
+        m_freeBuffers.resize(buffer.sizeClass + 1);
+    }
+
+    std::vector<Buffer> &freeBuffers = m_freeBuffers[buffer.sizeClass];
+    if (freeBuffers.size() < s_maxFreeBuffersPerSizeClass)
+    {
+        freeBuffers.push_back(buffer);
+        return;
+    }
+
+    buffer.resource->Unmap(0, nullptr);
+    m_numBuffers--;
+}
+
+ReadbackService::Request &ReadbackService::AddRequest(Buffer &buffer, uint32_t rowSize, uint32_t numRows, uint32_t rowPitch)
+{
+    m_requests.push_back({buffer, 0, rowSize, numRows, rowPitch, std::nullopt, nullptr});
+    return m_requests.back();
+}
+
+std::future<ReadbackService::Result> ReadbackService::AddPromise(Request &request)
+{
+    return request.promise.emplace().get_future();
+}
+
+ReadbackService::Request &ReadbackService::RecordBufferCopy(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList, ID3D12Resource *source, uint64_t offset, uint64_t size)
+{
+    ResourceStateTracker &resourceStateTracker = m_commandQueue->GetResourceStateTracker(commandList);
+    resourceStateTracker.TransitionResource(source, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    resourceStateTracker.FlushResourceBarriers(commandList.Get());
+
+    Buffer buffer = AcquireBuffer(size);
+    commandList->CopyBufferRegion(buffer.resource.Get(), 0, source, offset, size);
+
+    return AddRequest(buffer, static_cast<uint32_t>(size), 1, static_cast<uint32_t>(size));
+}
+
+ReadbackService::Request &ReadbackService::RecordTextureCopy(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList, ID3D12Resource *source, UINT subresource)
+{
+    ResourceStateTracker &resourceStateTracker = m_commandQueue->GetResourceStateTracker(commandList);
+    resourceStateTracker.TransitionResource(source, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    resourceStateTracker.FlushResourceBarriers(commandList.Get());
+
+    D3D12_RESOURCE_DESC desc = source->GetDesc();
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+    UINT numRows = 0;
+    UINT64 rowSize = 0;
+    UINT64 totalBytes = 0;
+    m_device->GetCopyableFootprints(&desc, subresource, 1, 0, &footprint, &numRows, &rowSize, &totalBytes);
+
+    Buffer buffer = AcquireBuffer(totalBytes);
+    CD3DX12_TEXTURE_COPY_LOCATION destination(buffer.resource.Get(), footprint);
+    CD3DX12_TEXTURE_COPY_LOCATION sourceLocation(source, subresource);
+    commandList->CopyTextureRegion(&destination, 0, 0, 0, &sourceLocation, nullptr);
+
+    // Rows of every depth slice follow each other.
+    return AddRequest(buffer, static_cast<uint32_t>(rowSize), numRows * footprint.Footprint.Depth, footprint.Footprint.RowPitch);
+}
+
+ReadbackService::Request &ReadbackService::RecordQueryResolve(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList, ID3D12QueryHeap *queryHeap, D3D12_QUERY_TYPE type, UINT startIndex, UINT numQueries)
+{
+    // Timestamps and occlusion results are 64 bits, pipeline statistics are larger.
+    uint32_t querySize = type == D3D12_QUERY_TYPE_PIPELINE_STATISTICS ? sizeof(D3D12_QUERY_DATA_PIPELINE_STATISTICS) : sizeof(uint64_t);
+    uint32_t size = querySize * numQueries;
+
+    Buffer buffer = AcquireBuffer(size);
+    commandList->ResolveQueryData(queryHeap, type, startIndex, numQueries, buffer.resource.Get(), 0);
+
+    return AddRequest(buffer, size, 1, size);
+}
+
+std::future<ReadbackService::Result> ReadbackService::ReadbackBuffer(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList, ID3D12Resource *source, uint64_t offset, uint64_t size)
+{
+    return AddPromise(RecordBufferCopy(commandList, source, offset, size));
+}
+
+std::future<ReadbackService::Result> ReadbackService::ReadbackTexture(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList, ID3D12Resource *source, UINT subresource)
+{
+    return AddPromise(RecordTextureCopy(commandList, source, subresource));
+}
+
+std::future<ReadbackService::Result> ReadbackService::ResolveQueryData(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList, ID3D12QueryHeap *queryHeap, D3D12_QUERY_TYPE type, UINT startIndex, UINT numQueries)
+{
+    return AddPromise(RecordQueryResolve(commandList, queryHeap, type, startIndex, numQueries));
+}
+
+void ReadbackService::ReadbackBuffer(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList, ID3D12Resource *source, uint64_t offset, uint64_t size, Callback callback)
+{
+    RecordBufferCopy(commandList, source, offset, size).callback = std::move(callback);
+}
+
+void ReadbackService::ReadbackTexture(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList, ID3D12Resource *source, UINT subresource, Callback callback)
+{
+    RecordTextureCopy(commandList, source, subresource).callback = std::move(callback);
+}
+
+void ReadbackService::ResolveQueryData(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList, ID3D12QueryHeap *queryHeap, D3D12_QUERY_TYPE type, UINT startIndex, UINT numQueries, Callback callback)
+{
+    RecordQueryResolve(commandList, queryHeap, type, startIndex, numQueries).callback = std::move(callback);
+}
+
+void ReadbackService::Submit(uint64_t fenceValue)
+{
+    for (Request &request : m_requests)
+    {
+        if (request.fenceValue == 0)
+        {
+            request.fenceValue = fenceValue;
+        }
+    }
+}
+
+void ReadbackService::Update()
+{
+    if (m_requests.empty())
+    {
+        return;
+    }
+
+    // Completed requests are handled in order and the others are moved up,
+    // without the temporary buffer std::stable_partition may allocate.
+    uint64_t completedFenceValue = m_commandQueue->GetCompletedFenceValue();
+    auto pending = m_requests.begin();
+    for (auto request = m_requests.begin(); request != m_requests.end(); ++request)
+    {
+        if (request->fenceValue == 0 || request->fenceValue > completedFenceValue)
+        {
+            if (pending != request)
+            {
+                *pending = std::move(*request);
+            }
+            ++pending;
+            continue;
+        }
+
+        if (request->callback)
+        {
+            request->callback({request->buffer.mappedData, request->rowSize, request->numRows, request->rowPitch});
+        }
+        else
+        {
+            Result result = {std::vector<std::byte>(size_t(request->rowSize) * request->numRows), request->rowSize, request->numRows};
+            for (uint32_t row = 0; row < request->numRows; row++)
+            {
+                std::memcpy(result.data.data() + size_t(row) * request->rowSize, request->buffer.mappedData + size_t(row) * request->rowPitch, request->rowSize);
+            }
+            request->promise->set_value(std::move(result));
+        }
+        ReleaseBuffer(request->buffer);
+    }
+
+    m_requests.erase(pending, m_requests.end());
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include <vector>
+
+class CommandQueue;
+
+// Copies GPU data back to the CPU without blocking. Copies are recorded into a
+// command list of the given queue, into persistently mapped READBACK buffers
+// pooled by power-of-two size class. Once the fence value passed to Submit has
+// completed, Update copies the data out, fulfills the futures and returns the
+// buffers to the pool. Not thread-safe, the futures may be read anywhere.
+//
+// The overloads taking a callback hand it the mapped data instead. They do not
+// allocate once the pools have warmed up, for readbacks made every frame.
+class ReadbackService
+{
+public:
+    struct Result
+    {
+        // Rows are tightly packed, buffers and query data are a single row.
+        std::vector<std::byte> data;
+        uint32_t rowSize;
+        uint32_t numRows;
+    };
+
+    // Mapped data of a completed readback, valid during the callback only.
+    struct View
+    {
+        const std::byte *data;
+        uint32_t rowSize;
+        uint32_t numRows;
+        uint32_t rowPitch;
+    };
+
+    // Called from Update. Keep captures small, so that they are stored without allocating.
+    using Callback = std::function<void(const View &view)>;
+
+    ReadbackService(Microsoft::WRL::ComPtr<ID3D12Device2> device, std::shared_ptr<CommandQueue> commandQueue);
+    ~ReadbackService();
+
+    ReadbackService(const ReadbackService &) = delete;
+    ReadbackService(ReadbackService &&) = delete;
+    ReadbackService &operator=(const ReadbackService &) = delete;
+    ReadbackService &operator=(ReadbackService &&) = delete;
+
+    // The sources are transitioned to COPY_SOURCE with the command list's
+    // resource state tracker.
+    std::future<Result> ReadbackBuffer(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList, ID3D12Resource *source, uint64_t offset, uint64_t size);
+    std::future<Result> ReadbackTexture(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList, ID3D12Resource *source, UINT subresource = 0);
+    std::future<Result> ResolveQueryData(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList, ID3D12QueryHeap *queryHeap, D3D12_QUERY_TYPE type, UINT startIndex, UINT numQueries);
+
+    void ReadbackBuffer(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList, ID3D12Resource *source, uint64_t offset, uint64_t size, Callback callback);
+    void ReadbackTexture(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList, ID3D12Resource *source, UINT subresource, Callback callback);
+    void ResolveQueryData(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList, ID3D12QueryHeap *queryHeap, D3D12_QUERY_TYPE type, UINT startIndex, UINT numQueries, Callback callback);
+
+    // Call after executing the command lists holding the readbacks recorded
+    // since the last submit, with the fence value returned for them.
+    void Submit(uint64_t fenceValue);
+
+    // Fulfill the futures and call the callbacks of the readbacks that have
+    // completed, in the order they were recorded. Call once per frame.
+    void Update();
+
+    size_t GetNumPending() const { return m_requests.size(); }
+    size_t GetNumBuffers() const { return m_numBuffers; }
+    size_t GetNumBufferReuses() const { return m_numBufferReuses; }
+
+private:
+    // Buffers smaller than the 64 KB resource granularity would waste the rest.
+    static constexpr uint32_t s_minSizeClassBits = 16;
+    // Free buffers kept per size class, more are released.
+    static constexpr size_t s_maxFreeBuffersPerSizeClass = 4;
+
+    struct Buffer
+    {
+        Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+        const std::byte *mappedData;
+        uint32_t sizeClass;
+    };
+
+    struct Request
+    {
+        Buffer buffer;
+        // Zero until the command list recording the copy is submitted.
+        uint64_t fenceValue;
+        uint32_t rowSize;
+        uint32_t numRows;
+        uint32_t rowPitch;
+        // Set for the overloads returning a future, the others take the callback.
+        std::optional<std::promise<Result>> promise;
+        Callback callback;
+    };
+
+    // Record the copy into a pooled buffer and add its request, without a promise or callback.
+    Request &RecordBufferCopy(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList, ID3D12Resource *source, uint64_t offset, uint64_t size);
+    Request &RecordTextureCopy(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList, ID3D12Resource *source, UINT subresource);
+    Request &RecordQueryResolve(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> &commandList, ID3D12QueryHeap *queryHeap, D3D12_QUERY_TYPE type, UINT startIndex, UINT numQueries);
+
+    Buffer AcquireBuffer(uint64_t size);
+    void ReleaseBuffer(Buffer &buffer);
+    Request &AddRequest(Buffer &buffer, uint32_t rowSize, uint32_t numRows, uint32_t rowPitch);
+    static std::future<Result> AddPromise(Request &request);
+
+    Microsoft::WRL::ComPtr<ID3D12Device2> m_device;
+    std::shared_ptr<CommandQueue> m_commandQueue;
+
+    // Indexed by size class.
+    std::vector<std::vector<Buffer>> m_freeBuffers;
+    std::vector<Request> m_requests;
+
+    size_t m_numBuffers = 0;
+    size_t m_numBufferReuses = 0;
+};
@@ -0,0 +1,168 @@
+#include "RenderCommandStream.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+    size_t AlignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+template <typename Packet>
+void RenderCommandStream::Write(CommandType type, const Packet &packet, const void *data, size_t dataSize)
+{
+    size_t offset = m_data.size();
+    size_t size = AlignUp(sizeof(PacketHeader) + sizeof(Packet) + dataSize, s_packetAlignment);
+    assert(size <= UINT16_MAX && offset + size <= UINT32_MAX);
+
+    // Growing keeps the capacity, a stream that is reset every frame stops allocating.
+    m_data.resize(offset + size);
+    PacketHeader header = {type, static_cast<uint16_t>(size)};
+    std::memcpy(m_data.data() + offset, &header, sizeof(header));
+    std::memcpy(m_data.data() + offset + sizeof(header), &packet, sizeof(packet));
+    if (dataSize > 0)
+    {
+        std::memcpy(m_data.data() + offset + sizeof(header) + sizeof(packet), data, dataSize);
+    }
+
+    m_numPackets++;
+}
+
+void RenderCommandStream::SetPipeline(PipelineHandle pipeline)
+{
+    Write(CommandType::SetPipeline, SetPipelinePacket{pipeline});
+}
+
+void RenderCommandStream::SetVertexBuffer(uint32_t slot, uint64_t address, uint32_t size, uint32_t stride)
+{
+    assert(slot < s_maxVertexBuffers);
+    Write(CommandType::SetVertexBuffer, SetVertexBufferPacket{slot, stride, address, size});
+}
+
+void RenderCommandStream::SetIndexBuffer(uint64_t address, uint32_t size, uint32_t indexSize)
+{
+    assert(indexSize == 2 || indexSize == 4);
+    Write(CommandType::SetIndexBuffer, SetIndexBufferPacket{address, size, indexSize});
+}
+
+void RenderCommandStream::SetRootConstants(uint32_t rootParameterIndex, const void *values, uint32_t numValues)
+{
+    assert(rootParameterIndex < s_maxRootConstantParameters && numValues <= s_maxRootConstants);
+    Write(CommandType::SetRootConstants, SetRootConstantsPacket{rootParameterIndex, numValues}, values, numValues * sizeof(uint32_t));
+}
+
+void RenderCommandStream::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance)
+{
+    Write(CommandType::DrawIndexedInstanced, DrawIndexedInstancedPacket{indexCount, instanceCount, firstIndex, baseVertex, firstInstance});
+    m_numDraws++;
+}
+
+void RenderCommandStream::Barrier(ResourceHandle resource, ResourceState stateAfter)
+{
+    Write(CommandType::Barrier, BarrierPacket{resource, stateAfter});
+}
+
+void RenderCommandStream::Reset()
+{
+    m_data.clear();
+    m_numPackets = 0;
+    m_numDraws = 0;
+    m_sortedCommands.clear();
+}
+
+void RenderCommandStream::Sort()
+{
+    SortedCommand state = {};
+    state.pipelineOffset = s_none;
+    state.vertexBufferOffsets.fill(s_none);
+    state.indexBufferOffset = s_none;
+    state.rootConstantsOffsets.fill(s_none);
+
+    // Follow the state set by the packets, every draw takes a copy of it.
+    m_sortEntries.clear();
+    uint32_t segment = 0;
+    for (uint32_t offset = 0; offset < m_data.size(); offset += GetHeader(offset).size)
+    {
+        switch (GetHeader(offset).type)
+        {
+        case CommandType::SetPipeline:
+            state.pipelineOffset = offset;
+            break;
+        case CommandType::SetVertexBuffer:
+            state.vertexBufferOffsets[GetPacket<SetVertexBufferPacket>(offset).slot] = offset;
+            break;
+        case CommandType::SetIndexBuffer:
+            state.indexBufferOffset = offset;
+            break;
+        case CommandType::SetRootConstants:
+            state.rootConstantsOffsets[GetPacket<SetRootConstantsPacket>(offset).rootParameterIndex] = offset;
+            break;
+        case CommandType::DrawIndexedInstanced:
+        {
+            SortEntry entry = {segment, 1, s_none, 0, 0, state};
+            entry.command.offset = offset;
+            if (state.pipelineOffset != s_none)
+            {
+                entry.pipeline = GetPacket<SetPipelinePacket>(state.pipelineOffset).pipeline;
+            }
+            if (state.vertexBufferOffsets[0] != s_none)
+            {
+                entry.vertexBufferAddress = GetPacket<SetVertexBufferPacket>(state.vertexBufferOffsets[0]).address;
+            }
+            if (state.indexBufferOffset != s_none)
+            {
+                entry.indexBufferAddress = GetPacket<SetIndexBufferPacket>(state.indexBufferOffset).address;
+            }
+            m_sortEntries.push_back(entry);
+            break;
+        }
+        case CommandType::Barrier:
+        {
+            segment++;
+            SortEntry entry = {segment, 0, s_none, 0, 0, {}};
+            entry.command = {offset, s_none, {}, s_none, {}};
+            entry.command.vertexBufferOffsets.fill(s_none);
+            entry.command.rootConstantsOffsets.fill(s_none);
+            m_sortEntries.push_back(entry);
+            break;
+        }
+        default:
+            assert(false && "Invalid render command.");
+        }
+    }
+
+    // The packet offset makes the order total, so recording order is kept among
+    // equal state without the temporary buffer std::stable_sort allocates.
+    std::sort(m_sortEntries.begin(), m_sortEntries.end(), [](const SortEntry &a, const SortEntry &b)
+              {
+                  if (a.segment != b.segment)
+                  {
+                      return a.segment < b.segment;
+                  }
+                  if (a.rank != b.rank)
+                  {
+                      return a.rank < b.rank;
+                  }
+                  if (a.pipeline != b.pipeline)
+                  {
+                      return a.pipeline < b.pipeline;
+                  }
+                  if (a.vertexBufferAddress != b.vertexBufferAddress)
+                  {
+                      return a.vertexBufferAddress < b.vertexBufferAddress;
+                  }
+                  if (a.indexBufferAddress != b.indexBufferAddress)
+                  {
+                      return a.indexBufferAddress < b.indexBufferAddress;
+                  }
+                  return a.command.offset < b.command.offset; });
+
+    m_sortedCommands.clear();
+    for (const SortEntry &entry : m_sortEntries)
+    {
+        m_sortedCommands.push_back(entry.command);
+    }
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Engine level render commands recorded as POD packets into linear memory,
+// without touching a graphics API. Every recording thread fills a stream of its
+// own. Sort then orders the draws by the state they need, pipeline first, so
+// that a backend such as RenderCommandTranslator only emits the state changes
+// between neighbouring draws. Barriers keep their place: draws are only
+// reordered between two barriers. Pipelines and resources are handles the
+// backend resolves, buffers are bound by GPU address. Platform independent,
+// not thread-safe.
+class RenderCommandStream
+{
+public:
+    using PipelineHandle = uint32_t;
+    using ResourceHandle = uint32_t;
+
+    static constexpr uint32_t s_maxVertexBuffers = 4;
+    static constexpr uint32_t s_maxRootConstantParameters = 4;
+    // Root signatures hold at most 64 32-bit values.
+    static constexpr uint32_t s_maxRootConstants = 64;
+    static constexpr uint32_t s_none = UINT32_MAX;
+
+    enum class CommandType : uint16_t
+    {
+        SetPipeline,
+        SetVertexBuffer,
+        SetIndexBuffer,
+        SetRootConstants,
+        DrawIndexedInstanced,
+        Barrier
+    };
+
+    enum class ResourceState : uint32_t
+    {
+        Common,
+        VertexAndConstantBuffer,
+        IndexBuffer,
+        RenderTarget,
+        UnorderedAccess,
+        DepthWrite,
+        ShaderResource,
+        CopySource,
+        CopyDest
+    };
+
+    // Every packet starts with a header, its size includes the header and any
+    // data following the packet struct.
+    struct PacketHeader
+    {
+        CommandType type;
+        uint16_t size;
+    };
+
+    struct SetPipelinePacket
+    {
+        PipelineHandle pipeline;
+    };
+
+    struct SetVertexBufferPacket
+    {
+        uint32_t slot;
+        uint32_t stride;
+        uint64_t address;
+        uint32_t size;
+    };
+
+    struct SetIndexBufferPacket
+    {
+        uint64_t address;
+        uint32_t size;
+        // 2 or 4.
+        uint32_t indexSize;
+    };
+
+    // Followed by numValues 32-bit values.
+    struct SetRootConstantsPacket
+    {
+        uint32_t rootParameterIndex;
+        uint32_t numValues;
+    };
+
+    struct DrawIndexedInstancedPacket
+    {
+        uint32_t indexCount;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        int32_t baseVertex;
+        uint32_t firstInstance;
+    };
+
+    struct BarrierPacket
+    {
+        ResourceHandle resource;
+        ResourceState stateAfter;
+    };
+
+    // A draw or barrier in sorted order. Draws carry the offsets of the packets
+    // that set the state they are drawn with, s_none for state never set.
+    struct SortedCommand
+    {
+        uint32_t offset;
+        uint32_t pipelineOffset;
+        std::array<uint32_t, s_maxVertexBuffers> vertexBufferOffsets;
+        uint32_t indexBufferOffset;
+        std::array<uint32_t, s_maxRootConstantParameters> rootConstantsOffsets;
+    };
+
+    RenderCommandStream() = default;
+
+    RenderCommandStream(const RenderCommandStream &) = delete;
+    RenderCommandStream(RenderCommandStream &&) = delete;
+    RenderCommandStream &operator=(const RenderCommandStream &) = delete;
+    RenderCommandStream &operator=(RenderCommandStream &&) = delete;
+
+    void SetPipeline(PipelineHandle pipeline);
+    void SetVertexBuffer(uint32_t slot, uint64_t address, uint32_t size, uint32_t stride);
+    void SetIndexBuffer(uint64_t address, uint32_t size, uint32_t indexSize);
+    void SetRootConstants(uint32_t rootParameterIndex, const void *values, uint32_t numValues);
+    void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance);
+    void Barrier(ResourceHandle resource, ResourceState stateAfter);
+
+    // Forget the packets, keeping the memory for the next recording.
+    void Reset();
+
+    // Order the draws by pipeline, vertex buffer and index buffer between
+    // barriers, keeping the recording order among equal state. Reads the packets
+    // again after new ones were recorded.
+    void Sort();
+    const std::vector<SortedCommand> &GetSortedCommands() const { return m_sortedCommands; }
+
+    PacketHeader GetHeader(uint32_t offset) const { return Read<PacketHeader>(offset); }
+
+    // The packet struct following the header at offset.
+    template <typename Packet>
+    Packet GetPacket(uint32_t offset) const
+    {
+        return Read<Packet>(offset + static_cast<uint32_t>(sizeof(PacketHeader)));
+    }
+
+    // The root constant values of the SetRootConstants packet at offset.
+    const std::byte *GetRootConstantValues(uint32_t offset) const { return m_data.data() + offset + sizeof(PacketHeader) + sizeof(SetRootConstantsPacket); }
+
+    size_t GetSize() const { return m_data.size(); }
+    size_t GetNumPackets() const { return m_numPackets; }
+    size_t GetNumDraws() const { return m_numDraws; }
+
+private:
+    // Packets are padded to this, the size of the root constant values.
+    static constexpr size_t s_packetAlignment = 4;
+
+    struct SortEntry
+    {
+        // Barriers seen before the command, draws never cross one.
+        uint32_t segment;
+        // Barriers go ahead of the draws of their segment.
+        uint32_t rank;
+        PipelineHandle pipeline;
+        uint64_t vertexBufferAddress;
+        uint64_t indexBufferAddress;
+        SortedCommand command;
+    };
+
+    template <typename Packet>
+    void Write(CommandType type, const Packet &packet, const void *data = nullptr, size_t dataSize = 0);
+
+    // Packets are read with memcpy, their 64-bit fields are not necessarily aligned.
+    template <typename T>
+    T Read(uint32_t offset) const
+    {
+        T value;
+        std::memcpy(&value, m_data.data() + offset, sizeof(T));
+        return value;
+    }
+
+    std::vector<std::byte> m_data;
+    size_t m_numPackets = 0;
+    size_t m_numDraws = 0;
+    std::vector<SortedCommand> m_sortedCommands;
+    std::vector<SortEntry> m_sortEntries;
+};
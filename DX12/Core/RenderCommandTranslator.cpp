@@ -0,0 +1,212 @@
+#include "RenderCommandTranslator.h"
+
+#include "ResourceStateTracker.h"
+
+#include <cassert>
+#include <cstring>
+
+using namespace Microsoft::WRL;
+
+namespace
+{
+    D3D12_RESOURCE_STATES GetD3D12ResourceState(RenderCommandStream::ResourceState state)
+    {
+        switch (state)
+        {
+        case RenderCommandStream::ResourceState::Common:
+            return D3D12_RESOURCE_STATE_COMMON;
+        case RenderCommandStream::ResourceState::VertexAndConstantBuffer:
+            return D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+        case RenderCommandStream::ResourceState::IndexBuffer:
+            return D3D12_RESOURCE_STATE_INDEX_BUFFER;
+        case RenderCommandStream::ResourceState::RenderTarget:
+            return D3D12_RESOURCE_STATE_RENDER_TARGET;
+        case RenderCommandStream::ResourceState::UnorderedAccess:
+            return D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+        case RenderCommandStream::ResourceState::DepthWrite:
+            return D3D12_RESOURCE_STATE_DEPTH_WRITE;
+        case RenderCommandStream::ResourceState::ShaderResource:
+            return D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE;
+        case RenderCommandStream::ResourceState::CopySource:
+            return D3D12_RESOURCE_STATE_COPY_SOURCE;
+        case RenderCommandStream::ResourceState::CopyDest:
+            return D3D12_RESOURCE_STATE_COPY_DEST;
+        default:
+            assert(false && "Invalid resource state.");
+            return D3D12_RESOURCE_STATE_COMMON;
+        }
+    }
+
+    bool IsSameView(const D3D12_VERTEX_BUFFER_VIEW &a, const D3D12_VERTEX_BUFFER_VIEW &b)
+    {
+        return a.BufferLocation == b.BufferLocation && a.SizeInBytes == b.SizeInBytes && a.StrideInBytes == b.StrideInBytes;
+    }
+
+    bool IsSameView(const D3D12_INDEX_BUFFER_VIEW &a, const D3D12_INDEX_BUFFER_VIEW &b)
+    {
+        return a.BufferLocation == b.BufferLocation && a.SizeInBytes == b.SizeInBytes && a.Format == b.Format;
+    }
+
+    // What was last emitted into the command list.
+    struct EmittedState
+    {
+        RenderCommandStream::PipelineHandle pipeline = RenderCommandStream::s_none;
+        ID3D12RootSignature *rootSignature = nullptr;
+        D3D_PRIMITIVE_TOPOLOGY topology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+        std::array<D3D12_VERTEX_BUFFER_VIEW, RenderCommandStream::s_maxVertexBuffers> vertexBufferViews = {};
+        D3D12_INDEX_BUFFER_VIEW indexBufferView = {};
+        // Offsets of the SetRootConstants packets emitted, s_none for none.
+        std::array<uint32_t, RenderCommandStream::s_maxRootConstantParameters> rootConstantsOffsets;
+    };
+}
+
+RenderCommandStream::PipelineHandle RenderCommandTranslator::RegisterPipeline(ComPtr<ID3D12PipelineState> pipelineState, ComPtr<ID3D12RootSignature> rootSignature, D3D_PRIMITIVE_TOPOLOGY topology)
+{
+    m_pipelines.push_back({pipelineState, rootSignature, topology});
+    return static_cast<RenderCommandStream::PipelineHandle>(m_pipelines.size() - 1);
+}
+
+RenderCommandStream::ResourceHandle RenderCommandTranslator::RegisterResource(ComPtr<ID3D12Resource> resource)
+{
+    m_resources.push_back(resource);
+    return static_cast<RenderCommandStream::ResourceHandle>(m_resources.size() - 1);
+}
+
+void RenderCommandTranslator::UpdateResource(RenderCommandStream::ResourceHandle handle, ComPtr<ID3D12Resource> resource)
+{
+    assert(handle < m_resources.size());
+    m_resources[handle] = resource;
+}
+
+void RenderCommandTranslator::Translate(const RenderCommandStream &stream, ID3D12GraphicsCommandList2 *commandList, ResourceStateTracker *resourceStateTracker, ID3D12RootSignature *boundRootSignature) const
+{
+    EmittedState emitted;
+    emitted.rootSignature = boundRootSignature;
+    emitted.rootConstantsOffsets.fill(RenderCommandStream::s_none);
+
+    uint64_t numDraws = 0;
+    uint64_t numStateChanges = 0;
+    uint64_t numRedundantStates = 0;
+    bool hasBarriers = false;
+
+    for (const RenderCommandStream::SortedCommand &command : stream.GetSortedCommands())
+    {
+        if (stream.GetHeader(command.offset).type == RenderCommandStream::CommandType::Barrier)
+        {
+            assert(resourceStateTracker && "Bundles cannot have barriers.");
+            RenderCommandStream::BarrierPacket barrier = stream.GetPacket<RenderCommandStream::BarrierPacket>(command.offset);
+            assert(barrier.resource < m_resources.size());
+            resourceStateTracker->TransitionResource(m_resources[barrier.resource].Get(), GetD3D12ResourceState(barrier.stateAfter));
+            hasBarriers = true;
+            continue;
+        }
+
+        // Barriers queued since the last draw are issued in one call.
+        if (hasBarriers)
+        {
+            resourceStateTracker->FlushResourceBarriers(commandList);
+            hasBarriers = false;
+        }
+
+        assert(command.pipelineOffset != RenderCommandStream::s_none && "Draw without a pipeline.");
+        RenderCommandStream::PipelineHandle pipelineHandle = stream.GetPacket<RenderCommandStream::SetPipelinePacket>(command.pipelineOffset).pipeline;
+        if (pipelineHandle != emitted.pipeline)
+        {
+            assert(pipelineHandle < m_pipelines.size());
+            const Pipeline &pipeline = m_pipelines[pipelineHandle];
+            if (pipeline.rootSignature.Get() != emitted.rootSignature)
+            {
+                // Root arguments do not survive a root signature change.
+                commandList->SetGraphicsRootSignature(pipeline.rootSignature.Get());
+                emitted.rootSignature = pipeline.rootSignature.Get();
+                emitted.rootConstantsOffsets.fill(RenderCommandStream::s_none);
+                numStateChanges++;
+            }
+            commandList->SetPipelineState(pipeline.pipelineState.Get());
+            numStateChanges++;
+            if (pipeline.topology != emitted.topology)
+            {
+                commandList->IASetPrimitiveTopology(pipeline.topology);
+                emitted.topology = pipeline.topology;
+                numStateChanges++;
+            }
+            emitted.pipeline = pipelineHandle;
+        }
+        else
+        {
+            numRedundantStates++;
+        }
+
+        for (uint32_t slot = 0; slot < RenderCommandStream::s_maxVertexBuffers; slot++)
+        {
+            if (command.vertexBufferOffsets[slot] == RenderCommandStream::s_none)
+            {
+                continue;
+            }
+
+            RenderCommandStream::SetVertexBufferPacket vertexBuffer = stream.GetPacket<RenderCommandStream::SetVertexBufferPacket>(command.vertexBufferOffsets[slot]);
+            D3D12_VERTEX_BUFFER_VIEW view = {vertexBuffer.address, vertexBuffer.size, vertexBuffer.stride};
+            if (IsSameView(view, emitted.vertexBufferViews[slot]))
+            {
+                numRedundantStates++;
+                continue;
+            }
+            commandList->IASetVertexBuffers(slot, 1, &view);
+            emitted.vertexBufferViews[slot] = view;
+            numStateChanges++;
+        }
+
+        if (command.indexBufferOffset != RenderCommandStream::s_none)
+        {
+            RenderCommandStream::SetIndexBufferPacket indexBuffer = stream.GetPacket<RenderCommandStream::SetIndexBufferPacket>(command.indexBufferOffset);
+            D3D12_INDEX_BUFFER_VIEW view = {indexBuffer.address, indexBuffer.size, indexBuffer.indexSize == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT};
+            if (IsSameView(view, emitted.indexBufferView))
+            {
+                numRedundantStates++;
+            }
+            else
+            {
+                commandList->IASetIndexBuffer(&view);
+                emitted.indexBufferView = view;
+                numStateChanges++;
+            }
+        }
+
+        for (uint32_t parameter = 0; parameter < RenderCommandStream::s_maxRootConstantParameters; parameter++)
+        {
+            uint32_t offset = command.rootConstantsOffsets[parameter];
+            if (offset == RenderCommandStream::s_none)
+            {
+                continue;
+            }
+
+            // Equal values set by another packet are redundant too.
+            RenderCommandStream::SetRootConstantsPacket rootConstants = stream.GetPacket<RenderCommandStream::SetRootConstantsPacket>(offset);
+            uint32_t emittedOffset = emitted.rootConstantsOffsets[parameter];
+            if (emittedOffset != RenderCommandStream::s_none &&
+                (emittedOffset == offset ||
+                 (stream.GetPacket<RenderCommandStream::SetRootConstantsPacket>(emittedOffset).numValues == rootConstants.numValues &&
+                  std::memcmp(stream.GetRootConstantValues(emittedOffset), stream.GetRootConstantValues(offset), rootConstants.numValues * sizeof(uint32_t)) == 0)))
+            {
+                numRedundantStates++;
+                continue;
+            }
+            commandList->SetGraphicsRoot32BitConstants(parameter, rootConstants.numValues, stream.GetRootConstantValues(offset), 0);
+            emitted.rootConstantsOffsets[parameter] = offset;
+            numStateChanges++;
+        }
+
+        RenderCommandStream::DrawIndexedInstancedPacket draw = stream.GetPacket<RenderCommandStream::DrawIndexedInstancedPacket>(command.offset);
+        commandList->DrawIndexedInstanced(draw.indexCount, draw.instanceCount, draw.firstIndex, draw.baseVertex, draw.firstInstance);
+        numDraws++;
+    }
+
+    if (hasBarriers)
+    {
+        resourceStateTracker->FlushResourceBarriers(commandList);
+    }
+
+    m_numDraws.fetch_add(numDraws, std::memory_order_relaxed);
+    m_numStateChanges.fetch_add(numStateChanges, std::memory_order_relaxed);
+    m_numRedundantStates.fetch_add(numRedundantStates, std::memory_order_relaxed);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "RenderCommandStream.h"
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ResourceStateTracker;
+
+// Emits the D3D12 calls of a sorted RenderCommandStream into a command list or
+// bundle. The handles of the stream index the pipelines and resources
+// registered here. State is compared with what was last emitted into the
+// command list, so draws sharing a pipeline or buffers cost no state calls.
+// Register pipelines and resources before the streams using them are
+// translated, translating runs concurrently from many threads.
+class RenderCommandTranslator
+{
+public:
+    RenderCommandTranslator() = default;
+
+    RenderCommandTranslator(const RenderCommandTranslator &) = delete;
+    RenderCommandTranslator(RenderCommandTranslator &&) = delete;
+    RenderCommandTranslator &operator=(const RenderCommandTranslator &) = delete;
+    RenderCommandTranslator &operator=(RenderCommandTranslator &&) = delete;
+
+    RenderCommandStream::PipelineHandle RegisterPipeline(Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState, Microsoft::WRL::ComPtr<ID3D12RootSignature> rootSignature, D3D_PRIMITIVE_TOPOLOGY topology);
+    RenderCommandStream::ResourceHandle RegisterResource(Microsoft::WRL::ComPtr<ID3D12Resource> resource);
+    // Point the handle at a recreated resource.
+    void UpdateResource(RenderCommandStream::ResourceHandle handle, Microsoft::WRL::ComPtr<ID3D12Resource> resource);
+
+    // Emit the commands of the stream in sorted order. boundRootSignature is
+    // the root signature the command list already has, which bundles inherit
+    // from the command list executing them. Barriers go through the resource
+    // state tracker of the command list, bundles take none and cannot have them.
+    void Translate(const RenderCommandStream &stream, ID3D12GraphicsCommandList2 *commandList, ResourceStateTracker *resourceStateTracker, ID3D12RootSignature *boundRootSignature) const;
+
+    uint64_t GetNumDraws() const { return m_numDraws.load(std::memory_order_relaxed); }
+    // State calls emitted, and state packets dropped as equal to the emitted state.
+    uint64_t GetNumStateChanges() const { return m_numStateChanges.load(std::memory_order_relaxed); }
+    uint64_t GetNumRedundantStates() const { return m_numRedundantStates.load(std::memory_order_relaxed); }
+
+private:
+    struct Pipeline
+    {
+        Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState;
+        Microsoft::WRL::ComPtr<ID3D12RootSignature> rootSignature;
+        D3D_PRIMITIVE_TOPOLOGY topology;
+    };
+
+    std::vector<Pipeline> m_pipelines;
+    std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> m_resources;
+
+    mutable std::atomic<uint64_t> m_numDraws = 0;
+    mutable std::atomic<uint64_t> m_numStateChanges = 0;
+    mutable std::atomic<uint64_t> m_numRedundantStates = 0;
+};
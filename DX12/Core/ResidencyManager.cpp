@@ -0,0 +1,78 @@
+#include "ResidencyManager.h"
+
+#include "CommandQueue.h"
+
+#include <cassert>
+
+ResidencyManager::ResidencyManager(Microsoft::WRL::ComPtr<ID3D12Device2> device, Microsoft::WRL::ComPtr<IDXGIAdapter3> adapter, std::shared_ptr<CommandQueue> commandQueue)
+    : m_device(device), m_adapter(adapter), m_commandQueue(commandQueue)
+{
+}
+
+void ResidencyManager::Track(ID3D12Pageable *pageable, uint64_t size)
+{
+    m_residencySet.Add(pageable, size, m_commandQueue->GetLastSignaledFenceValue() + 1);
+}
+
+void ResidencyManager::Untrack(ID3D12Pageable *pageable)
+{
+    m_residencySet.Remove(pageable);
+}
+
+void ResidencyManager::MarkUsed(ID3D12Pageable *pageable)
+{
+    if (m_residencySet.MarkUsed(pageable, m_commandQueue->GetLastSignaledFenceValue() + 1))
+    {
+        // Blocks until the object is resident again.
+        ID3D12Pageable *const pageables[] = {pageable};
+        assert(SUCCEEDED(m_device->MakeResident(1, pageables)));
+        m_numMakeResidents++;
+    }
+}
+
+void ResidencyManager::Update()
+{
+    DXGI_QUERY_VIDEO_MEMORY_INFO videoMemoryInfo = {};
+    assert(SUCCEEDED(m_adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &videoMemoryInfo)));
+
+    Budget budget = {videoMemoryInfo.Budget, videoMemoryInfo.CurrentUsage, videoMemoryInfo.AvailableForReservation};
+    bool budgetChanged = budget.budget != m_budget.budget;
+    m_budget = budget;
+
+    if (budgetChanged)
+    {
+        for (BudgetChangedHandler &budgetChangedHandler : m_budgetChangedHandlers)
+        {
+            budgetChangedHandler(m_budget);
+        }
+    }
+
+    if (m_budget.currentUsage <= m_budget.budget)
+    {
+        return;
+    }
+
+    // The usage reported includes memory that is not tracked here, only the
+    // tracked objects can make up for it.
+    m_evictions.clear();
+    m_residencySet.SelectEvictions(m_budget.currentUsage - m_budget.budget, m_commandQueue->GetCompletedFenceValue(), m_evictions);
+    if (m_evictions.empty())
+    {
+        return;
+    }
+
+    std::vector<ID3D12Pageable *> pageables;
+    pageables.reserve(m_evictions.size());
+    for (LruResidencySet::Key key : m_evictions)
+    {
+        pageables.push_back(static_cast<ID3D12Pageable *>(const_cast<void *>(key)));
+    }
+
+    assert(SUCCEEDED(m_device->Evict(static_cast<UINT>(pageables.size()), pageables.data())));
+    m_numEvictions += pageables.size();
+}
+
+void ResidencyManager::RegisterBudgetChangedHandler(BudgetChangedHandler budgetChangedHandler)
+{
+    m_budgetChangedHandlers.push_back(budgetChangedHandler);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "LruResidencySet.h"
+
+#include <d3d12.h>
+#include <dxgi1_6.h>
+#include <wrl.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class CommandQueue;
+
+// Keeps the tracked pageable objects within the local video memory budget the
+// OS hands out. Update polls the budget once per frame and evicts the least
+// recently used objects the GPU is done with while usage is over it, MarkUsed
+// makes an evicted object resident again before a submission uses it. Uses are
+// stamped with the next fence value of the given queue, objects used on other
+// queues have to be used there before work on this queue that waits for them.
+// Not thread-safe.
+class ResidencyManager
+{
+public:
+    struct Budget
+    {
+        uint64_t budget;
+        uint64_t currentUsage;
+        uint64_t availableForReservation;
+    };
+
+    using BudgetChangedHandler = std::function<void(const Budget &budget)>;
+
+    ResidencyManager(Microsoft::WRL::ComPtr<ID3D12Device2> device, Microsoft::WRL::ComPtr<IDXGIAdapter3> adapter, std::shared_ptr<CommandQueue> commandQueue);
+
+    ResidencyManager(const ResidencyManager &) = delete;
+    ResidencyManager(ResidencyManager &&) = delete;
+    ResidencyManager &operator=(const ResidencyManager &) = delete;
+    ResidencyManager &operator=(ResidencyManager &&) = delete;
+
+    // Objects start resident, as used by the next submission.
+    void Track(ID3D12Pageable *pageable, uint64_t size);
+    void Untrack(ID3D12Pageable *pageable);
+
+    // Call for every tracked object the next submission uses, before executing it.
+    void MarkUsed(ID3D12Pageable *pageable);
+
+    // Poll the budget, notify the handlers when it changed and evict while over it.
+    void Update();
+
+    void RegisterBudgetChangedHandler(BudgetChangedHandler budgetChangedHandler);
+
+    const Budget &GetBudget() const { return m_budget; }
+    const LruResidencySet &GetResidencySet() const { return m_residencySet; }
+    size_t GetNumEvictions() const { return m_numEvictions; }
+    size_t GetNumMakeResidents() const { return m_numMakeResidents; }
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Device2> m_device;
+    Microsoft::WRL::ComPtr<IDXGIAdapter3> m_adapter;
+    std::shared_ptr<CommandQueue> m_commandQueue;
+
+    LruResidencySet m_residencySet;
+    std::vector<LruResidencySet::Key> m_evictions;
+
+    Budget m_budget = {};
+    std::vector<BudgetChangedHandler> m_budgetChangedHandlers;
+
+    size_t m_numEvictions = 0;
+    size_t m_numMakeResidents = 0;
+};
@@ -0,0 +1,130 @@
+#include "ResourceStateTracker.h"
+
+#pragma warning(push)
+#pragma warning(disable : 4365)
+#pragma warning(disable : 4626)
+#include "directx/d3dx12.h"
+#pragma warning(pop)
+
+#include <algorithm>
+#include <cassert>
+
+std::mutex ResourceStateTracker::s_globalMutex;
+std::unordered_map<ID3D12Resource *, ResourceStateTracker::GlobalResourceState> ResourceStateTracker::s_globalResourceStates;
+std::vector<ID3D12Resource *> ResourceStateTracker::s_committedResources;
+std::atomic<uint64_t> ResourceStateTracker::s_numBarriers = 0;
+std::atomic<uint64_t> ResourceStateTracker::s_numBarrierCalls = 0;
+
+void ResourceStateTracker::TransitionResource(ID3D12Resource *resource, D3D12_RESOURCE_STATES stateAfter)
+{
+    auto finalState = std::find_if(m_finalResourceStates.begin(), m_finalResourceStates.end(), [resource](const std::pair<ID3D12Resource *, D3D12_RESOURCE_STATES> &entry)
+                                   { return entry.first == resource; });
+    if (finalState == m_finalResourceStates.end())
+    {
+        // First use in this command list.
+        m_pendingResourceBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, D3D12_RESOURCE_STATE_COMMON, stateAfter));
+        m_finalResourceStates.push_back({resource, stateAfter});
+        return;
+    }
+
+    if (finalState->second == stateAfter)
+    {
+        return;
+    }
+
+    m_resourceBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, finalState->second, stateAfter));
+    finalState->second = stateAfter;
+}
+
+void ResourceStateTracker::UAVBarrier(ID3D12Resource *resource)
+{
+    m_resourceBarriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(resource));
+}
+
+void ResourceStateTracker::FlushResourceBarriers(ID3D12GraphicsCommandList2 *commandList)
+{
+    if (m_resourceBarriers.empty())
+    {
+        return;
+    }
+
+    commandList->ResourceBarrier(static_cast<UINT>(m_resourceBarriers.size()), m_resourceBarriers.data());
+    CountBarrierCall(m_resourceBarriers.size());
+    m_resourceBarriers.clear();
+}
+
+void ResourceStateTracker::ResolvePendingResourceBarriers(std::vector<D3D12_RESOURCE_BARRIER> &barriers) const
+{
+    for (D3D12_RESOURCE_BARRIER barrier : m_pendingResourceBarriers)
+    {
+        auto globalState = s_globalResourceStates.find(barrier.Transition.pResource);
+        assert(globalState != s_globalResourceStates.end() && "Resource state not registered.");
+
+        // Already in the state the command list starts with.
+        if (globalState->second.state == barrier.Transition.StateAfter)
+        {
+            continue;
+        }
+
+        barrier.Transition.StateBefore = globalState->second.state;
+        barriers.push_back(barrier);
+    }
+}
+
+void ResourceStateTracker::CommitFinalResourceStates()
+{
+    for (const auto &[resource, state] : m_finalResourceStates)
+    {
+        auto globalState = s_globalResourceStates.find(resource);
+        assert(globalState != s_globalResourceStates.end() && "Resource state not registered.");
+        globalState->second.state = state;
+        s_committedResources.push_back(resource);
+    }
+}
+
+void ResourceStateTracker::DecayGlobalResourceStates(bool copyQueue)
+{
+    for (ID3D12Resource *resource : s_committedResources)
+    {
+        GlobalResourceState &globalState = s_globalResourceStates.find(resource)->second;
+        if (copyQueue || globalState.decaysToCommon)
+        {
+            globalState.state = D3D12_RESOURCE_STATE_COMMON;
+        }
+    }
+    s_committedResources.clear();
+}
+
+void ResourceStateTracker::Reset()
+{
+    assert(m_resourceBarriers.empty() && "Resource barriers were not flushed.");
+    m_resourceBarriers.clear();
+    m_pendingResourceBarriers.clear();
+    m_finalResourceStates.clear();
+}
+
+std::unique_lock<std::mutex> ResourceStateTracker::LockGlobalResourceStates()
+{
+    return std::unique_lock<std::mutex>(s_globalMutex);
+}
+
+void ResourceStateTracker::AddGlobalResourceState(ID3D12Resource *resource, D3D12_RESOURCE_STATES state)
+{
+    D3D12_RESOURCE_DESC desc = resource->GetDesc();
+    bool decaysToCommon = desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER || (desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_SIMULTANEOUS_ACCESS) != 0;
+
+    std::lock_guard<std::mutex> lock(s_globalMutex);
+    s_globalResourceStates[resource] = {state, decaysToCommon};
+}
+
+void ResourceStateTracker::RemoveGlobalResourceState(ID3D12Resource *resource)
+{
+    std::lock_guard<std::mutex> lock(s_globalMutex);
+    s_globalResourceStates.erase(resource);
+}
+
+void ResourceStateTracker::CountBarrierCall(size_t numBarriers)
+{
+    s_numBarriers.fetch_add(numBarriers, std::memory_order_relaxed);
+    s_numBarrierCalls.fetch_add(1, std::memory_order_relaxed);
+}
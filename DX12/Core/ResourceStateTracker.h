@@ -0,0 +1,103 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Tracks resource states within a command list so callers only name the state
+// they need. The first transition of a resource in a command list cannot know
+// the state it starts in, it stays pending until the command list is executed
+// and is then resolved against the global state left by the command lists
+// executed before. Transitions are queued and issued in a single ResourceBarrier
+// call on flush, transitions to the current state are dropped. States are
+// tracked per resource, not per subresource.
+//
+// Buffers and simultaneous-access textures decay to COMMON once the command
+// lists of an ExecuteCommandLists call complete, as does every resource used on
+// a copy queue, and their global state follows. Other textures keep their
+// state, and must only be used on a single queue since the global states
+// follow the order of submission, not of completion on the GPU.
+class ResourceStateTracker
+{
+public:
+    ResourceStateTracker() = default;
+
+    ResourceStateTracker(const ResourceStateTracker &) = delete;
+    ResourceStateTracker(ResourceStateTracker &&) = delete;
+    ResourceStateTracker &operator=(const ResourceStateTracker &) = delete;
+    ResourceStateTracker &operator=(ResourceStateTracker &&) = delete;
+
+    // Queue a transition of the resource to stateAfter.
+    void TransitionResource(ID3D12Resource *resource, D3D12_RESOURCE_STATES stateAfter);
+
+    // Queue a UAV barrier, for a null resource between all UAV accesses.
+    void UAVBarrier(ID3D12Resource *resource = nullptr);
+
+    // Issue the queued barriers. Call before recording commands that depend on them.
+    void FlushResourceBarriers(ID3D12GraphicsCommandList2 *commandList);
+
+    // Append the barriers that move the resources with a pending transition from
+    // their global state to the state this command list expects. Requires the
+    // global state lock.
+    void ResolvePendingResourceBarriers(std::vector<D3D12_RESOURCE_BARRIER> &barriers) const;
+
+    // Record the final states of this command list as the global states.
+    // Requires the global state lock.
+    void CommitFinalResourceStates();
+
+    // Return the resources committed since the last call that decay to COMMON
+    // to that state. Call once per ExecuteCommandLists call, after committing
+    // every command list it executes, decay does not happen between them. On a
+    // copy queue every resource decays. Requires the global state lock.
+    static void DecayGlobalResourceStates(bool copyQueue);
+
+    // Forget every state, for a command list being reused.
+    void Reset();
+
+    bool HasPendingResourceBarriers() const { return !m_pendingResourceBarriers.empty(); }
+
+    // Held from resolving the pending barriers of a command list until its final
+    // states are committed, so command lists executed concurrently do not interleave.
+    static std::unique_lock<std::mutex> LockGlobalResourceStates();
+
+    // Resources must be registered with their initial state before they are
+    // transitioned, and removed before they are released.
+    static void AddGlobalResourceState(ID3D12Resource *resource, D3D12_RESOURCE_STATES state);
+    static void RemoveGlobalResourceState(ID3D12Resource *resource);
+
+    // Barriers issued and ResourceBarrier calls made by every command list, for statistics.
+    static uint64_t GetNumBarriers() { return s_numBarriers.load(std::memory_order_relaxed); }
+    static uint64_t GetNumBarrierCalls() { return s_numBarrierCalls.load(std::memory_order_relaxed); }
+    static void CountBarrierCall(size_t numBarriers);
+
+private:
+    std::vector<D3D12_RESOURCE_BARRIER> m_resourceBarriers;
+    // Transitions whose before state is only known at submit time, stateAfter is valid.
+    std::vector<D3D12_RESOURCE_BARRIER> m_pendingResourceBarriers;
+    // State of each resource once the barriers recorded so far have executed.
+    // A command list touches a handful of resources, they are searched linearly
+    // and the vector keeps its capacity across resets so recording never allocates.
+    std::vector<std::pair<ID3D12Resource *, D3D12_RESOURCE_STATES>> m_finalResourceStates;
+
+    struct GlobalResourceState
+    {
+        D3D12_RESOURCE_STATES state;
+        // Buffers and simultaneous-access textures.
+        bool decaysToCommon;
+    };
+
+    static std::mutex s_globalMutex;
+    static std::unordered_map<ID3D12Resource *, GlobalResourceState> s_globalResourceStates;
+    // Resources committed since the last decay.
+    static std::vector<ID3D12Resource *> s_committedResources;
+
+    static std::atomic<uint64_t> s_numBarriers;
+    static std::atomic<uint64_t> s_numBarrierCalls;
+};
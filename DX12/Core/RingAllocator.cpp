@@ -0,0 +1,93 @@
+#include "RingAllocator.h"
+
+#include <bit>
+#include <cassert>
+
+namespace
+{
+    size_t AlignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+RingAllocator::RingAllocator(size_t capacity)
+    : m_capacity(capacity)
+{
+}
+
+size_t RingAllocator::Allocate(size_t size, size_t alignment)
+{
+    assert(std::has_single_bit(alignment));
+
+    if (m_usedBytes == 0)
+    {
+        // Nothing is in flight, start over for the largest contiguous range.
+        m_head = 0;
+        m_tail = 0;
+    }
+
+    size_t offset = AlignUp(m_head, alignment);
+    if (m_usedBytes == 0 || m_head > m_tail)
+    {
+        // Free space runs from the head to the end, then from the start to the tail.
+        if (offset + size > m_capacity)
+        {
+            if (size > m_tail)
+            {
+                return s_invalidOffset;
+            }
+
+            // Skip the end of the buffer, the skipped bytes are freed with this batch.
+            size_t skippedBytes = m_capacity - m_head;
+            m_usedBytes += skippedBytes;
+            m_pendingBytes += skippedBytes;
+            m_head = 0;
+            offset = 0;
+        }
+    }
+    else if (offset + size > m_tail)
+    {
+        // Free space runs from the head to the tail.
+        return s_invalidOffset;
+    }
+
+    size_t allocatedBytes = offset + size - m_head;
+    m_usedBytes += allocatedBytes;
+    m_pendingBytes += allocatedBytes;
+    m_head = offset + size;
+    if (m_head == m_capacity)
+    {
+        m_head = 0;
+    }
+    return offset;
+}
+
+void RingAllocator::Submit(uint64_t fenceValue)
+{
+    if (m_pendingBytes == 0)
+    {
+        return;
+    }
+
+    assert(m_batches.size() == m_firstBatch || m_batches.back().fenceValue <= fenceValue);
+    m_batches.push_back({fenceValue, m_head, m_pendingBytes});
+    m_pendingBytes = 0;
+}
+
+void RingAllocator::Reclaim(uint64_t completedFenceValue)
+{
+    while (m_firstBatch < m_batches.size() && m_batches[m_firstBatch].fenceValue <= completedFenceValue)
+    {
+        const Batch &batch = m_batches[m_firstBatch];
+        m_tail = batch.end;
+        m_usedBytes -= batch.size;
+        m_firstBatch++;
+    }
+
+    if (m_firstBatch == m_batches.size())
+    {
+        m_batches.clear();
+        m_firstBatch = 0;
+    }
+}
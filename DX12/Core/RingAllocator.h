@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Offset allocator for a ring buffer whose ranges are consumed by a GPU queue.
+// Allocations made between two submits form a batch. Submit tags the batch
+// with the fence value signaled after the work using it, Reclaim frees every
+// batch whose fence value has completed, oldest first. Only deals with offsets,
+// so it does not depend on D3D12.
+class RingAllocator
+{
+public:
+    static constexpr size_t s_invalidOffset = SIZE_MAX;
+
+    explicit RingAllocator(size_t capacity);
+
+    // Offset of an aligned range of size bytes, or s_invalidOffset if there is
+    // not enough contiguous free space. The alignment must be a power of two.
+    size_t Allocate(size_t size, size_t alignment);
+
+    // Close the current batch, it is freed once fenceValue has completed.
+    void Submit(uint64_t fenceValue);
+
+    // Free the submitted batches with a fence value up to completedFenceValue.
+    void Reclaim(uint64_t completedFenceValue);
+
+    size_t GetCapacity() const { return m_capacity; }
+    // Bytes in use, including alignment padding and the space skipped when wrapping around.
+    size_t GetUsedBytes() const { return m_usedBytes; }
+    // Bytes allocated since the last submit.
+    size_t GetPendingBytes() const { return m_pendingBytes; }
+    size_t GetNumSubmittedBatches() const { return m_batches.size() - m_firstBatch; }
+
+private:
+    struct Batch
+    {
+        uint64_t fenceValue;
+        // Where the next batch starts, the ring tail moves here once it is freed.
+        size_t end;
+        size_t size;
+    };
+
+    size_t m_capacity;
+    // Next allocation starts at or after the head, the oldest live range starts at the tail.
+    size_t m_head = 0;
+    size_t m_tail = 0;
+    size_t m_usedBytes = 0;
+    size_t m_pendingBytes = 0;
+
+    // Submitted batches in fence order, the freed ones before m_firstBatch are
+    // dropped once they pile up so the vector keeps its capacity.
+    std::vector<Batch> m_batches;
+    size_t m_firstBatch = 0;
+};
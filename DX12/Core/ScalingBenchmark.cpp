@@ -0,0 +1,103 @@
+#include "ScalingBenchmark.h"
+
+#include <algorithm>
+
+ScalingBenchmark::ScalingBenchmark(const Settings &settings)
+    : m_settings(settings)
+{
+    const size_t multipliers[] = {1, 2, 5};
+    for (size_t decade = 1; decade <= m_settings.maxInstances; decade *= 10)
+    {
+        for (size_t multiplier : multipliers)
+        {
+            size_t numInstances = decade * multiplier;
+            if (numInstances >= m_settings.minInstances && numInstances <= m_settings.maxInstances)
+            {
+                m_steps.push_back(numInstances);
+            }
+        }
+
+        if (decade > m_settings.maxInstances / 10)
+        {
+            break;
+        }
+    }
+
+    if (m_steps.empty())
+    {
+        m_steps.push_back(std::max<size_t>(m_settings.minInstances, 1));
+    }
+}
+
+bool ScalingBenchmark::AddFrame(size_t numInstances, const FrameSample &sample)
+{
+    if (IsComplete())
+    {
+        return false;
+    }
+
+    ++m_stepFrame;
+    if (m_stepFrame <= m_settings.warmupFrames)
+    {
+        return false;
+    }
+
+    m_accumulator.numInstances = numInstances;
+    m_accumulator.numFrames++;
+    m_accumulator.frameMs += sample.frameMs;
+    m_accumulator.maxFrameMs = std::max(m_accumulator.maxFrameMs, sample.frameMs);
+    m_accumulator.waitMs += sample.waitMs;
+    m_accumulator.cpuUpdateMs += sample.cpuUpdateMs;
+    m_accumulator.gpuUploadMs += sample.gpuUploadMs;
+    m_accumulator.uploadBytes += static_cast<double>(sample.uploadBytes);
+
+    if (m_accumulator.numFrames < m_settings.measuredFrames)
+    {
+        return false;
+    }
+
+    StepResult result = m_accumulator;
+    double numFrames = static_cast<double>(result.numFrames);
+    result.frameMs /= numFrames;
+    result.waitMs /= numFrames;
+    result.cpuUpdateMs /= numFrames;
+    result.gpuUploadMs /= numFrames;
+    result.uploadBytes /= numFrames;
+    m_results.push_back(result);
+
+    m_accumulator = {};
+    m_stepFrame = 0;
+    ++m_currentStep;
+    return true;
+}
+
+void ScalingBenchmark::WriteCsv(std::ostream &stream) const
+{
+    stream << "instances,frames,frame_ms,max_frame_ms,wait_ms,cpu_update_ms,gpu_upload_ms,upload_bytes\n";
+    for (const StepResult &result : m_results)
+    {
+        stream << result.numInstances << ',' << result.numFrames << ','
+               << result.frameMs << ',' << result.maxFrameMs << ','
+               << result.waitMs << ',' << result.cpuUpdateMs << ',' << result.gpuUploadMs << ','
+               << result.uploadBytes << '\n';
+    }
+}
+
+void ScalingBenchmark::WriteJson(std::ostream &stream) const
+{
+    stream << "[\n";
+    for (size_t i = 0; i < m_results.size(); ++i)
+    {
+        const StepResult &result = m_results[i];
+        stream << "  {\"instances\": " << result.numInstances
+               << ", \"frames\": " << result.numFrames
+               << ", \"frame_ms\": " << result.frameMs
+               << ", \"max_frame_ms\": " << result.maxFrameMs
+               << ", \"wait_ms\": " << result.waitMs
+               << ", \"cpu_update_ms\": " << result.cpuUpdateMs
+               << ", \"gpu_upload_ms\": " << result.gpuUploadMs
+               << ", \"upload_bytes\": " << result.uploadBytes
+               << (i + 1 < m_results.size() ? "},\n" : "}\n");
+    }
+    stream << "]\n";
+}
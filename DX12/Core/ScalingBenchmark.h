@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Steps the instance count through a range and averages the frame timings
+// measured at each step. Platform independent, the game feeds it one sample
+// per frame and resizes its scene whenever the step changes.
+class ScalingBenchmark
+{
+public:
+    struct Settings
+    {
+        size_t minInstances = 10'000;
+        size_t maxInstances = 10'000'000;
+        // Frames skipped after every resize, must cover the frames in flight.
+        uint32_t warmupFrames = 32;
+        uint32_t measuredFrames = 128;
+    };
+
+    struct FrameSample
+    {
+        double frameMs;
+        // Part of frameMs blocked on the GPU finishing an earlier frame.
+        double waitMs;
+        double cpuUpdateMs;
+        double gpuUploadMs;
+        size_t uploadBytes;
+    };
+
+    struct StepResult
+    {
+        size_t numInstances;
+        uint32_t numFrames;
+        double frameMs;
+        double maxFrameMs;
+        double waitMs;
+        double cpuUpdateMs;
+        double gpuUploadMs;
+        double uploadBytes;
+    };
+
+    explicit ScalingBenchmark(const Settings &settings);
+
+    bool IsComplete() const { return m_currentStep >= m_steps.size(); }
+
+    // Instance count the scene should have for the current step.
+    size_t GetTargetInstanceCount() const { return m_steps[m_currentStep]; }
+
+    // Record a frame rendered with numInstances instances.
+    // Returns true when the benchmark moved on to the next step or completed.
+    bool AddFrame(size_t numInstances, const FrameSample &sample);
+
+    const std::vector<StepResult> &GetResults() const { return m_results; }
+
+    void WriteCsv(std::ostream &stream) const;
+    void WriteJson(std::ostream &stream) const;
+
+private:
+    Settings m_settings;
+
+    // Instance counts following a 1-2-5 sequence.
+    std::vector<size_t> m_steps;
+    size_t m_currentStep = 0;
+    uint32_t m_stepFrame = 0;
+
+    StepResult m_accumulator = {};
+    std::vector<StepResult> m_results;
+};
@@ -0,0 +1,278 @@
+#include "TlsfAllocator.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+namespace
+{
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+TlsfAllocator::TlsfAllocator(uint64_t size)
+    : m_size(size)
+{
+    for (auto &freeLists : m_freeLists)
+    {
+        std::fill(std::begin(freeLists), std::end(freeLists), s_none);
+    }
+
+    if (size > 0)
+    {
+        uint32_t index = CreateBlock();
+        m_blocks[index] = {0, size, s_none, s_none, s_none, s_none, true, false};
+        InsertFreeBlock(index);
+    }
+}
+
+void TlsfAllocator::Mapping(uint64_t size, uint32_t &firstLevel, uint32_t &secondLevel)
+{
+    // Sizes below the subclass count get a bin each, larger ones are split
+    // into power-of-two classes of s_secondLevelCount bins.
+    if (size < s_secondLevelCount)
+    {
+        firstLevel = 0;
+        secondLevel = static_cast<uint32_t>(size);
+        return;
+    }
+
+    uint32_t log2 = static_cast<uint32_t>(std::bit_width(size)) - 1;
+    firstLevel = log2 - s_secondLevelBits + 1;
+    secondLevel = static_cast<uint32_t>(size >> (log2 - s_secondLevelBits)) - s_secondLevelCount;
+}
+
+uint32_t TlsfAllocator::FindFreeBlock(uint64_t size) const
+{
+    // Round up to the next bin so that every block in it is large enough.
+    if (size >= s_secondLevelCount)
+    {
+        uint32_t log2 = static_cast<uint32_t>(std::bit_width(size)) - 1;
+        uint64_t round = (uint64_t(1) << (log2 - s_secondLevelBits)) - 1;
+        if (size > UINT64_MAX - round)
+        {
+            return s_none;
+        }
+        size += round;
+    }
+
+    uint32_t firstLevel;
+    uint32_t secondLevel;
+    Mapping(size, firstLevel, secondLevel);
+
+    uint32_t secondLevelMap = m_secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+    if (secondLevelMap == 0)
+    {
+        uint64_t firstLevelMap = firstLevel + 1 < 64 ? m_firstLevelBitmap & (~uint64_t(0) << (firstLevel + 1)) : 0;
+        if (firstLevelMap == 0)
+        {
+            return s_none;
+        }
+
+        firstLevel = static_cast<uint32_t>(std::countr_zero(firstLevelMap));
+        secondLevelMap = m_secondLevelBitmaps[firstLevel];
+    }
+
+    secondLevel = static_cast<uint32_t>(std::countr_zero(secondLevelMap));
+    return m_freeLists[firstLevel][secondLevel];
+}
+
+void TlsfAllocator::InsertFreeBlock(uint32_t index)
+{
+    Block &block = m_blocks[index];
+    uint32_t firstLevel;
+    uint32_t secondLevel;
+    Mapping(block.size, firstLevel, secondLevel);
+
+    uint32_t head = m_freeLists[firstLevel][secondLevel];
+    block.isFree = true;
+    block.prevFree = s_none;
+    block.nextFree = head;
+    if (head != s_none)
+    {
+        m_blocks[head].prevFree = index;
+    }
+    m_freeLists[firstLevel][secondLevel] = index;
+
+    m_firstLevelBitmap |= uint64_t(1) << firstLevel;
+    m_secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+    m_numFreeBlocks++;
+}
+
+void TlsfAllocator::RemoveFreeBlock(uint32_t index)
+{
+    Block &block = m_blocks[index];
+    uint32_t firstLevel;
+    uint32_t secondLevel;
+    Mapping(block.size, firstLevel, secondLevel);
+
+    if (block.prevFree != s_none)
+    {
+        m_blocks[block.prevFree].nextFree = block.nextFree;
+    }
+    else
+    {
+        m_freeLists[firstLevel][secondLevel] = block.nextFree;
+    }
+    if (block.nextFree != s_none)
+    {
+        m_blocks[block.nextFree].prevFree = block.prevFree;
+    }
+
+    if (m_freeLists[firstLevel][secondLevel] == s_none)
+    {
+        m_secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+        if (m_secondLevelBitmaps[firstLevel] == 0)
+        {
+            m_firstLevelBitmap &= ~(uint64_t(1) << firstLevel);
+        }
+    }
+
+    block.isFree = false;
+    m_numFreeBlocks--;
+}
+
+void TlsfAllocator::SplitBlock(uint32_t index, uint64_t size)
+{
+    uint32_t remainder = CreateBlock();
+    Block &block = m_blocks[index];
+    m_blocks[remainder] = {block.offset + size, block.size - size, index, block.nextPhysical, s_none, s_none, false, false};
+    if (block.nextPhysical != s_none)
+    {
+        m_blocks[block.nextPhysical].prevPhysical = remainder;
+    }
+    block.nextPhysical = remainder;
+    block.size = size;
+    InsertFreeBlock(remainder);
+}
+
+TlsfAllocator::Allocation TlsfAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+    assert(std::has_single_bit(alignment));
+    size = std::max<uint64_t>(size, 1);
+
+    // Blocks usually start aligned already, try the best fitting bin first and
+    // only ask for room to align when its head does not fit.
+    uint32_t index = FindFreeBlock(size);
+    if (index != s_none && AlignUp(m_blocks[index].offset, alignment) + size > m_blocks[index].offset + m_blocks[index].size)
+    {
+        index = alignment > 1 && size <= UINT64_MAX - (alignment - 1) ? FindFreeBlock(size + alignment - 1) : s_none;
+    }
+    if (index == s_none)
+    {
+        return {0, s_invalidHandle};
+    }
+
+    RemoveFreeBlock(index);
+
+    // The padding in front becomes a free block of its own. The previous block
+    // is in use, otherwise the two would have been merged.
+    uint64_t padding = AlignUp(m_blocks[index].offset, alignment) - m_blocks[index].offset;
+    if (padding > 0)
+    {
+        uint32_t front = index;
+        SplitBlock(front, padding);
+        index = m_blocks[front].nextPhysical;
+        RemoveFreeBlock(index);
+        InsertFreeBlock(front);
+    }
+
+    if (m_blocks[index].size > size)
+    {
+        SplitBlock(index, size);
+    }
+
+    m_blocks[index].isAllocated = true;
+    m_usedBytes += m_blocks[index].size;
+    m_numAllocations++;
+    return {m_blocks[index].offset, index};
+}
+
+void TlsfAllocator::Free(Handle handle)
+{
+    assert(handle < m_blocks.size() && m_blocks[handle].isAllocated && "Double free or invalid handle.");
+
+    uint32_t index = handle;
+    m_blocks[index].isAllocated = false;
+    m_usedBytes -= m_blocks[index].size;
+    m_numAllocations--;
+
+    uint32_t prev = m_blocks[index].prevPhysical;
+    if (prev != s_none && m_blocks[prev].isFree)
+    {
+        RemoveFreeBlock(prev);
+        m_blocks[prev].size += m_blocks[index].size;
+        m_blocks[prev].nextPhysical = m_blocks[index].nextPhysical;
+        if (m_blocks[index].nextPhysical != s_none)
+        {
+            m_blocks[m_blocks[index].nextPhysical].prevPhysical = prev;
+        }
+        DestroyBlock(index);
+        index = prev;
+    }
+
+    uint32_t next = m_blocks[index].nextPhysical;
+    if (next != s_none && m_blocks[next].isFree)
+    {
+        RemoveFreeBlock(next);
+        m_blocks[index].size += m_blocks[next].size;
+        m_blocks[index].nextPhysical = m_blocks[next].nextPhysical;
+        if (m_blocks[next].nextPhysical != s_none)
+        {
+            m_blocks[m_blocks[next].nextPhysical].prevPhysical = index;
+        }
+        DestroyBlock(next);
+    }
+
+    InsertFreeBlock(index);
+}
+
+uint64_t TlsfAllocator::GetLargestFreeBlock() const
+{
+    if (m_firstLevelBitmap == 0)
+    {
+        return 0;
+    }
+
+    // The largest block is in the highest non-empty bin, whose blocks differ in size.
+    uint32_t firstLevel = static_cast<uint32_t>(std::bit_width(m_firstLevelBitmap)) - 1;
+    uint32_t secondLevel = static_cast<uint32_t>(std::bit_width(m_secondLevelBitmaps[firstLevel])) - 1;
+
+    uint64_t largest = 0;
+    for (uint32_t index = m_freeLists[firstLevel][secondLevel]; index != s_none; index = m_blocks[index].nextFree)
+    {
+        largest = std::max(largest, m_blocks[index].size);
+    }
+    return largest;
+}
+
+double TlsfAllocator::GetFragmentation() const
+{
+    uint64_t freeBytes = GetFreeBytes();
+    if (freeBytes == 0)
+    {
+        return 0.0;
+    }
+
+    return 1.0 - static_cast<double>(GetLargestFreeBlock()) / static_cast<double>(freeBytes);
+}
+
+uint32_t TlsfAllocator::CreateBlock()
+{
+    if (!m_unusedBlocks.empty())
+    {
+        uint32_t index = m_unusedBlocks.back();
+        m_unusedBlocks.pop_back();
+        return index;
+    }
+
+    m_blocks.emplace_back();
+    return static_cast<uint32_t>(m_blocks.size() - 1);
+}
+
+void TlsfAllocator::DestroyBlock(uint32_t index)
+{
+    m_unusedBlocks.push_back(index);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Two-level segregated fit allocator for a range of offsets, such as a GPU heap.
+// Free blocks are binned by size in power-of-two classes split into linear
+// subclasses, a pair of bitmaps finds a fitting bin in constant time. Freed
+// blocks merge with their free neighbours right away. Block bookkeeping lives
+// outside of the managed range, so it works for memory the CPU cannot access.
+// Not thread-safe.
+class TlsfAllocator
+{
+public:
+    using Handle = uint32_t;
+    static constexpr Handle s_invalidHandle = UINT32_MAX;
+
+    struct Allocation
+    {
+        uint64_t offset;
+        // s_invalidHandle if the request did not fit.
+        Handle handle;
+    };
+
+    explicit TlsfAllocator(uint64_t size);
+
+    // The alignment must be a power of two.
+    Allocation Allocate(uint64_t size, uint64_t alignment);
+    // The handle must come from Allocate and not have been freed yet.
+    void Free(Handle handle);
+
+    uint64_t GetSize() const { return m_size; }
+    uint64_t GetUsedBytes() const { return m_usedBytes; }
+    uint64_t GetFreeBytes() const { return m_size - m_usedBytes; }
+    size_t GetNumAllocations() const { return m_numAllocations; }
+    size_t GetNumFreeBlocks() const { return m_numFreeBlocks; }
+    uint64_t GetLargestFreeBlock() const;
+
+    // Share of the free bytes outside of the largest free block, 0 when all free
+    // space is contiguous and close to 1 when it is scattered in small blocks.
+    double GetFragmentation() const;
+
+private:
+    static constexpr uint32_t s_secondLevelBits = 4;
+    static constexpr uint32_t s_secondLevelCount = 1 << s_secondLevelBits;
+    static constexpr uint32_t s_firstLevelCount = 64 - s_secondLevelBits + 1;
+    static constexpr uint32_t s_none = UINT32_MAX;
+
+    struct Block
+    {
+        uint64_t offset;
+        uint64_t size;
+        // Neighbours in address order.
+        uint32_t prevPhysical;
+        uint32_t nextPhysical;
+        // Neighbours in the free list of the block's bin.
+        uint32_t prevFree;
+        uint32_t nextFree;
+        bool isFree;
+        // Handed out by Allocate. Blocks merged into a neighbour are neither
+        // free nor allocated, so freeing a handle twice is caught either way.
+        bool isAllocated;
+    };
+
+    static void Mapping(uint64_t size, uint32_t &firstLevel, uint32_t &secondLevel);
+
+    // Head of the first non-empty bin whose blocks are all at least size bytes.
+    uint32_t FindFreeBlock(uint64_t size) const;
+
+    void InsertFreeBlock(uint32_t index);
+    void RemoveFreeBlock(uint32_t index);
+
+    // Split the end of the block off into a new free block.
+    void SplitBlock(uint32_t index, uint64_t size);
+
+    uint32_t CreateBlock();
+    void DestroyBlock(uint32_t index);
+
+    uint64_t m_size;
+    uint64_t m_usedBytes = 0;
+    size_t m_numAllocations = 0;
+    size_t m_numFreeBlocks = 0;
+
+    std::vector<Block> m_blocks;
+    std::vector<uint32_t> m_unusedBlocks;
+
+    uint64_t m_firstLevelBitmap = 0;
+    uint32_t m_secondLevelBitmaps[s_firstLevelCount] = {};
+    uint32_t m_freeLists[s_firstLevelCount][s_secondLevelCount];
+};
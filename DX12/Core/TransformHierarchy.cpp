@@ -0,0 +1,283 @@
+#include "TransformHierarchy.h"
+
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+
+void TransformHierarchy::TransformArrays::Assign(size_t numNodes, const Transform &transform)
+{
+    positionX.assign(numNodes, transform.position[0]);
+    positionY.assign(numNodes, transform.position[1]);
+    positionZ.assign(numNodes, transform.position[2]);
+    rotationX.assign(numNodes, transform.rotation[0]);
+    rotationY.assign(numNodes, transform.rotation[1]);
+    rotationZ.assign(numNodes, transform.rotation[2]);
+    rotationW.assign(numNodes, transform.rotation[3]);
+    scale.assign(numNodes, transform.scale);
+}
+
+void TransformHierarchy::TransformArrays::Set(size_t index, const Transform &transform)
+{
+    positionX[index] = transform.position[0];
+    positionY[index] = transform.position[1];
+    positionZ[index] = transform.position[2];
+    rotationX[index] = transform.rotation[0];
+    rotationY[index] = transform.rotation[1];
+    rotationZ[index] = transform.rotation[2];
+    rotationW[index] = transform.rotation[3];
+    scale[index] = transform.scale;
+}
+
+TransformHierarchy::Transform TransformHierarchy::TransformArrays::Get(size_t index) const
+{
+    Transform transform;
+    transform.position[0] = positionX[index];
+    transform.position[1] = positionY[index];
+    transform.position[2] = positionZ[index];
+    transform.rotation[0] = rotationX[index];
+    transform.rotation[1] = rotationY[index];
+    transform.rotation[2] = rotationZ[index];
+    transform.rotation[3] = rotationW[index];
+    transform.scale = scale[index];
+    return transform;
+}
+
+void TransformHierarchy::Build(const std::vector<NodeIndex> &parents)
+{
+    size_t numNodes = parents.size();
+
+    // Children of every node in index order, packed in a single array.
+    std::vector<uint32_t> childOffsets(numNodes + 1, 0);
+    for (NodeIndex parent : parents)
+    {
+        if (parent != s_noParent)
+        {
+            assert(parent < numNodes);
+            childOffsets[parent + 1]++;
+        }
+    }
+    for (size_t i = 0; i < numNodes; i++)
+    {
+        childOffsets[i + 1] += childOffsets[i];
+    }
+
+    std::vector<uint32_t> children(childOffsets[numNodes]);
+    std::vector<uint32_t> childCursors(childOffsets.begin(), childOffsets.end() - 1);
+    for (size_t i = 0; i < numNodes; i++)
+    {
+        if (parents[i] != s_noParent)
+        {
+            children[childCursors[parents[i]]++] = static_cast<uint32_t>(i);
+        }
+    }
+
+    // Breadth-first traversal starting from the roots, one level at a time.
+    std::vector<uint32_t> order;
+    order.reserve(numNodes);
+    for (size_t i = 0; i < numNodes; i++)
+    {
+        if (parents[i] == s_noParent)
+        {
+            order.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    m_levelOffsets.assign(1, 0);
+    size_t levelBegin = 0;
+    while (levelBegin < order.size())
+    {
+        size_t levelEnd = order.size();
+        m_levelOffsets.push_back(levelEnd);
+        for (size_t i = levelBegin; i < levelEnd; i++)
+        {
+            uint32_t node = order[i];
+            order.insert(order.end(), children.begin() + childOffsets[node], children.begin() + childOffsets[node + 1]);
+        }
+        levelBegin = levelEnd;
+    }
+
+    // Nodes on a cycle are never reached from a root.
+    assert(order.size() == numNodes);
+
+    // Parents are sorted before their children, so their position is known already.
+    m_sortedIndices.resize(numNodes);
+    m_parents.resize(numNodes);
+    for (size_t i = 0; i < numNodes; i++)
+    {
+        uint32_t node = order[i];
+        m_sortedIndices[node] = static_cast<uint32_t>(i);
+        m_parents[i] = parents[node] == s_noParent ? s_noParent : m_sortedIndices[parents[node]];
+    }
+
+    m_local.Assign(numNodes, Transform());
+    m_world.Assign(numNodes, Transform());
+    m_dirty.assign(numNodes, 1);
+    m_hasDirtyNodes = numNodes > 0;
+}
+
+void TransformHierarchy::SetLocalTransform(NodeIndex node, const Transform &transform)
+{
+    uint32_t index = m_sortedIndices[node];
+    m_local.Set(index, transform);
+    m_dirty[index] = 1;
+    m_hasDirtyNodes = true;
+}
+
+void TransformHierarchy::SetLocalRotation(NodeIndex node, const float rotation[4])
+{
+    uint32_t index = m_sortedIndices[node];
+    m_local.rotationX[index] = rotation[0];
+    m_local.rotationY[index] = rotation[1];
+    m_local.rotationZ[index] = rotation[2];
+    m_local.rotationW[index] = rotation[3];
+    m_dirty[index] = 1;
+    m_hasDirtyNodes = true;
+}
+
+TransformHierarchy::Transform TransformHierarchy::GetLocalTransform(NodeIndex node) const
+{
+    return m_local.Get(m_sortedIndices[node]);
+}
+
+TransformHierarchy::Transform TransformHierarchy::GetWorldTransform(NodeIndex node) const
+{
+    return m_world.Get(m_sortedIndices[node]);
+}
+
+InstanceTransforms::Float4x4 TransformHierarchy::GetWorldMatrix(NodeIndex node) const
+{
+    uint32_t index = m_sortedIndices[node];
+    float x = m_world.rotationX[index];
+    float y = m_world.rotationY[index];
+    float z = m_world.rotationZ[index];
+    float w = m_world.rotationW[index];
+    float scale = m_world.scale[index];
+
+    InstanceTransforms::Float4x4 out;
+    out.m[0][0] = (1.0f - 2.0f * (y * y + z * z)) * scale;
+    out.m[0][1] = 2.0f * (x * y + z * w) * scale;
+    out.m[0][2] = 2.0f * (x * z - y * w) * scale;
+    out.m[0][3] = 0.0f;
+
+    out.m[1][0] = 2.0f * (x * y - z * w) * scale;
+    out.m[1][1] = (1.0f - 2.0f * (x * x + z * z)) * scale;
+    out.m[1][2] = 2.0f * (y * z + x * w) * scale;
+    out.m[1][3] = 0.0f;
+
+    out.m[2][0] = 2.0f * (x * z + y * w) * scale;
+    out.m[2][1] = 2.0f * (y * z - x * w) * scale;
+    out.m[2][2] = (1.0f - 2.0f * (x * x + y * y)) * scale;
+    out.m[2][3] = 0.0f;
+
+    out.m[3][0] = m_world.positionX[index];
+    out.m[3][1] = m_world.positionY[index];
+    out.m[3][2] = m_world.positionZ[index];
+    out.m[3][3] = 1.0f;
+    return out;
+}
+
+size_t TransformHierarchy::UpdateRange(size_t begin, size_t end)
+{
+    size_t numUpdated = 0;
+    for (size_t i = begin; i < end; i++)
+    {
+        uint32_t parent = m_parents[i];
+        bool parentDirty = parent != s_noParent && m_dirty[parent];
+        if (!m_dirty[i] && !parentDirty)
+        {
+            continue;
+        }
+
+        // Propagates to the children, which are on the next level.
+        m_dirty[i] = 1;
+        numUpdated++;
+
+        if (parent == s_noParent)
+        {
+            m_world.Set(i, m_local.Get(i));
+            continue;
+        }
+
+        float parentScale = m_world.scale[parent];
+        float qx = m_world.rotationX[parent];
+        float qy = m_world.rotationY[parent];
+        float qz = m_world.rotationZ[parent];
+        float qw = m_world.rotationW[parent];
+
+        // Rotate the scaled local position by the parent rotation:
+        // v' = v + w * t + q x t with t = 2 * q x v.
+        float vx = m_local.positionX[i] * parentScale;
+        float vy = m_local.positionY[i] * parentScale;
+        float vz = m_local.positionZ[i] * parentScale;
+        float tx = 2.0f * (qy * vz - qz * vy);
+        float ty = 2.0f * (qz * vx - qx * vz);
+        float tz = 2.0f * (qx * vy - qy * vx);
+        m_world.positionX[i] = m_world.positionX[parent] + vx + qw * tx + (qy * tz - qz * ty);
+        m_world.positionY[i] = m_world.positionY[parent] + vy + qw * ty + (qz * tx - qx * tz);
+        m_world.positionZ[i] = m_world.positionZ[parent] + vz + qw * tz + (qx * ty - qy * tx);
+
+        // The local rotation applies first, then the parent one.
+        float lx = m_local.rotationX[i];
+        float ly = m_local.rotationY[i];
+        float lz = m_local.rotationZ[i];
+        float lw = m_local.rotationW[i];
+        m_world.rotationX[i] = qw * lx + qx * lw + qy * lz - qz * ly;
+        m_world.rotationY[i] = qw * ly - qx * lz + qy * lw + qz * lx;
+        m_world.rotationZ[i] = qw * lz + qx * ly - qy * lx + qz * lw;
+        m_world.rotationW[i] = qw * lw - qx * lx - qy * ly - qz * lz;
+
+        m_world.scale[i] = parentScale * m_local.scale[i];
+    }
+    return numUpdated;
+}
+
+size_t TransformHierarchy::Update()
+{
+    if (!m_hasDirtyNodes)
+    {
+        return 0;
+    }
+
+    size_t numUpdated = 0;
+    for (size_t level = 0; level < GetNumLevels(); level++)
+    {
+        numUpdated += UpdateRange(m_levelOffsets[level], m_levelOffsets[level + 1]);
+    }
+
+    std::fill(m_dirty.begin(), m_dirty.end(), uint8_t(0));
+    m_hasDirtyNodes = false;
+    return numUpdated;
+}
+
+size_t TransformHierarchy::Update(JobSystem &jobSystem)
+{
+    if (!m_hasDirtyNodes)
+    {
+        return 0;
+    }
+
+    // Nodes of a level only read the world transforms of the level before,
+    // which is complete once ParallelFor returns.
+    std::atomic<size_t> numUpdated = 0;
+    for (size_t level = 0; level < GetNumLevels(); level++)
+    {
+        size_t begin = m_levelOffsets[level];
+        size_t end = m_levelOffsets[level + 1];
+        size_t grainSize = jobSystem.ComputeGrainSize(end - begin, sizeof(float));
+        if (grainSize >= end - begin)
+        {
+            // Not worth waking up the workers.
+            numUpdated.fetch_add(UpdateRange(begin, end), std::memory_order_relaxed);
+            continue;
+        }
+
+        jobSystem.ParallelFor(begin, end, grainSize, [&](size_t chunkBegin, size_t chunkEnd)
+                              { numUpdated.fetch_add(UpdateRange(chunkBegin, chunkEnd), std::memory_order_relaxed); });
+    }
+
+    std::fill(m_dirty.begin(), m_dirty.end(), uint8_t(0));
+    m_hasDirtyNodes = false;
+    return numUpdated.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Math/InstanceTransforms.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// Parent/child transforms stored as structure-of-arrays in breadth-first order,
+// so every level of the tree is contiguous and parents come before their
+// children. Changing a local transform marks the node dirty, the next update
+// recomputes the world transforms of the dirty nodes and of their descendants
+// one level at a time, each level in parallel.
+class TransformHierarchy
+{
+public:
+    using NodeIndex = uint32_t;
+    static constexpr NodeIndex s_noParent = UINT32_MAX;
+
+    // Position, unit rotation quaternion (x, y, z, w) and uniform scale. A child
+    // is scaled and rotated by its parent, then offset by the parent position.
+    struct Transform
+    {
+        float position[3] = {0.0f, 0.0f, 0.0f};
+        float rotation[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        float scale = 1.0f;
+    };
+
+    TransformHierarchy() = default;
+
+    TransformHierarchy(const TransformHierarchy &) = delete;
+    TransformHierarchy(TransformHierarchy &&) = delete;
+    TransformHierarchy &operator=(const TransformHierarchy &) = delete;
+    TransformHierarchy &operator=(TransformHierarchy &&) = delete;
+
+    // Replace the hierarchy, parents[i] is the parent of node i or s_noParent
+    // for a root. Parents may come after their children but there must be no
+    // cycles. Every local transform is reset to identity and marked dirty.
+    void Build(const std::vector<NodeIndex> &parents);
+
+    size_t GetNumNodes() const { return m_parents.size(); }
+    size_t GetNumLevels() const { return m_levelOffsets.empty() ? 0 : m_levelOffsets.size() - 1; }
+
+    void SetLocalTransform(NodeIndex node, const Transform &transform);
+    void SetLocalRotation(NodeIndex node, const float rotation[4]);
+    Transform GetLocalTransform(NodeIndex node) const;
+
+    // Valid after the update following the last change.
+    Transform GetWorldTransform(NodeIndex node) const;
+    InstanceTransforms::Float4x4 GetWorldMatrix(NodeIndex node) const;
+
+    // Recompute the world transform of every dirty node and its descendants.
+    // Returns the number of nodes recomputed.
+    size_t Update();
+    size_t Update(JobSystem &jobSystem);
+
+private:
+    struct TransformArrays
+    {
+        std::vector<float> positionX;
+        std::vector<float> positionY;
+        std::vector<float> positionZ;
+        std::vector<float> rotationX;
+        std::vector<float> rotationY;
+        std::vector<float> rotationZ;
+        std::vector<float> rotationW;
+        std::vector<float> scale;
+
+        void Assign(size_t numNodes, const Transform &transform);
+        void Set(size_t index, const Transform &transform);
+        Transform Get(size_t index) const;
+    };
+
+    // Update the nodes in [begin, end) of a single level.
+    size_t UpdateRange(size_t begin, size_t end);
+
+    // Indexed by breadth-first position.
+    std::vector<uint32_t> m_parents;
+    std::vector<uint8_t> m_dirty;
+    TransformArrays m_local;
+    TransformArrays m_world;
+
+    // Breadth-first position of every node.
+    std::vector<uint32_t> m_sortedIndices;
+    // First breadth-first position of every level, followed by the node count.
+    std::vector<size_t> m_levelOffsets;
+
+    bool m_hasDirtyNodes = false;
+};
@@ -0,0 +1,60 @@
+#include "UploadManager.h"
+
+#include "CommandQueue.h"
+#include "DXHelpers.h"
+#include "UploadRing.h"
+
+UploadManager::UploadManager(std::shared_ptr<CommandQueue> copyCommandQueue, UploadRing &uploadRing)
+    : m_copyCommandQueue(copyCommandQueue), m_uploadRing(uploadRing)
+{
+}
+
+void UploadManager::UploadBuffer(Microsoft::WRL::ComPtr<ID3D12Resource> &destinationResource, size_t numElements, size_t elementSize, const void *bufferData, D3D12_RESOURCE_FLAGS flags)
+{
+    if (!m_commandList)
+    {
+        m_commandList = m_copyCommandQueue->GetCommandList();
+    }
+
+    DXHelpers::UpdateBufferResource(m_commandList, m_uploadRing, destinationResource, numElements, elementSize, bufferData, flags);
+    m_numUploads++;
+}
+
+UploadManager::Ticket UploadManager::Submit()
+{
+    if (!m_commandList)
+    {
+        return m_lastTicket;
+    }
+
+    m_lastTicket.fenceValue = m_copyCommandQueue->ExecuteCommandList(m_commandList);
+    m_uploadRing.Submit(m_lastTicket.fenceValue);
+    m_commandList.Reset();
+    m_numBatches++;
+
+    return m_lastTicket;
+}
+
+bool UploadManager::IsComplete(Ticket ticket) const
+{
+    return m_copyCommandQueue->GetCompletedFenceValue() >= ticket.fenceValue;
+}
+
+void UploadManager::WaitOnGpu(CommandQueue &queue, Ticket ticket)
+{
+    if (queue.Wait(*m_copyCommandQueue, ticket.fenceValue))
+    {
+        m_numAvoidedCpuStalls++;
+    }
+}
+
+void UploadManager::WaitOnCpu(Ticket ticket)
+{
+    if (IsComplete(ticket))
+    {
+        return;
+    }
+
+    m_copyCommandQueue->WaitForFenceValue(ticket.fenceValue);
+    m_numCpuStalls++;
+}
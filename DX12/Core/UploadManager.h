@@ -0,0 +1,66 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+class CommandQueue;
+class UploadRing;
+
+// Collects buffer uploads into one command list on the copy queue and submits
+// them as a single batch. Submitting returns a ticket, other queues wait for it
+// on the GPU so the CPU does not have to block until the copies complete.
+// Not thread-safe.
+class UploadManager
+{
+public:
+    // Identifies a submitted batch, the default ticket is always complete.
+    struct Ticket
+    {
+        uint64_t fenceValue = 0;
+    };
+
+    UploadManager(std::shared_ptr<CommandQueue> copyCommandQueue, UploadRing &uploadRing);
+
+    UploadManager(const UploadManager &) = delete;
+    UploadManager(UploadManager &&) = delete;
+    UploadManager &operator=(const UploadManager &) = delete;
+    UploadManager &operator=(UploadManager &&) = delete;
+
+    // Create the destination buffer and record the copy of bufferData into the
+    // open batch. The buffer must not be used before the batch's ticket completes.
+    void UploadBuffer(Microsoft::WRL::ComPtr<ID3D12Resource> &destinationResource, size_t numElements, size_t elementSize, const void *bufferData, D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE);
+
+    // Execute the open batch on the copy queue. Returns the ticket of the last
+    // batch when nothing was recorded since.
+    Ticket Submit();
+
+    bool IsComplete(Ticket ticket) const;
+
+    // Make queue wait on the GPU until the batch of the ticket has completed.
+    void WaitOnGpu(CommandQueue &queue, Ticket ticket);
+
+    // Block the CPU until the batch of the ticket has completed.
+    void WaitOnCpu(Ticket ticket);
+
+    size_t GetNumBatches() const { return m_numBatches; }
+    size_t GetNumUploads() const { return m_numUploads; }
+    // GPU waits issued while the batch was still in flight, each one a CPU stall avoided.
+    size_t GetNumAvoidedCpuStalls() const { return m_numAvoidedCpuStalls; }
+    size_t GetNumCpuStalls() const { return m_numCpuStalls; }
+
+private:
+    std::shared_ptr<CommandQueue> m_copyCommandQueue;
+    UploadRing &m_uploadRing;
+
+    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> m_commandList;
+    Ticket m_lastTicket;
+
+    size_t m_numBatches = 0;
+    size_t m_numUploads = 0;
+    size_t m_numAvoidedCpuStalls = 0;
+    size_t m_numCpuStalls = 0;
+};
@@ -0,0 +1,79 @@
+#include "UploadRing.h"
+
+#include "CommandQueue.h"
+
+#pragma warning(push)
+#pragma warning(disable : 4365)
+#pragma warning(disable : 4626)
+#include "directx/d3dx12.h"
+#pragma warning(pop)
+
+#include <cassert>
+#include <cstring>
+
+UploadRing::UploadRing(Microsoft::WRL::ComPtr<ID3D12Device2> device, std::shared_ptr<CommandQueue> commandQueue, size_t capacity)
+    : m_device(device), m_commandQueue(commandQueue), m_allocator(capacity)
+{
+    CreateBuffer(capacity);
+}
+
+UploadRing::~UploadRing()
+{
+    if (m_buffer)
+    {
+        m_buffer->Unmap(0, nullptr);
+    }
+}
+
+void UploadRing::CreateBuffer(size_t capacity)
+{
+    CD3DX12_HEAP_PROPERTIES uploadHeapProps(D3D12_HEAP_TYPE_UPLOAD);
+    CD3DX12_RESOURCE_DESC uploadBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(capacity);
+
+    assert(SUCCEEDED(m_device->CreateCommittedResource(
+        &uploadHeapProps,
+        D3D12_HEAP_FLAG_NONE,
+        &uploadBufferDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&m_buffer))));
+
+    // The CPU never reads from the ring.
+    D3D12_RANGE readRange = {0, 0};
+    assert(SUCCEEDED(m_buffer->Map(0, &readRange, reinterpret_cast<void **>(&m_mappedData))));
+}
+
+void UploadRing::Reclaim()
+{
+    m_allocator.Reclaim(m_commandQueue->GetCompletedFenceValue());
+
+    size_t numFreedBuffers = m_retiredBuffers.size() - m_allocator.GetNumRetiredRings();
+    m_retiredBuffers.erase(m_retiredBuffers.begin(), m_retiredBuffers.begin() + static_cast<ptrdiff_t>(numFreedBuffers));
+}
+
+UploadRing::Allocation UploadRing::Allocate(size_t size, size_t alignment)
+{
+    Reclaim();
+
+    GrowingRingAllocator::Allocation allocation = m_allocator.Allocate(size, alignment);
+    if (allocation.grew)
+    {
+        m_buffer->Unmap(0, nullptr);
+        m_retiredBuffers.push_back(m_buffer);
+        CreateBuffer(m_allocator.GetCapacity());
+    }
+
+    return {m_buffer.Get(), allocation.offset, m_mappedData + allocation.offset, m_buffer->GetGPUVirtualAddress() + allocation.offset};
+}
+
+UploadRing::Allocation UploadRing::Upload(const void *data, size_t size, size_t alignment)
+{
+    Allocation allocation = Allocate(size, alignment);
+    std::memcpy(allocation.cpuAddress, data, size);
+    return allocation;
+}
+
+void UploadRing::Submit(uint64_t fenceValue)
+{
+    m_allocator.Submit(fenceValue);
+}
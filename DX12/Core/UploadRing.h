@@ -0,0 +1,69 @@
+#pragma once
+
+#include "GrowingRingAllocator.h"
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class CommandQueue;
+
+// Staging memory for copies recorded on a single command queue, suballocated
+// from one persistently mapped upload buffer. Ranges are reclaimed once the
+// fence value passed to Submit has completed on that queue. When a request
+// does not fit the ring moves to a buffer twice as large, the old buffer is
+// released once the GPU is done with it. The offsets, growth and retirement
+// are handled by GrowingRingAllocator. Not thread-safe.
+class UploadRing
+{
+public:
+    struct Allocation
+    {
+        ID3D12Resource *resource;
+        uint64_t offset;
+        void *cpuAddress;
+        D3D12_GPU_VIRTUAL_ADDRESS gpuAddress;
+    };
+
+    UploadRing(Microsoft::WRL::ComPtr<ID3D12Device2> device, std::shared_ptr<CommandQueue> commandQueue, size_t capacity);
+    ~UploadRing();
+
+    UploadRing(const UploadRing &) = delete;
+    UploadRing(UploadRing &&) = delete;
+    UploadRing &operator=(const UploadRing &) = delete;
+    UploadRing &operator=(UploadRing &&) = delete;
+
+    Allocation Allocate(size_t size, size_t alignment = s_defaultAlignment);
+
+    // Allocate a range and copy data into it.
+    Allocation Upload(const void *data, size_t size, size_t alignment = s_defaultAlignment);
+
+    // Call after executing the command lists that read the allocations made
+    // since the last submit, with the fence value returned for them.
+    void Submit(uint64_t fenceValue);
+
+    size_t GetCapacity() const { return m_allocator.GetCapacity(); }
+    size_t GetUsedBytes() const { return m_allocator.GetUsedBytes(); }
+    size_t GetPeakUsedBytes() const { return m_allocator.GetPeakUsedBytes(); }
+    size_t GetNumGrowths() const { return m_allocator.GetNumGrowths(); }
+
+private:
+    static constexpr size_t s_defaultAlignment = 16;
+
+    void CreateBuffer(size_t capacity);
+    void Reclaim();
+
+    Microsoft::WRL::ComPtr<ID3D12Device2> m_device;
+    std::shared_ptr<CommandQueue> m_commandQueue;
+
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_buffer;
+    std::byte *m_mappedData = nullptr;
+    GrowingRingAllocator m_allocator;
+
+    // Buffers left behind by a growth, oldest first, one per retired ring of the allocator.
+    std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> m_retiredBuffers;
+};
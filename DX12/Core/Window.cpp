@@ -4,6 +4,7 @@
 #include "DXHelpers.h"
 #include "Engine.h"
 #include "CommandQueue.h"
+#include "ResourceStateTracker.h"
 
 const wchar_t *Window::s_windowClassName = L"DXWindow";
 const uint32_t Window::s_numBuffers = 3;
@@ -103,6 +104,10 @@ Window::Window(HWND windowHandle, uint32_t width, uint32_t height)
 
     m_backBuffers.resize(s_numBuffers);
     DXHelpers::UpdateRenderTargetViews(device, m_swapChain, m_RTVDescriptorHeap, m_backBuffers);
+    for (const Microsoft::WRL::ComPtr<ID3D12Resource> &backBuffer : m_backBuffers)
+    {
+        ResourceStateTracker::AddGlobalResourceState(backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT);
+    }
 }
 
 LRESULT Window::WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
@@ -422,12 +427,14 @@ void Window::ResizeSwapChainBuffers(uint32_t width, uint32_t height)
 {
     // Stall the CPU until the GPU is finished with any queued render
     // commands. This is required before we can resize the swap chain buffers.
-    Engine::Get().WaitForGPU();
+    // Only the direct queue uses them, the other queues keep running.
+    Engine::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT)->Flush();
 
     // Before the buffers can be resized, all references to those buffers
     // need to be released.
     for (size_t i = 0; i < m_backBuffers.size(); ++i)
     {
+        ResourceStateTracker::RemoveGlobalResourceState(m_backBuffers[i].Get());
         m_backBuffers[i].Reset();
     }
 
@@ -445,6 +452,10 @@ void Window::ResizeSwapChainBuffers(uint32_t width, uint32_t height)
     m_currentBackBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
 
     DXHelpers::UpdateRenderTargetViews(Engine::Get().GetDevice(), m_swapChain, m_RTVDescriptorHeap, m_backBuffers);
+    for (const Microsoft::WRL::ComPtr<ID3D12Resource> &backBuffer : m_backBuffers)
+    {
+        ResourceStateTracker::AddGlobalResourceState(backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT);
+    }
 }
 
 bool Window::IsFullScreen() const
@@ -1,8 +1,16 @@
+#include "../Core/InstanceLayout.h"
+
 struct VertexPosColor
 {
     float3 Position : POSITION;
     float3 Color    : COLOR;
+#if DX12_COMPACT_INSTANCES
+    float3 InstancePosition : INSTANCE_POSITION;
+    float4 InstanceRotation : INSTANCE_ROTATION;
+    float InstanceScale     : INSTANCE_SCALE;
+#else
     float4x4 Model  : MODEL;
+#endif
     uint InstanceId : SV_InstanceID;
 };
 
@@ -19,11 +27,39 @@ struct VertexShaderOutput
     float4 Position : SV_Position;
 };
 
+#if DX12_COMPACT_INSTANCES
+// Rotation matrix of a unit quaternion, using the row-vector convention of DirectXMath.
+float3x3 QuaternionToMatrix(float4 q)
+{
+    float3 q2 = q.xyz * 2.0f;
+    float xx = q.x * q2.x;
+    float yy = q.y * q2.y;
+    float zz = q.z * q2.z;
+    float xy = q.x * q2.y;
+    float xz = q.x * q2.z;
+    float yz = q.y * q2.z;
+    float wx = q.w * q2.x;
+    float wy = q.w * q2.y;
+    float wz = q.w * q2.z;
+
+    return float3x3(1.0f - yy - zz, xy + wz, xz - wy,
+                    xy - wz, 1.0f - xx - zz, yz + wx,
+                    xz + wy, yz - wx, 1.0f - xx - yy);
+}
+#endif
+
 VertexShaderOutput main(VertexPosColor IN)
 {
     VertexShaderOutput OUT;
 
+#if DX12_COMPACT_INSTANCES
+    // The quantized quaternion is only approximately unit length.
+    float3x3 rotation = QuaternionToMatrix(normalize(IN.InstanceRotation));
+    float3 worldPosition = mul(IN.Position * IN.InstanceScale, rotation) + IN.InstancePosition;
+    OUT.Position = mul(ViewProjectionCB.VP, float4(worldPosition, 1.0f));
+#else
     OUT.Position = mul(ViewProjectionCB.VP, mul(IN.Model, float4(IN.Position, 1.0f)));
+#endif
     OUT.Color = float4(IN.Color, 1.0f);
 
     return OUT;
@@ -0,0 +1,31 @@
+// Per-instance data written by the compute passes, see Game::InstanceData.
+#ifndef INSTANCE_DATA_HLSLI
+#define INSTANCE_DATA_HLSLI
+
+#include "../Core/InstanceLayout.h"
+
+#if DX12_COMPACT_INSTANCES
+// Same layout as InstanceTransforms::CompactInstance.
+struct InstanceData
+{
+    float3 Position;
+    // Quaternion as four snorm16 values, x and y in the first word.
+    uint2 Rotation;
+    // Half float scale in the low 16 bits.
+    uint Scale;
+};
+
+uint PackSnorm16(float2 value)
+{
+    int2 quantized = int2(round(clamp(value, -1.0f, 1.0f) * 32767.0f));
+    return (uint(quantized.x) & 0xffff) | (uint(quantized.y) << 16);
+}
+#else
+// Same layout as the rows of a DirectX::XMMATRIX.
+struct InstanceData
+{
+    float4 Rows[4];
+};
+#endif
+
+#endif
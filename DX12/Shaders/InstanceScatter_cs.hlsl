@@ -0,0 +1,27 @@
+#include "InstanceData.hlsli"
+
+// Applies the sparse instance updates packed by Game::UpdateInstanceData:
+// Instances[Indices[i]] = Updates[i].
+struct ScatterConstants
+{
+    uint NumUpdates;
+    // Threads per row of the dispatch, see InstanceTransforms_cs.hlsl.
+    uint ThreadsPerRow;
+};
+
+ConstantBuffer<ScatterConstants> ScatterConstantsCB : register(b0);
+StructuredBuffer<InstanceData> Updates : register(t0);
+StructuredBuffer<uint> Indices : register(t1);
+RWStructuredBuffer<InstanceData> Instances : register(u0);
+
+[numthreads(64, 1, 1)]
+void main(uint3 dispatchThreadId : SV_DispatchThreadID)
+{
+    uint update = dispatchThreadId.y * ScatterConstantsCB.ThreadsPerRow + dispatchThreadId.x;
+    if (update >= ScatterConstantsCB.NumUpdates)
+    {
+        return;
+    }
+
+    Instances[Indices[update]] = Updates[update];
+}
@@ -0,0 +1,66 @@
+#include "InstanceData.hlsli"
+
+// GPU version of the instance animation in Game::UpdateInstanceData.
+// Mirrors InstanceTransforms::ComposeReference, which stays the CPU reference.
+struct InstanceConstants
+{
+    uint NumRows;
+    uint NumColumns;
+    float XStride;
+    float YStride;
+    float CubeSize;
+    // Rotation of the first row in degrees, wrapped to [0, 360) on the CPU.
+    float AnglePhase;
+    // Threads per row of the dispatch, which is split into rows to stay within
+    // the thread group limit of a dimension.
+    uint ThreadsPerRow;
+};
+
+ConstantBuffer<InstanceConstants> InstanceConstantsCB : register(b0);
+RWStructuredBuffer<InstanceData> Instances : register(u0);
+
+[numthreads(64, 1, 1)]
+void main(uint3 dispatchThreadId : SV_DispatchThreadID)
+{
+    uint index = dispatchThreadId.y * InstanceConstantsCB.ThreadsPerRow + dispatchThreadId.x;
+    if (index >= InstanceConstantsCB.NumRows * InstanceConstantsCB.NumColumns)
+    {
+        return;
+    }
+
+    uint x = index / InstanceConstantsCB.NumColumns;
+    uint y = index % InstanceConstantsCB.NumColumns;
+
+    // Every row adds a quarter turn.
+    float angle = radians(InstanceConstantsCB.AnglePhase + (float)(x % 4) * 90.0f);
+
+    float3 axis = normalize(float3(0.0f, 1.0f, 1.0f));
+    float scale = InstanceConstantsCB.CubeSize;
+    float3 position = float3(((float)x - (float)(InstanceConstantsCB.NumRows / 2)) * InstanceConstantsCB.XStride,
+                             ((float)y - (float)(InstanceConstantsCB.NumColumns / 2)) * InstanceConstantsCB.YStride,
+                             0.0f);
+
+    InstanceData instance;
+#if DX12_COMPACT_INSTANCES
+    // Rotation quaternion with w >= 0, as encoded on the CPU.
+    float halfSin;
+    float halfCos;
+    sincos(angle * 0.5f, halfSin, halfCos);
+    float4 rotation = float4(axis * halfSin, halfCos) * (halfCos < 0.0f ? -1.0f : 1.0f);
+
+    instance.Position = position;
+    instance.Rotation = uint2(PackSnorm16(rotation.xy), PackSnorm16(rotation.zw));
+    instance.Scale = f32tof16(scale);
+#else
+    float s;
+    float c;
+    sincos(angle, s, c);
+    float t = 1.0f - c;
+    instance.Rows[0] = float4(float3(c + t * axis.x * axis.x, t * axis.x * axis.y + axis.z * s, t * axis.x * axis.z - axis.y * s) * scale, 0.0f);
+    instance.Rows[1] = float4(float3(t * axis.x * axis.y - axis.z * s, c + t * axis.y * axis.y, t * axis.y * axis.z + axis.x * s) * scale, 0.0f);
+    instance.Rows[2] = float4(float3(t * axis.x * axis.z + axis.y * s, t * axis.y * axis.z - axis.x * s, c + t * axis.z * axis.z) * scale, 0.0f);
+    instance.Rows[3] = float4(position, 1.0f);
+#endif
+
+    Instances[index] = instance;
+}
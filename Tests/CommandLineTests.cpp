@@ -0,0 +1,27 @@
+#include "Test.h"
+
+#include "CommandLine.h"
+
+TEST(CommandLine, ParsesNamesFlagsAndValues)
+{
+    CommandLine commandLine(L"-instances 5000 -vsync -title \"Two words\" -offset -1.5");
+    CHECK(commandLine.HasFlag(L"vsync"));
+    CHECK(!commandLine.HasFlag(L"fullscreen"));
+    CHECK(commandLine.GetSize(L"instances", 1) == 5000);
+    CHECK(commandLine.GetString(L"title", L"") == L"Two words");
+    CHECK(commandLine.GetFloat(L"offset", 0.0f) == -1.5f);
+
+    // Flags have no value to parse.
+    CHECK(commandLine.GetSize(L"vsync", 7) == 7);
+    CHECK(commandLine.GetSize(L"missing", 7) == 7);
+}
+
+TEST(CommandLine, SizesRejectNegativeAndOutOfRangeValues)
+{
+    CommandLine commandLine(L"-a -5 -b \" -5\" -c 99999999999999999999999 -d 12x -e \" 42\"");
+    CHECK(commandLine.GetSize(L"a", 7) == 7);
+    CHECK(commandLine.GetSize(L"b", 7) == 7);
+    CHECK(commandLine.GetSize(L"c", 7) == 7);
+    CHECK(commandLine.GetSize(L"d", 7) == 7);
+    CHECK(commandLine.GetSize(L"e", 7) == 42);
+}
@@ -0,0 +1,173 @@
+#include "Test.h"
+
+#include "DeferredReleaseQueue.h"
+#include "FakeFence.h"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace
+{
+    using QueueFences::FenceValues;
+    using QueueFences::s_computeQueue;
+    using QueueFences::s_copyQueue;
+    using QueueFences::s_directQueue;
+}
+
+TEST(DeferredReleaseQueue, LaggingQueueHoldsItsEntries)
+{
+    DeferredReleaseQueue queue;
+    FakeQueueFences queues;
+    std::vector<int> released;
+
+    // Object 1 is only used by the direct queue, object 2 also by an upload on
+    // the copy queue, object 3 again only by the direct queue.
+    queues[s_directQueue].Signal();
+    queue.Enqueue([&released]()
+                  { released.push_back(1); }, {queues[s_directQueue].GetLastSignaledValue(), 0, 0});
+    queues[s_copyQueue].Signal();
+    queue.Enqueue([&released]()
+                  { released.push_back(2); }, queues.GetLastSignaledValues());
+    queues[s_directQueue].Signal();
+    queue.Enqueue([&released]()
+                  { released.push_back(3); }, {queues[s_directQueue].GetLastSignaledValue(), 0, 0});
+    CHECK(queue.GetNumPending() == 3);
+
+    // The direct queue finishes everything while the copy queue lags behind.
+    queues[s_directQueue].Complete(2);
+    CHECK(queue.Collect(queues.GetCompletedValues()) == 2);
+    CHECK((released == std::vector<int>{1, 3}));
+    CHECK(queue.GetNumPending() == 1);
+
+    // Later direct queue work does not release it either.
+    queues[s_directQueue].Complete(queues[s_directQueue].Signal());
+    CHECK(queue.Collect(queues.GetCompletedValues()) == 0);
+
+    queues[s_copyQueue].Complete(1);
+    CHECK(queue.Collect(queues.GetCompletedValues()) == 1);
+    CHECK((released == std::vector<int>{1, 3, 2}));
+    CHECK(queue.GetNumPending() == 0);
+    CHECK(queue.GetNumReleased() == 3);
+}
+
+TEST(DeferredReleaseQueue, ReleasesInEnqueueOrder)
+{
+    DeferredReleaseQueue queue;
+    std::vector<int> released;
+    for (int i = 0; i < 5; i++)
+    {
+        // Later entries wait for lower fence values, they still run in enqueue order.
+        queue.Enqueue([&released, i]()
+                      { released.push_back(i); }, {static_cast<uint64_t>(5 - i), 0, 0});
+    }
+
+    // A queue that never used an object does not hold it.
+    queue.Enqueue([&released]()
+                  { released.push_back(5); }, {0, 0, 0});
+
+    CHECK(queue.Collect({3, 0, 0}) == 4);
+    CHECK((released == std::vector<int>{2, 3, 4, 5}));
+    CHECK(queue.Collect({5, 0, 0}) == 2);
+    CHECK((released == std::vector<int>{2, 3, 4, 5, 0, 1}));
+}
+
+TEST(DeferredReleaseQueue, ReleaseMayEnqueueAgain)
+{
+    DeferredReleaseQueue queue;
+    std::vector<int> released;
+
+    // Releasing the first object releases a second one, which is still in use.
+    queue.Enqueue([&queue, &released]()
+                  {
+                      released.push_back(1);
+                      queue.Enqueue([&released]()
+                                    { released.push_back(2); }, {0, 4, 0}); }, {1, 0, 0});
+
+    CHECK(queue.Collect({1, 3, 0}) == 1);
+    CHECK((released == std::vector<int>{1}));
+    CHECK(queue.GetNumPending() == 1);
+
+    CHECK(queue.Collect({1, 4, 0}) == 1);
+    CHECK((released == std::vector<int>{1, 2}));
+}
+
+TEST(DeferredReleaseQueue, FlushReleasesEverything)
+{
+    DeferredReleaseQueue queue;
+    int numReleased = 0;
+    for (uint64_t i = 1; i <= 4; i++)
+    {
+        queue.Enqueue([&numReleased]()
+                      { numReleased++; }, {i, i, i});
+    }
+
+    CHECK(queue.Collect({2, 2, 1}) == 1);
+    queue.Flush();
+    CHECK(numReleased == 4);
+    CHECK(queue.GetNumPending() == 0);
+    CHECK(queue.GetNumReleased() == 4);
+}
+
+TEST(DeferredReleaseQueue, NeverReleasesEarly)
+{
+    DeferredReleaseQueue queue;
+    FakeQueueFences queues;
+    std::mt19937 random(17);
+
+    // Fence values each released object waits for, indexed by object.
+    std::vector<FenceValues> waitValues;
+    std::vector<bool> isReleased;
+    bool early = false;
+
+    for (size_t frame = 0; frame < 1000; frame++)
+    {
+        // Every frame submits to the direct queue, some to the compute and copy queues.
+        queues[s_directQueue].Signal();
+        if (random() % 2 == 0)
+        {
+            queues[s_computeQueue].Signal();
+        }
+        if (random() % 4 == 0)
+        {
+            queues[s_copyQueue].Signal();
+        }
+
+        for (size_t i = 0, count = random() % 4; i < count; i++)
+        {
+            size_t object = waitValues.size();
+            waitValues.push_back(queues.GetLastSignaledValues());
+            isReleased.push_back(false);
+            queue.Enqueue([&, object]()
+                          {
+                              for (size_t queueIndex = 0; queueIndex < QueueFences::s_numQueues; queueIndex++)
+                              {
+                                  early = early || waitValues[object][queueIndex] > queues[queueIndex].completedValue;
+                              }
+                              isReleased[object] = true; }, queues.GetLastSignaledValues());
+        }
+
+        // The direct queue runs two frames behind, compute one, and the copy
+        // queue stalls for 50 frames at a time.
+        queues[s_directQueue].Complete(queues[s_directQueue].GetLastSignaledValue() >= 2 ? queues[s_directQueue].GetLastSignaledValue() - 2 : 0);
+        queues[s_computeQueue].Complete(queues[s_computeQueue].GetLastSignaledValue() >= 1 ? queues[s_computeQueue].GetLastSignaledValue() - 1 : 0);
+        if (frame % 50 == 49)
+        {
+            queues[s_copyQueue].Complete(queues[s_copyQueue].GetLastSignaledValue());
+        }
+        queue.Collect(queues.GetCompletedValues());
+    }
+    CHECK(!early);
+
+    // Everything is released once the GPU catches up.
+    queues.CompleteAll();
+    queue.Collect(queues.GetCompletedValues());
+    bool released = true;
+    for (bool objectReleased : isReleased)
+    {
+        released = released && objectReleased;
+    }
+    CHECK(released);
+    CHECK(queue.GetNumPending() == 0);
+    CHECK(queue.GetNumReleased() == isReleased.size());
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "QueueFences.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Stands in for a command queue fence: Signal returns the value of the next
+// submission, the GPU completes them with Complete.
+struct FakeFence
+{
+    uint64_t nextValue = 1;
+    uint64_t completedValue = 0;
+
+    uint64_t Signal() { return nextValue++; }
+    void Complete(uint64_t value) { completedValue = value; }
+
+    uint64_t GetLastSignaledValue() const { return nextValue - 1; }
+};
+
+// The fences of the direct, compute and copy queues, indexed as in QueueFences.
+struct FakeQueueFences
+{
+    std::array<FakeFence, QueueFences::s_numQueues> fences;
+
+    FakeFence &operator[](size_t queueIndex) { return fences[queueIndex]; }
+    const FakeFence &operator[](size_t queueIndex) const { return fences[queueIndex]; }
+
+    QueueFences::FenceValues GetLastSignaledValues() const
+    {
+        QueueFences::FenceValues fenceValues;
+        for (size_t i = 0; i < QueueFences::s_numQueues; i++)
+        {
+            fenceValues[i] = fences[i].GetLastSignaledValue();
+        }
+        return fenceValues;
+    }
+
+    QueueFences::FenceValues GetCompletedValues() const
+    {
+        QueueFences::FenceValues fenceValues;
+        for (size_t i = 0; i < QueueFences::s_numQueues; i++)
+        {
+            fenceValues[i] = fences[i].completedValue;
+        }
+        return fenceValues;
+    }
+
+    // The GPU catches up with everything signaled so far.
+    void CompleteAll()
+    {
+        for (FakeFence &fence : fences)
+        {
+            fence.Complete(fence.GetLastSignaledValue());
+        }
+    }
+};
@@ -0,0 +1,154 @@
+#include "Test.h"
+
+#include "FakeFence.h"
+#include "FenceScheduler.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+    using QueueFences::s_computeQueue;
+    using QueueFences::s_copyQueue;
+    using QueueFences::s_directQueue;
+
+    // Records the task id every time the task runs, before and after it waits.
+    FenceScheduler::Task WaitOnce(FenceScheduler &scheduler, std::vector<int> &log, int id, size_t queueIndex, uint64_t fenceValue)
+    {
+        log.push_back(id);
+        co_await scheduler.WaitFor(queueIndex, fenceValue);
+        log.push_back(id);
+    }
+
+    FenceScheduler::Task WaitTwice(FenceScheduler &scheduler, std::vector<int> &log, int id, size_t queueIndex, uint64_t firstValue, uint64_t secondValue)
+    {
+        co_await scheduler.WaitFor(queueIndex, firstValue);
+        log.push_back(id);
+        co_await scheduler.WaitFor(queueIndex, secondValue);
+        log.push_back(id);
+    }
+
+    // Counts the tasks whose frame is still alive.
+    struct LiveCounter
+    {
+        explicit LiveCounter(int &count) : m_count(count) { m_count++; }
+        ~LiveCounter() { m_count--; }
+
+        LiveCounter(const LiveCounter &) = delete;
+        LiveCounter &operator=(const LiveCounter &) = delete;
+
+        int &m_count;
+    };
+
+    FenceScheduler::Task WaitCounted(FenceScheduler &scheduler, int &liveCount, uint64_t fenceValue)
+    {
+        LiveCounter counter(liveCount);
+        co_await scheduler.WaitFor(0, fenceValue);
+    }
+}
+
+TEST(FenceScheduler, ResumesInSuspensionOrder)
+{
+    FenceScheduler scheduler;
+    FakeQueueFences queues;
+    std::vector<int> log;
+    scheduler.Start(WaitOnce(scheduler, log, 1, s_directQueue, 5));
+    scheduler.Start(WaitOnce(scheduler, log, 2, s_computeQueue, 2));
+    scheduler.Start(WaitOnce(scheduler, log, 3, s_directQueue, 3));
+    scheduler.Start(WaitOnce(scheduler, log, 4, s_copyQueue, 1));
+    scheduler.Start(WaitOnce(scheduler, log, 5, s_computeQueue, 4));
+    CHECK((log == std::vector<int>{1, 2, 3, 4, 5}));
+    CHECK(scheduler.GetNumWaiting() == 5);
+
+    // The queues complete out of the order the tasks waited on them. The direct
+    // queue lags behind, then catches up past both of its waiters at once.
+    log.clear();
+    queues[s_computeQueue].Complete(4);
+    queues[s_copyQueue].Complete(1);
+    CHECK(scheduler.Resume(queues.GetCompletedValues()) == 3);
+    CHECK((log == std::vector<int>{2, 4, 5}));
+
+    log.clear();
+    queues[s_directQueue].Complete(1);
+    CHECK(scheduler.Resume(queues.GetCompletedValues()) == 0);
+    CHECK(log.empty());
+
+    // Task 3 waits for a lower value than task 1, it still resumes after it.
+    log.clear();
+    queues[s_directQueue].Complete(7);
+    CHECK(scheduler.Resume(queues.GetCompletedValues()) == 2);
+    CHECK((log == std::vector<int>{1, 3}));
+
+    CHECK(scheduler.GetNumWaiting() == 0);
+    CHECK(scheduler.GetNumTasks() == 0);
+    CHECK(scheduler.GetNumResumed() == 5);
+}
+
+TEST(FenceScheduler, CompletedFencesDoNotSuspend)
+{
+    FenceScheduler scheduler;
+    FakeQueueFences queues;
+    std::vector<int> log;
+
+    // A fence value of 0 never waits.
+    scheduler.Start(WaitOnce(scheduler, log, 1, s_directQueue, 0));
+    CHECK((log == std::vector<int>{1, 1}));
+    CHECK(scheduler.GetNumTasks() == 0);
+
+    // Nor does one the last Resume reported as completed.
+    for (int i = 0; i < 3; i++)
+    {
+        queues[s_directQueue].Signal();
+    }
+    queues.CompleteAll();
+    scheduler.Resume(queues.GetCompletedValues());
+    log.clear();
+    scheduler.Start(WaitOnce(scheduler, log, 2, s_directQueue, queues[s_directQueue].GetLastSignaledValue()));
+    scheduler.Start(WaitOnce(scheduler, log, 3, s_directQueue, queues[s_directQueue].Signal()));
+    CHECK((log == std::vector<int>{2, 2, 3}));
+    CHECK(scheduler.GetNumWaiting() == 1);
+}
+
+TEST(FenceScheduler, TasksWaitingAgainResumeOnALaterCall)
+{
+    FenceScheduler scheduler;
+    std::vector<int> log;
+    scheduler.Start(WaitTwice(scheduler, log, 1, 0, 1, 3));
+    scheduler.Start(WaitTwice(scheduler, log, 2, 0, 2, 3));
+
+    CHECK(scheduler.Resume({2, 0, 0}) == 2);
+    CHECK((log == std::vector<int>{1, 2}));
+    CHECK(scheduler.GetNumWaiting() == 2);
+
+    // A second wait on a value that has completed does not suspend.
+    log.clear();
+    scheduler.Start(WaitTwice(scheduler, log, 3, 0, 4, 5));
+    CHECK(scheduler.Resume({5, 0, 0}) == 3);
+    CHECK((log == std::vector<int>{1, 2, 3, 3}));
+    CHECK(scheduler.GetNumTasks() == 0);
+
+    // Each task waits again behind the other, they resume in the new order.
+    log.clear();
+    scheduler.Start(WaitTwice(scheduler, log, 4, 1, 1, 3));
+    scheduler.Start(WaitTwice(scheduler, log, 5, 1, 2, 3));
+    CHECK(scheduler.Resume({5, 1, 0}) == 1);
+    CHECK(scheduler.Resume({5, 2, 0}) == 1);
+    CHECK(scheduler.Resume({5, 3, 0}) == 2);
+    CHECK((log == std::vector<int>{4, 5, 4, 5}));
+    CHECK(scheduler.GetNumTasks() == 0);
+}
+
+TEST(FenceScheduler, DestroysSuspendedTasks)
+{
+    int liveCount = 0;
+    {
+        FenceScheduler scheduler;
+        scheduler.Start(WaitCounted(scheduler, liveCount, 1));
+        scheduler.Start(WaitCounted(scheduler, liveCount, 2));
+        CHECK(liveCount == 2);
+
+        scheduler.Resume({1, 0, 0});
+        CHECK(liveCount == 1);
+    }
+    CHECK(liveCount == 0);
+}
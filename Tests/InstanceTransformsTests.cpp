@@ -0,0 +1,377 @@
+#include "Test.h"
+
+#include "Math/InstanceTransforms.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace InstanceTransforms;
+
+namespace
+{
+    // Owns the arrays an InstanceSoA points to.
+    struct Instances
+    {
+        std::vector<float> scale;
+        std::vector<float> angle;
+        std::vector<float> axisX;
+        std::vector<float> axisY;
+        std::vector<float> axisZ;
+        std::vector<float> offsetX;
+        std::vector<float> offsetY;
+        std::vector<float> offsetZ;
+
+        InstanceSoA GetSoA() const
+        {
+            return {scale.data(), angle.data(), axisX.data(), axisY.data(), axisZ.data(), offsetX.data(), offsetY.data(), offsetZ.data()};
+        }
+    };
+
+    // Angles span a few hundred periods either way, as animations accumulate them.
+    Instances MakeInstances(size_t count)
+    {
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+        Instances instances;
+        for (size_t i = 0; i < count; i++)
+        {
+            float x = unit(random);
+            float y = unit(random);
+            float z = unit(random) + 2.0f;
+            float length = std::sqrt(x * x + y * y + z * z);
+
+            instances.scale.push_back(0.5f + unit(random) * 0.25f);
+            instances.angle.push_back(unit(random) * 2000.0f);
+            instances.axisX.push_back(x / length);
+            instances.axisY.push_back(y / length);
+            instances.axisZ.push_back(z / length);
+            instances.offsetX.push_back(unit(random) * 100.0f);
+            instances.offsetY.push_back(unit(random) * 100.0f);
+            instances.offsetZ.push_back(unit(random) * 100.0f);
+        }
+        return instances;
+    }
+
+    // Largest element difference over [begin, end).
+    float MaxDifference(const std::vector<Float4x4> &a, const std::vector<Float4x4> &b, size_t begin, size_t end)
+    {
+        float difference = 0.0f;
+        for (size_t i = begin; i < end; i++)
+        {
+            for (size_t row = 0; row < 4; row++)
+            {
+                for (size_t column = 0; column < 4; column++)
+                {
+                    difference = std::fmax(difference, std::fabs(a[i].m[row][column] - b[i].m[row][column]));
+                }
+            }
+        }
+        return difference;
+    }
+
+    bool IsUntouched(const std::vector<Float4x4> &transforms, size_t begin, size_t end, float fill)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            for (size_t row = 0; row < 4; row++)
+            {
+                for (size_t column = 0; column < 4; column++)
+                {
+                    if (transforms[i].m[row][column] != fill)
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    // Every kernel against the reference one, over a range whose ends are not
+    // multiples of the vector widths so that the remainder loops run too.
+    void CheckKernel(Kernel kernel, StoreMode mode)
+    {
+        if (!IsKernelSupported(kernel))
+        {
+            std::printf("  %s is not supported here, skipped\n", GetKernelName(kernel));
+            return;
+        }
+
+        const size_t count = 1029;
+        const size_t begin = 3;
+        const size_t end = count - 5;
+        Instances instances = MakeInstances(count);
+
+        std::vector<Float4x4> reference(count);
+        Compose(Kernel::Reference, instances.GetSoA(), begin, end, reference.data());
+
+        // 16-byte aligned, which streaming stores require.
+        const float fill = -12345.0f;
+        std::vector<Float4x4> transforms(count, Float4x4{{{fill, fill, fill, fill}, {fill, fill, fill, fill}, {fill, fill, fill, fill}, {fill, fill, fill, fill}}});
+        CHECK(reinterpret_cast<uintptr_t>(transforms.data()) % 16 == 0);
+        Compose(kernel, instances.GetSoA(), begin, end, transforms.data(), mode);
+
+        // Rotation terms are at most the scale, below 1, the offsets are copied.
+        CHECK_NEAR(MaxDifference(transforms, reference, begin, end), 0.0, 2e-6);
+        CHECK(IsUntouched(transforms, 0, begin, fill));
+        CHECK(IsUntouched(transforms, end, count, fill));
+    }
+}
+
+TEST(InstanceTransforms, SinCosMatchesStandardLibrary)
+{
+    float maxError = 0.0f;
+    for (float angle = -1000.0f; angle <= 1000.0f; angle += 0.0137f)
+    {
+        float s;
+        float c;
+        SinCos(angle, &s, &c);
+        maxError = std::fmax(maxError, std::fabs(s - static_cast<float>(std::sin(static_cast<double>(angle)))));
+        maxError = std::fmax(maxError, std::fabs(c - static_cast<float>(std::cos(static_cast<double>(angle)))));
+    }
+    CHECK_NEAR(maxError, 0.0, 1e-6);
+}
+
+TEST(InstanceTransforms, ScalarMatchesReference)
+{
+    CheckKernel(Kernel::Scalar, StoreMode::Cached);
+    CheckKernel(Kernel::Scalar, StoreMode::Streaming);
+}
+
+TEST(InstanceTransforms, SSEMatchesReference)
+{
+    CheckKernel(Kernel::SSE, StoreMode::Cached);
+    CheckKernel(Kernel::SSE, StoreMode::Streaming);
+}
+
+TEST(InstanceTransforms, AVX2MatchesReference)
+{
+    CheckKernel(Kernel::AVX2, StoreMode::Cached);
+    CheckKernel(Kernel::AVX2, StoreMode::Streaming);
+}
+
+TEST(InstanceTransforms, AVX2StreamsToUnalignedRowPairs)
+{
+    if (!IsKernelSupported(Kernel::AVX2))
+    {
+        std::printf("  AVX2 is not supported here, skipped\n");
+        return;
+    }
+
+    const size_t count = 64;
+    Instances instances = MakeInstances(count);
+    std::vector<Float4x4> reference(count);
+    Compose(Kernel::Reference, instances.GetSoA(), 0, count, reference.data());
+
+    // 16 bytes past a 32-byte boundary, too little for 256-bit streaming stores.
+    std::vector<float> storage((count + 1) * 16);
+    uintptr_t address = reinterpret_cast<uintptr_t>(storage.data());
+    CHECK(address % 16 == 0);
+    Float4x4 *out = reinterpret_cast<Float4x4 *>(storage.data() + (address % 32 == 0 ? 4 : 0));
+    Compose(Kernel::AVX2, instances.GetSoA(), 0, count, out, StoreMode::Streaming);
+
+    std::vector<Float4x4> transforms(out, out + count);
+    CHECK_NEAR(MaxDifference(transforms, reference, 0, count), 0.0, 2e-6);
+}
+
+TEST(InstanceTransforms, ReferenceComposesScaleRotateTranslate)
+{
+    // A quarter turn about z maps x to y in the row-vector convention.
+    float scale = 2.0f;
+    float angle = 1.57079632679f;
+    float axisX = 0.0f;
+    float axisY = 0.0f;
+    float axisZ = 1.0f;
+    float offsetX = 1.0f;
+    float offsetY = 2.0f;
+    float offsetZ = 3.0f;
+    InstanceSoA instance = {&scale, &angle, &axisX, &axisY, &axisZ, &offsetX, &offsetY, &offsetZ};
+
+    Float4x4 transform;
+    Compose(Kernel::Reference, instance, 0, 1, &transform);
+
+    const float expected[4][4] = {{0, 2, 0, 0}, {-2, 0, 0, 0}, {0, 0, 2, 0}, {1, 2, 3, 1}};
+    for (size_t row = 0; row < 4; row++)
+    {
+        for (size_t column = 0; column < 4; column++)
+        {
+            CHECK_NEAR(transform.m[row][column], expected[row][column], 1e-6);
+        }
+    }
+}
+
+TEST(InstanceTransforms, BestKernelIsSupported)
+{
+    CHECK(IsKernelSupported(GetBestKernel()));
+    CHECK(IsKernelSupported(Kernel::Reference));
+    CHECK(IsKernelSupported(Kernel::Scalar));
+}
+
+namespace
+{
+    // Largest element difference of the upper 3x3, the rotation and scale.
+    float MaxRotationDifference(const Float4x4 &a, const Float4x4 &b)
+    {
+        float difference = 0.0f;
+        for (size_t row = 0; row < 3; row++)
+        {
+            for (size_t column = 0; column < 3; column++)
+            {
+                difference = std::fmax(difference, std::fabs(a.m[row][column] - b.m[row][column]));
+            }
+        }
+        return difference;
+    }
+
+    bool HasSameTranslation(const Float4x4 &a, const Float4x4 &b)
+    {
+        return a.m[0][3] == b.m[0][3] && a.m[1][3] == b.m[1][3] && a.m[2][3] == b.m[2][3] &&
+               a.m[3][0] == b.m[3][0] && a.m[3][1] == b.m[3][1] && a.m[3][2] == b.m[3][2] && a.m[3][3] == b.m[3][3];
+    }
+}
+
+TEST(CompactInstance, RoundTripWithinQuantizationError)
+{
+    const size_t count = 4096;
+    Instances instances = MakeInstances(count);
+
+    std::mt19937 random(5678);
+    std::uniform_real_distribution<float> logScale(-4.0f, 6.0f);
+    for (float &scale : instances.scale)
+    {
+        scale = std::exp2(logScale(random));
+    }
+
+    std::vector<Float4x4> reference(count);
+    std::vector<CompactInstance> compact(count);
+    Compose(Kernel::Reference, instances.GetSoA(), 0, count, reference.data());
+    Compose(Kernel::Reference, instances.GetSoA(), 0, count, compact.data());
+
+    // The half scale is off by up to 2^-11 of itself, the snorm components by
+    // 0.5 / 32767 each, a few of which add up in every matrix element.
+    float maxRelativeError = 0.0f;
+    for (size_t i = 0; i < count; i++)
+    {
+        Float4x4 decoded = DecodeCompact(compact[i]);
+        maxRelativeError = std::fmax(maxRelativeError, MaxRotationDifference(decoded, reference[i]) / instances.scale[i]);
+        CHECK(HasSameTranslation(decoded, reference[i]));
+    }
+    CHECK_NEAR(maxRelativeError, 0.0, 1e-3);
+}
+
+TEST(CompactInstance, SnormEndpoints)
+{
+    CHECK(FloatToSnorm16(1.0f) == 32767);
+    CHECK(FloatToSnorm16(-1.0f) == -32767);
+    CHECK(FloatToSnorm16(0.0f) == 0);
+    CHECK(FloatToSnorm16(2.0f) == 32767);
+    CHECK(FloatToSnorm16(-2.0f) == -32767);
+
+    CHECK(Snorm16ToFloat(32767) == 1.0f);
+    CHECK(Snorm16ToFloat(-32767) == -1.0f);
+    CHECK(Snorm16ToFloat(-32768) == -1.0f);
+    CHECK(Snorm16ToFloat(0) == 0.0f);
+
+    size_t numMismatches = 0;
+    for (int32_t value = -32767; value <= 32767; value++)
+    {
+        if (FloatToSnorm16(Snorm16ToFloat(static_cast<int16_t>(value))) != value)
+        {
+            numMismatches++;
+        }
+    }
+    CHECK(numMismatches == 0);
+}
+
+TEST(CompactInstance, RotationIsStoredWithPositiveW)
+{
+    // -q is the same rotation as q, w is stored non-negative.
+    const float position[3] = {1.0f, 2.0f, 3.0f};
+    const float rotation[4] = {0.0f, 0.0f, 0.0f, -1.0f};
+    CompactInstance instance = EncodeCompact(position, rotation, 1.0f);
+    CHECK(instance.rotation[3] == 32767);
+
+    const float halfTurn[4] = {0.0f, -1.0f, 0.0f, 0.0f};
+    instance = EncodeCompact(position, halfTurn, 1.0f);
+    CHECK(instance.rotation[1] == -32767);
+    CHECK(instance.rotation[3] == 0);
+    CHECK(instance.padding == 0);
+}
+
+TEST(CompactInstance, HalfOverflow)
+{
+    CHECK(FloatToHalf(65504.0f) == 0x7bff);
+    CHECK(FloatToHalf(65519.0f) == 0x7bff);
+    // Halfway to 65536 with an odd mantissa rounds up, to infinity.
+    CHECK(FloatToHalf(65520.0f) == 0x7c00);
+    CHECK(FloatToHalf(1e6f) == 0x7c00);
+    CHECK(FloatToHalf(-1e6f) == 0xfc00);
+    CHECK(FloatToHalf(INFINITY) == 0x7c00);
+    CHECK(FloatToHalf(-INFINITY) == 0xfc00);
+
+    uint16_t nan = FloatToHalf(NAN);
+    CHECK((nan & 0x7c00) == 0x7c00 && (nan & 0x3ff) != 0);
+    CHECK(std::isnan(HalfToFloat(nan)));
+    CHECK(std::isinf(HalfToFloat(0x7c00)));
+}
+
+TEST(CompactInstance, HalfDenormals)
+{
+    CHECK(FloatToHalf(std::ldexp(1.0f, -14)) == 0x0400);
+    CHECK(FloatToHalf(std::ldexp(1.0f, -15)) == 0x0200);
+    CHECK(FloatToHalf(std::ldexp(1.0f, -24)) == 0x0001);
+    CHECK(FloatToHalf(-std::ldexp(1.0f, -24)) == 0x8001);
+    // Halfway to the smallest denormal rounds to even, zero, anything above it does not.
+    CHECK(FloatToHalf(std::ldexp(1.0f, -25)) == 0x0000);
+    CHECK(FloatToHalf(std::ldexp(1.5f, -25)) == 0x0001);
+    CHECK(FloatToHalf(std::ldexp(1.0f, -30)) == 0x0000);
+    CHECK(FloatToHalf(-std::ldexp(1.0f, -30)) == 0x8000);
+
+    CHECK(HalfToFloat(0x0001) == std::ldexp(1.0f, -24));
+    CHECK(HalfToFloat(0x03ff) == std::ldexp(1023.0f, -24));
+}
+
+TEST(CompactInstance, EveryHalfRoundTrips)
+{
+    size_t numMismatches = 0;
+    for (uint32_t bits = 0; bits <= 0xffff; bits++)
+    {
+        uint16_t half = static_cast<uint16_t>(bits);
+        bool isNan = (half & 0x7c00) == 0x7c00 && (half & 0x3ff) != 0;
+        if (!isNan && FloatToHalf(HalfToFloat(half)) != half)
+        {
+            numMismatches++;
+        }
+    }
+    CHECK(numMismatches == 0);
+}
+
+TEST(CompactInstance, ZeroScale)
+{
+    const float position[3] = {4.0f, -5.0f, 6.0f};
+    const float rotation[4] = {0.5f, 0.5f, 0.5f, 0.5f};
+    CompactInstance instance = EncodeCompact(position, rotation, 0.0f);
+    CHECK(instance.scale == 0);
+
+    Float4x4 decoded = DecodeCompact(instance);
+    for (size_t row = 0; row < 3; row++)
+    {
+        for (size_t column = 0; column < 4; column++)
+        {
+            CHECK(decoded.m[row][column] == 0.0f);
+        }
+    }
+    CHECK(decoded.m[3][0] == 4.0f && decoded.m[3][1] == -5.0f && decoded.m[3][2] == 6.0f && decoded.m[3][3] == 1.0f);
+}
+
+TEST(CompactInstance, ZeroQuaternionDecodesToScale)
+{
+    CompactInstance instance = {{0.0f, 0.0f, 0.0f}, {0, 0, 0, 0}, FloatToHalf(2.0f), 0};
+    Float4x4 decoded = DecodeCompact(instance);
+    CHECK(decoded.m[0][0] == 2.0f && decoded.m[1][1] == 2.0f && decoded.m[2][2] == 2.0f);
+    CHECK(decoded.m[0][1] == 0.0f && decoded.m[1][2] == 0.0f && decoded.m[2][0] == 0.0f);
+}
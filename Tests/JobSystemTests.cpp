@@ -0,0 +1,141 @@
+#include "Test.h"
+
+#include "JobSystem.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // How many times ParallelFor visited each element.
+    struct VisitCounts
+    {
+        explicit VisitCounts(size_t count) : counts(std::make_unique<std::atomic<uint32_t>[]>(count)), size(count) {}
+
+        void Visit(size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                counts[i].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        bool AllVisitedOnce() const
+        {
+            for (size_t i = 0; i < size; i++)
+            {
+                if (counts[i].load() != 1)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        std::unique_ptr<std::atomic<uint32_t>[]> counts;
+        size_t size;
+    };
+}
+
+TEST(JobSystem, ParallelForVisitsEveryElementOnce)
+{
+    JobSystem jobSystem(4);
+    for (size_t grainSize : {1, 7, 256, 10'000})
+    {
+        VisitCounts visits(5'000);
+        jobSystem.ParallelFor(0, visits.size, grainSize, [&visits](size_t begin, size_t end)
+                              { visits.Visit(begin, end); });
+        CHECK(visits.AllVisitedOnce());
+    }
+
+    // An empty range does not call the function.
+    bool called = false;
+    jobSystem.ParallelFor(3, 3, 1, [&called](size_t, size_t)
+                          { called = true; });
+    CHECK(!called);
+}
+
+TEST(JobSystem, FullDequeRunsChunksInline)
+{
+    // Without workers nothing runs until ParallelFor waits, except the chunks
+    // that did not fit in the deque, which run as they are submitted.
+    JobSystem jobSystem(1);
+    const size_t count = JobSystem::s_queueCapacity + 100;
+    std::vector<size_t> order;
+    jobSystem.ParallelFor(0, count, 1, [&order](size_t begin, size_t)
+                          { order.push_back(begin); });
+
+    CHECK(order.size() == count);
+    CHECK(order.front() == JobSystem::s_queueCapacity);
+    CHECK(order[99] == count - 1);
+
+    // The queued chunks then run from the back of the deque.
+    CHECK(order[100] == JobSystem::s_queueCapacity - 1);
+    CHECK(order.back() == 0);
+}
+
+TEST(JobSystem, NestedParallelForOnWorkers)
+{
+    JobSystem jobSystem(4);
+    const size_t numOuter = 16;
+    const size_t numInner = 1'000;
+    VisitCounts visits(numOuter * numInner);
+
+    // Each outer chunk waits for its inner loop, helping with any job meanwhile.
+    jobSystem.ParallelFor(0, numOuter, 1, [&](size_t outerBegin, size_t outerEnd)
+                          {
+                              for (size_t outer = outerBegin; outer < outerEnd; outer++)
+                              {
+                                  jobSystem.ParallelFor(outer * numInner, (outer + 1) * numInner, 64, [&visits](size_t begin, size_t end)
+                                                        { visits.Visit(begin, end); });
+                              } });
+    CHECK(visits.AllVisitedOnce());
+}
+
+TEST(JobSystem, ExternalThreadsSubmitJobs)
+{
+    JobSystem jobSystem(2);
+    VisitCounts visits(10'000);
+    std::atomic<uint32_t> numSubmitted = 0;
+
+    // Threads the job system does not own spread their jobs over all deques.
+    std::thread external([&]()
+                         {
+                             jobSystem.ParallelFor(0, visits.size, 100, [&visits](size_t begin, size_t end)
+                                                   { visits.Visit(begin, end); });
+
+                             JobSystem::JobCounter counter = 8;
+                             for (size_t i = 0; i < 8; i++)
+                             {
+                                 jobSystem.Submit({[](void *context, size_t, size_t)
+                                                   { static_cast<std::atomic<uint32_t> *>(context)->fetch_add(1); },
+                                                   &numSubmitted, 0, 0, &counter});
+                             }
+                             jobSystem.Wait(counter); });
+    external.join();
+
+    CHECK(visits.AllVisitedOnce());
+    CHECK(numSubmitted.load() == 8);
+}
+
+TEST(JobSystem, SetNumThreadsWhileIdle)
+{
+    JobSystem jobSystem(1);
+    for (uint32_t numThreads : {4u, 2u, 1u, 3u})
+    {
+        jobSystem.SetNumThreads(numThreads);
+        CHECK(jobSystem.GetNumThreads() == numThreads);
+
+        VisitCounts visits(2'000);
+        jobSystem.ParallelFor(0, visits.size, jobSystem.ComputeGrainSize(visits.size, sizeof(uint32_t)), [&visits](size_t begin, size_t end)
+                              { visits.Visit(begin, end); });
+        CHECK(visits.AllVisitedOnce());
+    }
+
+    // Zero threads still keeps the calling thread.
+    jobSystem.SetNumThreads(0);
+    CHECK(jobSystem.GetNumThreads() == 1);
+}
@@ -0,0 +1,143 @@
+#include "Test.h"
+
+#include "LruResidencySet.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+    // Stand-ins for the pageable objects, only their addresses are used.
+    int g_objects[8];
+
+    LruResidencySet::Key Object(size_t index)
+    {
+        return &g_objects[index];
+    }
+
+    // Evictions needed for the usage to fit a budget, as ResidencyManager does.
+    std::vector<LruResidencySet::Key> FitBudget(LruResidencySet &set, uint64_t budget, uint64_t completedFenceValue)
+    {
+        std::vector<LruResidencySet::Key> evictions;
+        if (set.GetResidentBytes() > budget)
+        {
+            set.SelectEvictions(set.GetResidentBytes() - budget, completedFenceValue, evictions);
+        }
+        return evictions;
+    }
+}
+
+TEST(LruResidencySet, EvictsLeastRecentlyUsedFirst)
+{
+    LruResidencySet set;
+    for (size_t i = 0; i < 4; i++)
+    {
+        set.Add(Object(i), 100, 1);
+    }
+    CHECK(set.GetNumObjects() == 4);
+    CHECK(set.GetResidentBytes() == 400);
+
+    std::vector<LruResidencySet::Key> evictions;
+    CHECK(set.SelectEvictions(150, 1, evictions) == 200);
+    CHECK((evictions == std::vector<LruResidencySet::Key>{Object(0), Object(1)}));
+    CHECK(!set.IsResident(Object(0)) && !set.IsResident(Object(1)));
+    CHECK(set.IsResident(Object(2)) && set.IsResident(Object(3)));
+    CHECK(set.GetResidentBytes() == 200);
+    CHECK(set.GetEvictedBytes() == 200);
+
+    // Evicted objects stay tracked.
+    CHECK(set.Contains(Object(0)));
+    CHECK(set.GetNumObjects() == 4);
+
+    // Nothing to evict.
+    evictions.clear();
+    CHECK(set.SelectEvictions(0, 1, evictions) == 0);
+    CHECK(evictions.empty());
+}
+
+TEST(LruResidencySet, TouchMovesToMostRecentlyUsed)
+{
+    LruResidencySet set;
+    for (size_t i = 0; i < 4; i++)
+    {
+        set.Add(Object(i), 100, 1);
+    }
+
+    // Used by the next submission in the order 2, 0.
+    CHECK(!set.MarkUsed(Object(2), 2));
+    CHECK(!set.MarkUsed(Object(0), 2));
+
+    std::vector<LruResidencySet::Key> evictions;
+    set.SelectEvictions(400, 2, evictions);
+    CHECK((evictions == std::vector<LruResidencySet::Key>{Object(1), Object(3), Object(2), Object(0)}));
+    CHECK(set.GetResidentBytes() == 0);
+
+    // Using an evicted object makes it resident again, the caller has to page it in.
+    CHECK(set.MarkUsed(Object(3), 3));
+    CHECK(set.IsResident(Object(3)));
+    CHECK(set.GetResidentBytes() == 100);
+    CHECK(set.GetEvictedBytes() == 300);
+
+    evictions.clear();
+    set.Add(Object(4), 50, 3);
+    set.SelectEvictions(150, 3, evictions);
+    CHECK((evictions == std::vector<LruResidencySet::Key>{Object(3), Object(4)}));
+}
+
+TEST(LruResidencySet, KeepsObjectsTheGpuMayUse)
+{
+    LruResidencySet set;
+    set.Add(Object(0), 100, 1);
+    set.Add(Object(1), 100, 2);
+    set.Add(Object(2), 100, 3);
+
+    // Submission 2 is still running, eviction stops at the first object it uses.
+    std::vector<LruResidencySet::Key> evictions;
+    CHECK(set.SelectEvictions(300, 1, evictions) == 100);
+    CHECK((evictions == std::vector<LruResidencySet::Key>{Object(0)}));
+
+    evictions.clear();
+    CHECK(set.SelectEvictions(300, 1, evictions) == 0);
+    CHECK(evictions.empty());
+
+    evictions.clear();
+    CHECK(set.SelectEvictions(300, 3, evictions) == 200);
+    CHECK((evictions == std::vector<LruResidencySet::Key>{Object(1), Object(2)}));
+}
+
+TEST(LruResidencySet, BudgetShrinkEvictsInUseOrder)
+{
+    LruResidencySet set;
+    const uint64_t sizes[] = {300, 100, 200, 100, 400, 100};
+    for (size_t i = 0; i < 6; i++)
+    {
+        set.Add(Object(i), sizes[i], 1);
+    }
+
+    // Frames 2 to 4 use objects 0, 2 and 4, then 1.
+    set.MarkUsed(Object(0), 2);
+    set.MarkUsed(Object(2), 3);
+    set.MarkUsed(Object(4), 3);
+    set.MarkUsed(Object(1), 4);
+    CHECK(FitBudget(set, 1200, 4).empty());
+
+    // The budget shrinks to 900 bytes, the 300 bytes over come from the least
+    // recently used objects until enough are evicted.
+    std::vector<LruResidencySet::Key> evictions = FitBudget(set, 900, 4);
+    CHECK((evictions == std::vector<LruResidencySet::Key>{Object(3), Object(5), Object(0)}));
+    CHECK(set.GetResidentBytes() == 700);
+
+    // Shrinking again while frame 4 is in flight only evicts what frame 3 used.
+    evictions = FitBudget(set, 0, 3);
+    CHECK((evictions == std::vector<LruResidencySet::Key>{Object(2), Object(4)}));
+    CHECK(set.GetResidentBytes() == 100);
+    CHECK(set.IsResident(Object(1)));
+
+    // Removing an object forgets it, resident or not.
+    set.Remove(Object(1));
+    set.Remove(Object(3));
+    CHECK(set.GetNumObjects() == 4);
+    CHECK(set.GetResidentBytes() == 0);
+    CHECK(set.GetEvictedBytes() == 1000);
+    CHECK(!set.Contains(Object(1)) && !set.IsResident(Object(1)));
+}
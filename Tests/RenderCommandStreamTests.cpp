@@ -0,0 +1,230 @@
+#include "Test.h"
+
+#include "HeapStats.h"
+#include "RenderCommandStream.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    using CommandType = RenderCommandStream::CommandType;
+
+    // Types of the packets in recording order.
+    std::vector<CommandType> GetPacketTypes(const RenderCommandStream &stream)
+    {
+        std::vector<CommandType> types;
+        for (uint32_t offset = 0; offset < stream.GetSize(); offset += stream.GetHeader(offset).size)
+        {
+            types.push_back(stream.GetHeader(offset).type);
+        }
+        return types;
+    }
+
+    // Pipeline of every sorted draw, s_none for barriers.
+    std::vector<uint32_t> GetSortedPipelines(const RenderCommandStream &stream)
+    {
+        std::vector<uint32_t> pipelines;
+        for (const RenderCommandStream::SortedCommand &command : stream.GetSortedCommands())
+        {
+            bool isDraw = stream.GetHeader(command.offset).type == CommandType::DrawIndexedInstanced;
+            pipelines.push_back(isDraw ? stream.GetPacket<RenderCommandStream::SetPipelinePacket>(command.pipelineOffset).pipeline : RenderCommandStream::s_none);
+        }
+        return pipelines;
+    }
+
+    // firstInstance of every sorted draw, the draws are told apart by it.
+    std::vector<uint32_t> GetSortedDraws(const RenderCommandStream &stream)
+    {
+        std::vector<uint32_t> draws;
+        for (const RenderCommandStream::SortedCommand &command : stream.GetSortedCommands())
+        {
+            if (stream.GetHeader(command.offset).type == CommandType::DrawIndexedInstanced)
+            {
+                draws.push_back(stream.GetPacket<RenderCommandStream::DrawIndexedInstancedPacket>(command.offset).firstInstance);
+            }
+        }
+        return draws;
+    }
+}
+
+TEST(RenderCommandStream, RecordsPacketsInOrder)
+{
+    RenderCommandStream stream;
+    const uint32_t constants[3] = {1, 2, 3};
+    stream.SetPipeline(7);
+    stream.SetVertexBuffer(1, 0x10000, 256, 16);
+    stream.SetIndexBuffer(0x20000, 128, 2);
+    stream.SetRootConstants(2, constants, 3);
+    stream.DrawIndexedInstanced(36, 10, 6, -4, 100);
+    stream.Barrier(5, RenderCommandStream::ResourceState::ShaderResource);
+
+    CHECK(stream.GetNumPackets() == 6);
+    CHECK(stream.GetNumDraws() == 1);
+    CHECK((GetPacketTypes(stream) == std::vector<CommandType>{CommandType::SetPipeline, CommandType::SetVertexBuffer, CommandType::SetIndexBuffer,
+                                                               CommandType::SetRootConstants, CommandType::DrawIndexedInstanced, CommandType::Barrier}));
+
+    bool aligned = true;
+    for (uint32_t offset = 0; offset < stream.GetSize(); offset += stream.GetHeader(offset).size)
+    {
+        aligned = aligned && offset % 4 == 0 && stream.GetHeader(offset).size % 4 == 0;
+    }
+    CHECK(aligned);
+
+    // The packets read back as recorded, 64-bit fields included.
+    uint32_t offset = 0;
+    CHECK(stream.GetPacket<RenderCommandStream::SetPipelinePacket>(offset).pipeline == 7);
+    offset += stream.GetHeader(offset).size;
+    RenderCommandStream::SetVertexBufferPacket vertexBuffer = stream.GetPacket<RenderCommandStream::SetVertexBufferPacket>(offset);
+    CHECK(vertexBuffer.slot == 1 && vertexBuffer.address == 0x10000 && vertexBuffer.size == 256 && vertexBuffer.stride == 16);
+    offset += stream.GetHeader(offset).size;
+    RenderCommandStream::SetIndexBufferPacket indexBuffer = stream.GetPacket<RenderCommandStream::SetIndexBufferPacket>(offset);
+    CHECK(indexBuffer.address == 0x20000 && indexBuffer.size == 128 && indexBuffer.indexSize == 2);
+    offset += stream.GetHeader(offset).size;
+    RenderCommandStream::SetRootConstantsPacket rootConstants = stream.GetPacket<RenderCommandStream::SetRootConstantsPacket>(offset);
+    CHECK(rootConstants.rootParameterIndex == 2 && rootConstants.numValues == 3);
+    CHECK(std::memcmp(stream.GetRootConstantValues(offset), constants, sizeof(constants)) == 0);
+    offset += stream.GetHeader(offset).size;
+    RenderCommandStream::DrawIndexedInstancedPacket draw = stream.GetPacket<RenderCommandStream::DrawIndexedInstancedPacket>(offset);
+    CHECK(draw.indexCount == 36 && draw.instanceCount == 10 && draw.firstIndex == 6 && draw.baseVertex == -4 && draw.firstInstance == 100);
+    offset += stream.GetHeader(offset).size;
+    RenderCommandStream::BarrierPacket barrier = stream.GetPacket<RenderCommandStream::BarrierPacket>(offset);
+    CHECK(barrier.resource == 5 && barrier.stateAfter == RenderCommandStream::ResourceState::ShaderResource);
+    CHECK(offset + stream.GetHeader(offset).size == stream.GetSize());
+
+    stream.Reset();
+    CHECK(stream.GetSize() == 0 && stream.GetNumPackets() == 0 && stream.GetNumDraws() == 0);
+    stream.Sort();
+    CHECK(stream.GetSortedCommands().empty());
+}
+
+TEST(RenderCommandStream, SortsDrawsByState)
+{
+    RenderCommandStream stream;
+    const uint32_t pipelines[] = {3, 1, 2, 1, 3, 1};
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        stream.SetPipeline(pipelines[i]);
+        // Within a pipeline the vertex buffer orders the draws, against recording order.
+        stream.SetVertexBuffer(0, i == 5 ? 0x1000 : 0x2000, 64, 16);
+        stream.DrawIndexedInstanced(3, 1, 0, 0, i);
+    }
+    stream.Sort();
+
+    CHECK(stream.GetSortedCommands().size() == 6);
+    CHECK((GetSortedPipelines(stream) == std::vector<uint32_t>{1, 1, 1, 2, 3, 3}));
+    CHECK((GetSortedDraws(stream) == std::vector<uint32_t>{5, 1, 3, 2, 0, 4}));
+}
+
+TEST(RenderCommandStream, KeepsRecordingOrderAmongEqualState)
+{
+    RenderCommandStream stream;
+    stream.SetPipeline(1);
+    stream.SetVertexBuffer(0, 0x1000, 64, 16);
+    stream.SetIndexBuffer(0x2000, 64, 4);
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        stream.DrawIndexedInstanced(3, 1, 0, 0, i);
+    }
+    stream.Sort();
+
+    std::vector<uint32_t> draws = GetSortedDraws(stream);
+    bool inOrder = draws.size() == 100;
+    for (uint32_t i = 0; inOrder && i < 100; i++)
+    {
+        inOrder = draws[i] == i;
+    }
+    CHECK(inOrder);
+}
+
+TEST(RenderCommandStream, DrawsDoNotCrossBarriers)
+{
+    RenderCommandStream stream;
+    stream.SetPipeline(2);
+    stream.DrawIndexedInstanced(3, 1, 0, 0, 0);
+    stream.SetPipeline(1);
+    stream.DrawIndexedInstanced(3, 1, 0, 0, 1);
+    stream.Barrier(0, RenderCommandStream::ResourceState::RenderTarget);
+    // Set before the barrier, still bound after it.
+    stream.DrawIndexedInstanced(3, 1, 0, 0, 2);
+    stream.SetPipeline(0);
+    stream.DrawIndexedInstanced(3, 1, 0, 0, 3);
+    stream.Barrier(1, RenderCommandStream::ResourceState::Common);
+    stream.Sort();
+
+    const uint32_t barrier = RenderCommandStream::s_none;
+    CHECK((GetSortedPipelines(stream) == std::vector<uint32_t>{1, 2, barrier, 0, 1, barrier}));
+    CHECK((GetSortedDraws(stream) == std::vector<uint32_t>{1, 0, 3, 2}));
+}
+
+TEST(RenderCommandStream, DrawsCarryTheirState)
+{
+    RenderCommandStream stream;
+    const uint32_t first[1] = {10};
+    const uint32_t second[1] = {20};
+
+    // Nothing bound yet.
+    stream.DrawIndexedInstanced(3, 1, 0, 0, 0);
+    stream.SetPipeline(1);
+    stream.SetVertexBuffer(0, 0x1000, 64, 16);
+    stream.SetVertexBuffer(2, 0x3000, 64, 16);
+    stream.SetIndexBuffer(0x2000, 64, 4);
+    stream.SetRootConstants(0, first, 1);
+    stream.DrawIndexedInstanced(3, 1, 0, 0, 1);
+    stream.SetRootConstants(0, second, 1);
+    stream.DrawIndexedInstanced(3, 1, 0, 0, 2);
+    stream.Sort();
+
+    const std::vector<RenderCommandStream::SortedCommand> &commands = stream.GetSortedCommands();
+    CHECK(commands.size() == 3);
+
+    // The unbound draw sorts last, s_none is the largest pipeline handle.
+    const RenderCommandStream::SortedCommand &unbound = commands[2];
+    CHECK(stream.GetPacket<RenderCommandStream::DrawIndexedInstancedPacket>(unbound.offset).firstInstance == 0);
+    CHECK(unbound.pipelineOffset == RenderCommandStream::s_none && unbound.indexBufferOffset == RenderCommandStream::s_none);
+    CHECK(unbound.vertexBufferOffsets[0] == RenderCommandStream::s_none && unbound.rootConstantsOffsets[0] == RenderCommandStream::s_none);
+
+    const RenderCommandStream::SortedCommand &bound = commands[0];
+    CHECK(stream.GetPacket<RenderCommandStream::SetVertexBufferPacket>(bound.vertexBufferOffsets[0]).address == 0x1000);
+    CHECK(bound.vertexBufferOffsets[1] == RenderCommandStream::s_none);
+    CHECK(stream.GetPacket<RenderCommandStream::SetVertexBufferPacket>(bound.vertexBufferOffsets[2]).address == 0x3000);
+    CHECK(stream.GetPacket<RenderCommandStream::SetIndexBufferPacket>(bound.indexBufferOffset).address == 0x2000);
+    CHECK(std::memcmp(stream.GetRootConstantValues(bound.rootConstantsOffsets[0]), first, sizeof(first)) == 0);
+    CHECK(std::memcmp(stream.GetRootConstantValues(commands[1].rootConstantsOffsets[0]), second, sizeof(second)) == 0);
+}
+
+TEST(RenderCommandStream, SortDoesNotAllocateOnceWarm)
+{
+    RenderCommandStream stream;
+    const uint32_t constants[4] = {1, 2, 3, 4};
+    auto record = [&stream, &constants]()
+    {
+        stream.Reset();
+        for (uint32_t i = 0; i < 1000; i++)
+        {
+            stream.SetPipeline(i % 7);
+            stream.SetVertexBuffer(0, 0x1000 * (i % 5), 64, 16);
+            stream.SetRootConstants(0, constants, 4);
+            stream.DrawIndexedInstanced(3, 1, 0, 0, i);
+            if (i % 100 == 99)
+            {
+                stream.Barrier(0, RenderCommandStream::ResourceState::ShaderResource);
+            }
+        }
+    };
+
+    // The first frame sizes the packet, sort entry and sorted command storage.
+    record();
+    stream.Sort();
+
+    uint64_t numAllocations = HeapStats::GetNumAllocations();
+    for (size_t frame = 0; frame < 10; frame++)
+    {
+        record();
+        stream.Sort();
+        stream.Sort();
+    }
+    CHECK(HeapStats::GetNumAllocations() == numAllocations);
+    CHECK(stream.GetSortedCommands().size() == 1010);
+}
@@ -0,0 +1,210 @@
+#include "Test.h"
+
+#include "FakeFence.h"
+#include "GrowingRingAllocator.h"
+#include "RingAllocator.h"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace
+{
+    struct Range
+    {
+        size_t offset;
+        size_t size;
+        uint64_t fenceValue;
+    };
+}
+
+TEST(RingAllocator, WrapsAround)
+{
+    RingAllocator allocator(1024);
+    FakeFence fence;
+
+    CHECK(allocator.Allocate(400, 1) == 0);
+    allocator.Submit(fence.Signal());
+    CHECK(allocator.Allocate(400, 1) == 400);
+    allocator.Submit(fence.Signal());
+    CHECK(allocator.GetNumSubmittedBatches() == 2);
+
+    // 224 bytes are left at the end, the first batch frees the start.
+    fence.Complete(1);
+    allocator.Reclaim(fence.completedValue);
+    CHECK(allocator.GetUsedBytes() == 400);
+    CHECK(allocator.Allocate(300, 1) == 0);
+    // The skipped end counts as used until the batch that wrapped completes.
+    CHECK(allocator.GetUsedBytes() == 400 + 224 + 300);
+    allocator.Submit(fence.Signal());
+
+    fence.Complete(2);
+    allocator.Reclaim(fence.completedValue);
+    CHECK(allocator.GetUsedBytes() == 224 + 300);
+    // Up to the tail but not past it.
+    CHECK(allocator.Allocate(501, 1) == RingAllocator::s_invalidOffset);
+    CHECK(allocator.Allocate(500, 1) == 300);
+
+    fence.Complete(3);
+    allocator.Reclaim(fence.completedValue);
+    CHECK(allocator.GetUsedBytes() == 500);
+}
+
+TEST(RingAllocator, FullRingWaitsForTheFence)
+{
+    RingAllocator allocator(1024);
+    FakeFence fence;
+
+    CHECK(allocator.Allocate(512, 1) == 0);
+    CHECK(allocator.Allocate(512, 1) == 512);
+    uint64_t fenceValue = fence.Signal();
+    allocator.Submit(fenceValue);
+
+    // Nothing frees until the GPU is done with the batch.
+    CHECK(allocator.Allocate(1, 1) == RingAllocator::s_invalidOffset);
+    allocator.Reclaim(fence.completedValue);
+    CHECK(allocator.Allocate(1, 1) == RingAllocator::s_invalidOffset);
+    CHECK(allocator.GetUsedBytes() == 1024);
+
+    fence.Complete(fenceValue);
+    allocator.Reclaim(fence.completedValue);
+    CHECK(allocator.GetUsedBytes() == 0);
+    CHECK(allocator.GetNumSubmittedBatches() == 0);
+    CHECK(allocator.Allocate(1024, 1) == 0);
+
+    // Too large for the ring at all.
+    CHECK(RingAllocator(64).Allocate(65, 1) == RingAllocator::s_invalidOffset);
+}
+
+TEST(RingAllocator, AlignsAndRetiresInFenceOrder)
+{
+    RingAllocator allocator(4096);
+    FakeFence fence;
+
+    CHECK(allocator.Allocate(3, 1) == 0);
+    CHECK(allocator.Allocate(16, 256) == 256);
+    // The padding is used until the batch completes.
+    CHECK(allocator.GetPendingBytes() == 256 + 16);
+    allocator.Submit(fence.Signal());
+    CHECK(allocator.GetPendingBytes() == 0);
+
+    // An empty batch is not recorded.
+    allocator.Submit(fence.Signal());
+    CHECK(allocator.GetNumSubmittedBatches() == 1);
+
+    allocator.Allocate(100, 1);
+    allocator.Submit(fence.Signal());
+    allocator.Allocate(100, 1);
+    allocator.Submit(fence.Signal());
+    CHECK(allocator.GetNumSubmittedBatches() == 3);
+
+    // Completing the third submission frees the batches up to it, not the last.
+    fence.Complete(3);
+    allocator.Reclaim(fence.completedValue);
+    CHECK(allocator.GetNumSubmittedBatches() == 1);
+    CHECK(allocator.GetUsedBytes() == 100);
+}
+
+TEST(RingAllocator, RandomUploadsStayInsideTheRing)
+{
+    const size_t capacity = 64 * 1024;
+    RingAllocator allocator(capacity);
+    FakeFence fence;
+    std::mt19937 random(21);
+
+    // The GPU runs up to three submissions behind.
+    std::vector<Range> live;
+    bool consistent = true;
+    for (size_t frame = 0; frame < 2000; frame++)
+    {
+        uint64_t fenceValue = fence.nextValue;
+        for (size_t i = 0, count = random() % 8; i < count; i++)
+        {
+            size_t size = 1 + random() % 4096;
+            size_t alignment = size_t(1) << (random() % 9);
+            size_t offset = allocator.Allocate(size, alignment);
+            if (offset == RingAllocator::s_invalidOffset)
+            {
+                continue;
+            }
+            consistent = consistent && offset % alignment == 0 && offset + size <= capacity;
+            for (const Range &range : live)
+            {
+                consistent = consistent && (offset + size <= range.offset || range.offset + range.size <= offset);
+            }
+            live.push_back({offset, size, fenceValue});
+        }
+        allocator.Submit(fence.Signal());
+
+        if (fence.nextValue > 4)
+        {
+            fence.Complete(fence.nextValue - 4);
+            allocator.Reclaim(fence.completedValue);
+            std::erase_if(live, [&fence](const Range &range)
+                          { return range.fenceValue <= fence.completedValue; });
+        }
+    }
+    CHECK(consistent);
+
+    fence.Complete(fence.nextValue - 1);
+    allocator.Reclaim(fence.completedValue);
+    CHECK(allocator.GetUsedBytes() == 0);
+}
+
+TEST(RingAllocator, GrowsInsteadOfFailing)
+{
+    GrowingRingAllocator allocator(1024);
+    FakeFence fence;
+
+    GrowingRingAllocator::Allocation first = allocator.Allocate(800, 1);
+    CHECK(first.offset == 0 && !first.grew);
+    allocator.Submit(fence.Signal());
+
+    // Does not fit while the first batch is in flight.
+    GrowingRingAllocator::Allocation second = allocator.Allocate(800, 1);
+    CHECK(second.offset == 0 && second.grew);
+    CHECK(allocator.GetCapacity() == 2048);
+    CHECK(allocator.GetNumGrowths() == 1);
+
+    // Larger than twice the capacity, the ring grows to fit it.
+    GrowingRingAllocator::Allocation third = allocator.Allocate(5000, 16);
+    CHECK(third.grew);
+    CHECK(allocator.GetCapacity() == 8192);
+    CHECK(allocator.GetNumGrowths() == 2);
+    CHECK(allocator.GetPeakUsedBytes() == 5000);
+
+    // Once the new ring has room it stops growing.
+    allocator.Submit(fence.Signal());
+    fence.Complete(2);
+    allocator.Reclaim(fence.completedValue);
+    CHECK(!allocator.Allocate(8000, 1).grew);
+}
+
+TEST(RingAllocator, RetiresGrownOutRings)
+{
+    GrowingRingAllocator allocator(1024);
+    FakeFence fence;
+
+    // Ring 0 was last used by submission 1.
+    allocator.Allocate(1024, 1);
+    allocator.Submit(fence.Signal());
+    allocator.Allocate(1024, 1);
+    CHECK(allocator.GetNumRetiredRings() == 1);
+
+    // Ring 1 is retired with pending allocations, they go out with submission 2.
+    allocator.Allocate(2048, 1);
+    CHECK(allocator.GetNumRetiredRings() == 2);
+    allocator.Submit(fence.Signal());
+
+    // Ring 0 is freed first, ring 1 only once submission 2 completes.
+    allocator.Reclaim(fence.completedValue);
+    CHECK(allocator.GetNumRetiredRings() == 2);
+    fence.Complete(1);
+    allocator.Reclaim(fence.completedValue);
+    CHECK(allocator.GetNumRetiredRings() == 1);
+    fence.Complete(2);
+    allocator.Reclaim(fence.completedValue);
+    CHECK(allocator.GetNumRetiredRings() == 0);
+    CHECK(allocator.GetUsedBytes() == 0);
+    CHECK(allocator.GetCapacity() == 4096);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Minimal test registry. TEST(Suite, Name) defines a test case, CHECK records a
+// failure and carries on with the rest of the case.
+namespace Test
+{
+    struct Case
+    {
+        const char *suite;
+        const char *name;
+        void (*function)();
+    };
+
+    std::vector<Case> &GetCases();
+
+    void Fail(const char *file, int line, const char *expression);
+    void FailNear(const char *file, int line, const char *expression, double value, double expected, double tolerance);
+
+    struct Registrar
+    {
+        Registrar(const char *suite, const char *name, void (*function)())
+        {
+            GetCases().push_back({suite, name, function});
+        }
+    };
+}
+
+#define TEST(suite, name)                                                                           \
+    static void Test_##suite##_##name();                                                            \
+    static const Test::Registrar g_registrar_##suite##_##name(#suite, #name, &Test_##suite##_##name); \
+    static void Test_##suite##_##name()
+
+#define CHECK(expression) ((expression) ? void(0) : Test::Fail(__FILE__, __LINE__, #expression))
+
+#define CHECK_NEAR(value, expected, tolerance)                                                                                                      \
+    do                                                                                                                                              \
+    {                                                                                                                                               \
+        double checkValue = static_cast<double>(value);                                                                                             \
+        double checkExpected = static_cast<double>(expected);                                                                                       \
+        double checkTolerance = static_cast<double>(tolerance);                                                                                     \
+        if (!(checkValue - checkExpected <= checkTolerance && checkExpected - checkValue <= checkTolerance))                                        \
+        {                                                                                                                                           \
+            Test::FailNear(__FILE__, __LINE__, #value " ~ " #expected, checkValue, checkExpected, checkTolerance);                                  \
+        }                                                                                                                                           \
+    } while (false)
@@ -0,0 +1,64 @@
+#include "Test.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace Test
+{
+    namespace
+    {
+        size_t g_numFailures = 0;
+    }
+
+    std::vector<Case> &GetCases()
+    {
+        static std::vector<Case> cases;
+        return cases;
+    }
+
+    void Fail(const char *file, int line, const char *expression)
+    {
+        std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expression);
+        g_numFailures++;
+    }
+
+    void FailNear(const char *file, int line, const char *expression, double value, double expected, double tolerance)
+    {
+        std::fprintf(stderr, "%s:%d: CHECK_NEAR(%s) failed, %.9g vs %.9g, tolerance %.3g\n", file, line, expression, value, expected, tolerance);
+        g_numFailures++;
+    }
+}
+
+// Runs every test case, or the ones of the suite given as the first argument.
+int main(int argc, char **argv)
+{
+    const char *suite = argc > 1 ? argv[1] : nullptr;
+
+    size_t numRun = 0;
+    size_t numFailed = 0;
+    for (const Test::Case &testCase : Test::GetCases())
+    {
+        if (suite && std::strcmp(suite, testCase.suite) != 0)
+        {
+            continue;
+        }
+
+        size_t failuresBefore = Test::g_numFailures;
+        testCase.function();
+        bool passed = Test::g_numFailures == failuresBefore;
+        std::printf("[%s] %s.%s\n", passed ? "  OK  " : " FAIL ", testCase.suite, testCase.name);
+
+        numRun++;
+        numFailed += passed ? 0 : 1;
+    }
+
+    // A suite without any case is a typo, not a pass.
+    if (numRun == 0)
+    {
+        std::fprintf(stderr, "No test cases in suite %s\n", suite ? suite : "(all)");
+        return 1;
+    }
+
+    std::printf("%zu of %zu test cases passed\n", numRun - numFailed, numRun);
+    return numFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+#include "Test.h"
+
+#include "TlsfAllocator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace
+{
+    struct Range
+    {
+        uint64_t offset;
+        uint64_t size;
+        TlsfAllocator::Handle handle;
+    };
+
+    // Whether the live ranges are inside the allocator and do not overlap.
+    bool AreDisjoint(std::vector<Range> ranges, uint64_t size)
+    {
+        std::sort(ranges.begin(), ranges.end(), [](const Range &a, const Range &b)
+                  { return a.offset < b.offset; });
+        for (size_t i = 0; i < ranges.size(); i++)
+        {
+            if (ranges[i].offset + ranges[i].size > size || (i > 0 && ranges[i - 1].offset + ranges[i - 1].size > ranges[i].offset))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+TEST(TlsfAllocator, SplitsAndMerges)
+{
+    TlsfAllocator allocator(1024);
+    CHECK(allocator.GetNumFreeBlocks() == 1);
+
+    TlsfAllocator::Allocation a = allocator.Allocate(100, 1);
+    TlsfAllocator::Allocation b = allocator.Allocate(200, 1);
+    TlsfAllocator::Allocation c = allocator.Allocate(300, 1);
+    CHECK(a.offset == 0 && b.offset == 100 && c.offset == 300);
+    CHECK(allocator.GetNumAllocations() == 3);
+    CHECK(allocator.GetUsedBytes() == 600);
+    // Only the tail after c is free.
+    CHECK(allocator.GetNumFreeBlocks() == 1);
+    CHECK(allocator.GetLargestFreeBlock() == 424);
+
+    // b leaves a hole between two used blocks.
+    allocator.Free(b.handle);
+    CHECK(allocator.GetNumFreeBlocks() == 2);
+    CHECK(allocator.GetLargestFreeBlock() == 424);
+
+    // a merges with the hole after it.
+    allocator.Free(a.handle);
+    CHECK(allocator.GetNumFreeBlocks() == 2);
+
+    // The hole is reused, and split again.
+    TlsfAllocator::Allocation d = allocator.Allocate(250, 1);
+    CHECK(d.offset == 0);
+    CHECK(allocator.GetNumFreeBlocks() == 2);
+    allocator.Free(d.handle);
+
+    // c merges with both neighbours.
+    allocator.Free(c.handle);
+    CHECK(allocator.GetNumFreeBlocks() == 1);
+    CHECK(allocator.GetLargestFreeBlock() == 1024);
+    CHECK(allocator.GetUsedBytes() == 0);
+    CHECK(allocator.GetNumAllocations() == 0);
+}
+
+TEST(TlsfAllocator, AlignsOffsets)
+{
+    TlsfAllocator allocator(1 << 20);
+
+    // The padding in front of an aligned allocation stays free.
+    TlsfAllocator::Allocation small = allocator.Allocate(1, 1);
+    TlsfAllocator::Allocation aligned = allocator.Allocate(64, 256);
+    CHECK(small.offset == 0);
+    CHECK(aligned.offset == 256);
+    CHECK(allocator.GetUsedBytes() == 65);
+    // Requests are rounded up to the next bin, 240 bytes still map to the padding's.
+    TlsfAllocator::Allocation padding = allocator.Allocate(240, 1);
+    CHECK(padding.offset == 1);
+
+    std::mt19937 random(42);
+    std::vector<Range> ranges;
+    bool allAligned = true;
+    for (size_t i = 0; i < 500; i++)
+    {
+        uint64_t alignment = uint64_t(1) << (random() % 17);
+        uint64_t size = 1 + random() % 1000;
+        TlsfAllocator::Allocation allocation = allocator.Allocate(size, alignment);
+        if (allocation.handle == TlsfAllocator::s_invalidHandle)
+        {
+            continue;
+        }
+        allAligned = allAligned && allocation.offset % alignment == 0;
+        ranges.push_back({allocation.offset, size, allocation.handle});
+    }
+    CHECK(allAligned);
+    CHECK(AreDisjoint(ranges, allocator.GetSize()));
+}
+
+TEST(TlsfAllocator, Exhaustion)
+{
+    TlsfAllocator allocator(4096);
+
+    CHECK(allocator.Allocate(4097, 1).handle == TlsfAllocator::s_invalidHandle);
+    CHECK(allocator.Allocate(UINT64_MAX, 1).handle == TlsfAllocator::s_invalidHandle);
+
+    TlsfAllocator::Allocation all = allocator.Allocate(4096, 4096);
+    CHECK(all.handle != TlsfAllocator::s_invalidHandle && all.offset == 0);
+    CHECK(allocator.GetFreeBytes() == 0);
+    CHECK(allocator.GetLargestFreeBlock() == 0);
+    CHECK(allocator.Allocate(1, 1).handle == TlsfAllocator::s_invalidHandle);
+
+    allocator.Free(all.handle);
+    CHECK(allocator.GetFreeBytes() == 4096);
+
+    // Space is left but none of it is aligned.
+    TlsfAllocator::Allocation front = allocator.Allocate(1, 1);
+    CHECK(allocator.Allocate(4095, 4096).handle == TlsfAllocator::s_invalidHandle);
+    CHECK(allocator.Allocate(2048, 1).handle != TlsfAllocator::s_invalidHandle);
+    allocator.Free(front.handle);
+
+    TlsfAllocator empty(0);
+    CHECK(empty.Allocate(1, 1).handle == TlsfAllocator::s_invalidHandle);
+}
+
+TEST(TlsfAllocator, Fragmentation)
+{
+    TlsfAllocator allocator(16 * 1024);
+    CHECK(allocator.GetFragmentation() == 0.0);
+
+    std::vector<TlsfAllocator::Handle> handles;
+    for (size_t i = 0; i < 16; i++)
+    {
+        handles.push_back(allocator.Allocate(1024, 1024).handle);
+    }
+    CHECK(allocator.GetFreeBytes() == 0);
+    CHECK(allocator.GetFragmentation() == 0.0);
+
+    // Every other block, 8 KB free in 1 KB pieces.
+    for (size_t i = 0; i < 16; i += 2)
+    {
+        allocator.Free(handles[i]);
+    }
+    CHECK(allocator.GetNumFreeBlocks() == 8);
+    CHECK(allocator.GetLargestFreeBlock() == 1024);
+    CHECK_NEAR(allocator.GetFragmentation(), 1.0 - 1.0 / 8.0, 1e-12);
+    CHECK(allocator.Allocate(2048, 1).handle == TlsfAllocator::s_invalidHandle);
+
+    for (size_t i = 1; i < 16; i += 2)
+    {
+        allocator.Free(handles[i]);
+    }
+    CHECK(allocator.GetNumFreeBlocks() == 1);
+    CHECK(allocator.GetFragmentation() == 0.0);
+}
+
+TEST(TlsfAllocator, RandomChurnKeepsRangesDisjoint)
+{
+    const uint64_t size = 64 << 20;
+    TlsfAllocator allocator(size);
+    std::mt19937 random(7);
+    std::vector<Range> ranges;
+
+    bool consistent = true;
+    for (size_t step = 0; step < 20000; step++)
+    {
+        if (ranges.empty() || random() % 3 != 0)
+        {
+            uint64_t allocationSize = 1 + random() % (1 << (4 + random() % 16));
+            TlsfAllocator::Allocation allocation = allocator.Allocate(allocationSize, uint64_t(1) << (random() % 17));
+            if (allocation.handle != TlsfAllocator::s_invalidHandle)
+            {
+                ranges.push_back({allocation.offset, allocationSize, allocation.handle});
+            }
+        }
+        else
+        {
+            size_t index = random() % ranges.size();
+            allocator.Free(ranges[index].handle);
+            ranges[index] = ranges.back();
+            ranges.pop_back();
+        }
+
+        if (step % 1000 == 0)
+        {
+            consistent = consistent && AreDisjoint(ranges, size) && allocator.GetNumAllocations() == ranges.size();
+        }
+    }
+    CHECK(consistent);
+
+    for (const Range &range : ranges)
+    {
+        allocator.Free(range.handle);
+    }
+    CHECK(allocator.GetUsedBytes() == 0);
+    CHECK(allocator.GetNumFreeBlocks() == 1);
+    CHECK(allocator.GetLargestFreeBlock() == size);
+}
@@ -0,0 +1,248 @@
+#include "Test.h"
+
+#include "JobSystem.h"
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using InstanceTransforms::Float4x4;
+
+namespace
+{
+    Float4x4 ToMatrix(const TransformHierarchy::Transform &transform)
+    {
+        float x = transform.rotation[0];
+        float y = transform.rotation[1];
+        float z = transform.rotation[2];
+        float w = transform.rotation[3];
+        float s = transform.scale;
+        return {{{(1.0f - 2.0f * (y * y + z * z)) * s, 2.0f * (x * y + z * w) * s, 2.0f * (x * z - y * w) * s, 0.0f},
+                 {2.0f * (x * y - z * w) * s, (1.0f - 2.0f * (x * x + z * z)) * s, 2.0f * (y * z + x * w) * s, 0.0f},
+                 {2.0f * (x * z + y * w) * s, 2.0f * (y * z - x * w) * s, (1.0f - 2.0f * (x * x + y * y)) * s, 0.0f},
+                 {transform.position[0], transform.position[1], transform.position[2], 1.0f}}};
+    }
+
+    // Row-vector convention, a is applied first.
+    Float4x4 Multiply(const Float4x4 &a, const Float4x4 &b)
+    {
+        Float4x4 out = {};
+        for (size_t row = 0; row < 4; row++)
+        {
+            for (size_t column = 0; column < 4; column++)
+            {
+                for (size_t k = 0; k < 4; k++)
+                {
+                    out.m[row][column] += a.m[row][k] * b.m[k][column];
+                }
+            }
+        }
+        return out;
+    }
+
+    float MaxDifference(const Float4x4 &a, const Float4x4 &b)
+    {
+        float difference = 0.0f;
+        for (size_t row = 0; row < 4; row++)
+        {
+            for (size_t column = 0; column < 4; column++)
+            {
+                difference = std::fmax(difference, std::fabs(a.m[row][column] - b.m[row][column]));
+            }
+        }
+        return difference;
+    }
+
+    TransformHierarchy::Transform RandomTransform(std::mt19937 &random)
+    {
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        float x = unit(random);
+        float y = unit(random);
+        float z = unit(random);
+        float w = unit(random) + 2.0f;
+        float length = std::sqrt(x * x + y * y + z * z + w * w);
+
+        TransformHierarchy::Transform transform;
+        transform.position[0] = unit(random) * 10.0f;
+        transform.position[1] = unit(random) * 10.0f;
+        transform.position[2] = unit(random) * 10.0f;
+        transform.rotation[0] = x / length;
+        transform.rotation[1] = y / length;
+        transform.rotation[2] = z / length;
+        transform.rotation[3] = w / length;
+        transform.scale = 0.75f + unit(random) * 0.25f;
+        return transform;
+    }
+
+    // Random forest, parents are listed after their children as often as before them.
+    std::vector<TransformHierarchy::NodeIndex> MakeForest(size_t numNodes, std::mt19937 &random)
+    {
+        std::vector<TransformHierarchy::NodeIndex> order(numNodes);
+        for (size_t i = 0; i < numNodes; i++)
+        {
+            order[i] = static_cast<TransformHierarchy::NodeIndex>(i);
+        }
+        std::shuffle(order.begin(), order.end(), random);
+
+        // order[i] gets a parent among order[0, i), which keeps it acyclic.
+        std::vector<TransformHierarchy::NodeIndex> parents(numNodes, TransformHierarchy::s_noParent);
+        for (size_t i = 1; i < numNodes; i++)
+        {
+            if (random() % 8 != 0)
+            {
+                parents[order[i]] = order[random() % i];
+            }
+        }
+        return parents;
+    }
+
+    // World matrices composed one parent at a time, without the hierarchy.
+    Float4x4 ComposeWorldMatrix(const std::vector<TransformHierarchy::NodeIndex> &parents, const std::vector<TransformHierarchy::Transform> &locals, TransformHierarchy::NodeIndex node)
+    {
+        Float4x4 world = ToMatrix(locals[node]);
+        for (TransformHierarchy::NodeIndex parent = parents[node]; parent != TransformHierarchy::s_noParent; parent = parents[parent])
+        {
+            world = Multiply(world, ToMatrix(locals[parent]));
+        }
+        return world;
+    }
+
+    bool MatchesComposition(const TransformHierarchy &hierarchy, const std::vector<TransformHierarchy::NodeIndex> &parents, const std::vector<TransformHierarchy::Transform> &locals)
+    {
+        // Positions reach a few hundred units, this is float rounding over a few levels.
+        for (size_t node = 0; node < parents.size(); node++)
+        {
+            TransformHierarchy::NodeIndex index = static_cast<TransformHierarchy::NodeIndex>(node);
+            if (MaxDifference(hierarchy.GetWorldMatrix(index), ComposeWorldMatrix(parents, locals, index)) > 1e-3f)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+TEST(TransformHierarchy, ParentsBeforeChildren)
+{
+    // 3 -> 1 -> 0 and 3 -> 2, listed children first.
+    const TransformHierarchy::NodeIndex none = TransformHierarchy::s_noParent;
+    std::vector<TransformHierarchy::NodeIndex> parents = {1, 3, 3, none};
+
+    TransformHierarchy hierarchy;
+    hierarchy.Build(parents);
+    CHECK(hierarchy.GetNumNodes() == 4);
+    CHECK(hierarchy.GetNumLevels() == 3);
+
+    TransformHierarchy::Transform root;
+    root.position[0] = 1.0f;
+    root.scale = 2.0f;
+    TransformHierarchy::Transform middle;
+    middle.position[1] = 1.0f;
+    TransformHierarchy::Transform leaf;
+    leaf.position[2] = 1.0f;
+    hierarchy.SetLocalTransform(3, root);
+    hierarchy.SetLocalTransform(1, middle);
+    hierarchy.SetLocalTransform(2, middle);
+    hierarchy.SetLocalTransform(0, leaf);
+
+    // A parent updated after its child would leave the child at the origin.
+    CHECK(hierarchy.Update() == 4);
+    TransformHierarchy::Transform world = hierarchy.GetWorldTransform(0);
+    CHECK(world.position[0] == 1.0f && world.position[1] == 2.0f && world.position[2] == 2.0f);
+    CHECK(world.scale == 2.0f);
+    world = hierarchy.GetWorldTransform(2);
+    CHECK(world.position[0] == 1.0f && world.position[1] == 2.0f && world.position[2] == 0.0f);
+}
+
+TEST(TransformHierarchy, WorldMatricesMatchComposition)
+{
+    std::mt19937 random(11);
+    const size_t numNodes = 2000;
+    std::vector<TransformHierarchy::NodeIndex> parents = MakeForest(numNodes, random);
+
+    TransformHierarchy hierarchy;
+    hierarchy.Build(parents);
+    std::vector<TransformHierarchy::Transform> locals;
+    for (size_t node = 0; node < numNodes; node++)
+    {
+        locals.push_back(RandomTransform(random));
+        hierarchy.SetLocalTransform(static_cast<TransformHierarchy::NodeIndex>(node), locals.back());
+    }
+
+    CHECK(hierarchy.Update() == numNodes);
+    CHECK(MatchesComposition(hierarchy, parents, locals));
+    CHECK(hierarchy.Update() == 0);
+}
+
+TEST(TransformHierarchy, RotationRotatesChildren)
+{
+    // A quarter turn about z of the parent moves a child on x to y.
+    TransformHierarchy hierarchy;
+    hierarchy.Build({TransformHierarchy::s_noParent, 0});
+
+    TransformHierarchy::Transform child;
+    child.position[0] = 1.0f;
+    hierarchy.SetLocalTransform(1, child);
+    const float quarterTurn[4] = {0.0f, 0.0f, std::sqrt(0.5f), std::sqrt(0.5f)};
+    hierarchy.SetLocalRotation(0, quarterTurn);
+    hierarchy.Update();
+
+    TransformHierarchy::Transform world = hierarchy.GetWorldTransform(1);
+    CHECK_NEAR(world.position[0], 0.0, 1e-6);
+    CHECK_NEAR(world.position[1], 1.0, 1e-6);
+    CHECK_NEAR(world.position[2], 0.0, 1e-6);
+}
+
+TEST(TransformHierarchy, OnlyDirtySubtreesUpdate)
+{
+    // 0 -> 1 -> 2 -> 3 and 0 -> 4.
+    const TransformHierarchy::NodeIndex none = TransformHierarchy::s_noParent;
+    std::vector<TransformHierarchy::NodeIndex> parents = {none, 0, 1, 2, 0};
+    TransformHierarchy hierarchy;
+    hierarchy.Build(parents);
+    hierarchy.Update();
+
+    TransformHierarchy::Transform moved;
+    moved.position[0] = 5.0f;
+    hierarchy.SetLocalTransform(2, moved);
+    CHECK(hierarchy.Update() == 2);
+    CHECK(hierarchy.GetWorldTransform(3).position[0] == 5.0f);
+    CHECK(hierarchy.GetWorldTransform(4).position[0] == 0.0f);
+
+    hierarchy.SetLocalTransform(0, moved);
+    CHECK(hierarchy.Update() == 5);
+    CHECK(hierarchy.GetWorldTransform(3).position[0] == 10.0f);
+    CHECK(hierarchy.GetWorldTransform(4).position[0] == 5.0f);
+}
+
+TEST(TransformHierarchy, ParallelUpdateMatchesSerial)
+{
+    std::mt19937 random(13);
+    const size_t numNodes = 50000;
+    std::vector<TransformHierarchy::NodeIndex> parents = MakeForest(numNodes, random);
+
+    TransformHierarchy serial;
+    TransformHierarchy parallel;
+    serial.Build(parents);
+    parallel.Build(parents);
+    for (size_t node = 0; node < numNodes; node++)
+    {
+        TransformHierarchy::Transform transform = RandomTransform(random);
+        serial.SetLocalTransform(static_cast<TransformHierarchy::NodeIndex>(node), transform);
+        parallel.SetLocalTransform(static_cast<TransformHierarchy::NodeIndex>(node), transform);
+    }
+
+    JobSystem jobSystem(4);
+    CHECK(serial.Update() == numNodes);
+    CHECK(parallel.Update(jobSystem) == numNodes);
+
+    bool identical = true;
+    for (size_t node = 0; node < numNodes; node++)
+    {
+        TransformHierarchy::NodeIndex index = static_cast<TransformHierarchy::NodeIndex>(node);
+        identical = identical && MaxDifference(serial.GetWorldMatrix(index), parallel.GetWorldMatrix(index)) == 0.0f;
+    }
+    CHECK(identical);
+}